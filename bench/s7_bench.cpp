@@ -0,0 +1,740 @@
+﻿/******************************************************************************
+ * @file    s7_bench.cpp
+ * @brief   采集性能基准测试（无界面）
+ *
+ * @details
+ * 功能描述：
+ *    - 在本机回环地址启动仿真PLC（S7_Simulator）代替真实PLC，可附加延迟、抖动与故障
+ *    - 按配置的变量数、数据类型、间距和采集间隔，驱动 S7_BASE 或调度器/连接池采集
+ *    - 输出吞吐量、请求延迟 p50/p99/p999、每个变量读取的CPU时间，可选 JSON 输出便于比较
+ *    - 服务器可单独运行（--server-only），客户端用 --host 连接，CPU统计不含服务器
+ *
+ * 模式：
+ *    direct     每个变量一次 ReadBytes，延迟按单次请求统计
+ *    multivars  每个周期一次 ReadMultiVars，延迟按周期统计
+ *    scheduler  S7_Scheduler 批量调度写入变量表，延迟按批次统计
+ *    pool       同 scheduler，批量读取分散到连接池各会话
+ *    writes     每个周期经 S7_WriteQueue 写入所有变量，相邻地址合并后一次提交
+ *    layout     DB1 视为 --tags 个UDT组成的数组，每个周期一次读取并经 S7_Layout 解码为结构体
+ *    allocs     预热后连续执行 --passes 个调度批次，统计采集路径上的内存分配次数，不为0时返回失败
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现基准测试
+ *   2026-10-16 服务器改用仿真PLC，增加延迟、PDU长度与故障注入参数
+ *   2026-10-16 可输出 S7_BASE 通信计量（--metrics）
+ *   2026-10-16 增加写合并模式（writes）
+ *   2026-10-16 增加结构体解码模式（layout）
+ *   2026-10-16 增加分配计数模式（allocs），验证调度器采集路径不分配内存
+ *****************************************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <QtAlgorithms>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include "s7_base.h"
+#include "s7_scheduler.h"
+#include "s7_pool.h"
+#include "s7_tagtable.h"
+#include "s7_simulator.h"
+#include "s7_metrics.h"
+#include "s7_writequeue.h"
+#include "s7_layout.h"
+#include <QFile>
+
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// 分配计数：只统计打开计数开关的线程，仿真PLC的服务线程不计入
+thread_local bool allocTracking = false;
+std::atomic<quint64> allocCount(0);
+
+inline void countAllocation()
+{
+    if (allocTracking)
+        allocCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// glibc 下替换 malloc 系列：Qt 容器直接调用 malloc，operator new 也经由 malloc，两者都能计入；
+// 其他平台只替换 operator new，Qt 容器的分配不计入
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) __THROW { countAllocation(); return __libc_malloc(size); }
+void *calloc(size_t count, size_t size) __THROW { countAllocation(); return __libc_calloc(count, size); }
+void *realloc(void *ptr, size_t size) __THROW { countAllocation(); return __libc_realloc(ptr, size); }
+void free(void *ptr) __THROW { __libc_free(ptr); }
+}
+#else
+void *operator new(std::size_t size)
+{
+    countAllocation();
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    countAllocation();
+    return std::malloc(size ? size : 1);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
+
+namespace {
+
+//————————————————————————————
+// 延迟直方图：对数分桶，每个2的幂区间再分16档，相对误差约6%，记录不分配内存
+class LatencyHistogram
+{
+public:
+    static const int Buckets = 61 * 16;
+
+    LatencyHistogram() : counts(Buckets, 0), total(0), sum(0), maximum(0) {}
+
+    void record(quint64 us)
+    {
+        counts[bucketOf(us)]++;
+        total++;
+        sum += us;
+        if (us > maximum)
+            maximum = us;
+    }
+
+    // 第 p 分位（0~1）所在桶的上界
+    quint64 percentile(double p) const
+    {
+        if (total == 0)
+            return 0;
+        const quint64 rank = qMax<quint64>(1, quint64(p * total + 0.5));
+        quint64 seen = 0;
+        for (int i = 0; i < Buckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return qMin(upperBound(i), maximum);
+        }
+        return maximum;
+    }
+
+    quint64 count() const { return total; }
+    quint64 max() const { return maximum; }
+    double mean() const { return total ? double(sum) / total : 0; }
+
+private:
+    static int bucketOf(quint64 v)
+    {
+        if (v < 32)
+            return int(v);
+        const int msb = 63 - qCountLeadingZeroBits(v);
+        return (msb - 3) * 16 + int((v >> (msb - 4)) & 15);
+    }
+
+    static quint64 upperBound(int index)
+    {
+        if (index < 32)
+            return quint64(index);
+        const int msb = index / 16 + 3;
+        const quint64 low = quint64(16 + index % 16) << (msb - 4);
+        return low + (quint64(1) << (msb - 4)) - 1;
+    }
+
+    QVector<quint64> counts;
+    quint64 total;
+    quint64 sum;
+    quint64 maximum;
+};
+
+// 进程CPU时间（用户态+内核态，微秒）
+qint64 processCpuUs()
+{
+#ifdef Q_OS_WIN
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+        return 0;
+    auto toUs = [](const FILETIME &t) {
+        return ((qint64(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 10;
+    };
+    return toUs(kernel) + toUs(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return qint64(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+           + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+//————————————————————————————
+// 仿真PLC：DB1..DBn、M、I、Q 填充固定图案，可选发生器定期改写数值
+const int DbSize = 60000;    // 每个DB的字节数，超出时使用下一个DB
+const int AreaSize = 65535;  // M/I/Q 区域字节数
+
+QByteArray pattern(int size, int seed)
+{
+    QByteArray data(size, 0);
+    for (int i = 0; i < size; ++i)
+        data[i] = char((i * 31 + seed) & 0xFF);
+    return data;
+}
+
+void setupSimulator(S7_Simulator &simulator, int dbCount, int churnMs)
+{
+    for (int i = 0; i < dbCount; ++i) {
+        simulator.addDb(i + 1, DbSize);
+        simulator.writeImage(S7AreaDB, i + 1, 0, pattern(DbSize, i));
+    }
+    const int areas[] = { S7AreaMK, S7AreaPE, S7AreaPA };
+    for (int k = 0; k < 3; ++k) {
+        simulator.setAreaSize(areas[k], AreaSize);
+        simulator.writeImage(areas[k], 0, 0, pattern(AreaSize, 100 * (k + 1)));
+    }
+
+    // 每个周期改写各DB前 4096 字节（每2字节一个计数器），使变化检测和历史记录有数据可处理
+    if (churnMs <= 0)
+        return;
+    simulator.setGeneratorInterval(churnMs);
+    for (int i = 0; i < dbCount; ++i) {
+        for (int k = 0; k < 4096; k += 2) {
+            SimGenerator generator;
+            generator.tag.area = S7AreaDB;
+            generator.tag.dbNumber = i + 1;
+            generator.tag.startByte = k;
+            generator.tag.dataType = DT_Int;
+            generator.wave = SimGenerator::Counter;
+            generator.offset = k;
+            generator.min = 0;
+            generator.max = 32767;
+            generator.periodMs = churnMs;
+            simulator.addGenerator(generator);
+        }
+    }
+}
+
+//————————————————————————————
+// 测试配置与变量布局
+struct BenchConfig {
+    QString mode = "scheduler";
+    QString host = "127.0.0.1";
+    bool localServer = true;
+    int tags = 200;
+    QString type = "mixed";
+    int strLength = 20;
+    int stride = 0;             // 相邻变量的起始地址间距，0 为紧密排列
+    bool allAreas = false;      // 变量分布到 DB/M/I/Q
+    int interval = 100;
+    double duration = 10;
+    int sessions = 2;
+    int churnMs = 0;
+    int latencyMs = 0;          // 仿真PLC每个报文的附加延迟
+    int jitterMs = 0;
+    double errorRate = 0;       // 仿真PLC数据项错误率
+    double stallRate = 0;       // 仿真PLC报文挂起率
+    int passes = 1000;          // allocs 模式计数的批次数
+    bool json = false;
+};
+
+DataType typeForIndex(const BenchConfig &config, int index)
+{
+    static const DataType mixed[] = { DT_Int, DT_Float, DT_Bool, DT_Char, DT_Float, DT_Int, DT_String };
+    if (config.type == "int") return DT_Int;
+    if (config.type == "float") return DT_Float;
+    if (config.type == "bool") return DT_Bool;
+    if (config.type == "char") return DT_Char;
+    if (config.type == "string") return DT_String;
+    return mixed[index % 7];
+}
+
+QVector<TagAddress> buildTags(const BenchConfig &config, int &dbCount)
+{
+    QVector<TagAddress> tags;
+    tags.reserve(config.tags);
+    const int areas[] = { 0x84, 0x83, 0x81, 0x82 };    // DB、M、I、Q
+    int next[4] = { 0, 0, 0, 0 };
+    dbCount = 1;
+
+    for (int i = 0; i < config.tags; ++i) {
+        TagAddress tag;
+        tag.dataType = typeForIndex(config, i);
+        tag.strLength = quint16(config.strLength);
+        tag.bitOffset = i % 8;
+        const int size = tagByteSize(tag);
+        const int step = qMax(size, config.stride);
+        const int a = config.allAreas ? i % 4 : 0;
+        tag.area = areas[a];
+
+        if (a == 0) {
+            // DB 写满后换下一个DB
+            if (next[0] % DbSize + size > DbSize)
+                next[0] = (next[0] / DbSize + 1) * DbSize;
+            tag.dbNumber = 1 + next[0] / DbSize;
+            tag.startByte = next[0] % DbSize;
+            dbCount = qMax(dbCount, tag.dbNumber);
+        } else {
+            tag.startByte = next[a] % (AreaSize - size);
+        }
+        next[a] += step;
+        tags.append(tag);
+    }
+    return tags;
+}
+
+// 测试结果
+struct BenchResult {
+    LatencyHistogram latency;
+    quint64 requests = 0;       // 统计延迟的请求（或批次）数
+    quint64 tagReads = 0;
+    quint64 failures = 0;
+    quint64 pdus = 0;
+    quint64 changed = 0;
+    qint64 wallUs = 0;
+    qint64 cpuUs = 0;
+    qint64 allocations = -1;    // allocs 模式计数期间的分配次数，-1 表示未统计
+};
+
+// 按固定周期执行 body 直到测试时长结束，周期为0时连续执行，落后时不追赶
+template <typename Body>
+void runPaced(const BenchConfig &config, Body &&body)
+{
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 endNs = qint64(config.duration * 1e9);
+    qint64 nextNs = 0;
+    while (clock.nsecsElapsed() < endNs) {
+        body();
+        if (config.interval <= 0)
+            continue;
+        nextNs += qint64(config.interval) * 1000000;
+        const qint64 waitNs = nextNs - clock.nsecsElapsed();
+        if (waitNs > 0)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+        else
+            nextNs = clock.nsecsElapsed();
+    }
+}
+
+//————————————————————————————
+// 各模式
+void runDirect(const BenchConfig &config, const QVector<TagAddress> &tags, S7_BASE &s7, BenchResult &result)
+{
+    QByteArray buffer(4096, 0);
+    quint8 *data = reinterpret_cast<quint8*>(buffer.data());
+    QElapsedTimer timer;
+    runPaced(config, [&]() {
+        for (const TagAddress &tag : tags) {
+            timer.start();
+            const bool ok = s7.ReadBytes(tag.area, tag.dbNumber, tag.startByte, data,
+                                         size_t(tagByteSize(tag)), S7_BASE::PriorityCyclic);
+            result.latency.record(quint64(timer.nsecsElapsed() / 1000));
+            result.requests++;
+            result.pdus++;
+            result.tagReads++;
+            if (!ok)
+                result.failures++;
+        }
+    });
+}
+
+void runMultiVars(const BenchConfig &config, const QVector<TagAddress> &tags, S7_BASE &s7, BenchResult &result)
+{
+    int totalBytes = 0;
+    for (const TagAddress &tag : tags)
+        totalBytes += tagByteSize(tag);
+    QByteArray buffer(totalBytes, 0);
+    QVector<S7_MultiItem> items(tags.size());
+    int offset = 0;
+    for (int i = 0; i < tags.size(); ++i) {
+        S7_MultiItem &item = items[i];
+        item.area = tags[i].area;
+        item.dbNumber = tags[i].dbNumber;
+        item.start = tags[i].startByte;
+        item.size = tagByteSize(tags[i]);
+        item.buffer = reinterpret_cast<quint8*>(buffer.data()) + offset;
+        offset += item.size;
+    }
+
+    QElapsedTimer timer;
+    runPaced(config, [&]() {
+        timer.start();
+        result.pdus += quint64(s7.ReadMultiVars(items, S7_BASE::PriorityCyclic));
+        result.latency.record(quint64(timer.nsecsElapsed() / 1000));
+        result.requests++;
+        result.tagReads += quint64(items.size());
+        for (const S7_MultiItem &item : qAsConst(items)) {
+            if (item.result != 0)
+                result.failures++;
+        }
+    });
+}
+
+// 写入模式：每个周期把所有变量写入一次（值随周期变化），经写队列合并后提交
+void runWrites(const BenchConfig &config, const QVector<TagAddress> &tags, S7_BASE &s7, BenchResult &result)
+{
+    S7_WriteQueue queue(&s7);
+    QElapsedTimer timer;
+    int cycle = 0;
+    runPaced(config, [&]() {
+        timer.start();
+        cycle++;
+        for (const TagAddress &tag : tags) {
+            switch (tag.dataType) {
+            case DT_Bool:
+                queue.writeBool(tag.area, tag.dbNumber, tag.startByte, tag.bitOffset, cycle & 1);
+                break;
+            case DT_Float:
+                queue.writeFloat(tag.area, tag.dbNumber, tag.startByte, cycle * 0.5f);
+                break;
+            case DT_String:
+                queue.writeString(tag.area, tag.dbNumber, tag.startByte, QString::number(cycle), tag.strLength);
+                break;
+            case DT_Char:
+                queue.writeChar(tag.area, tag.dbNumber, tag.startByte, char('A' + cycle % 26));
+                break;
+            case DT_Int:
+            default:
+                queue.writeInt(tag.area, tag.dbNumber, tag.startByte, cycle);
+                break;
+            }
+        }
+        const WriteReport report = queue.flush(S7_BASE::PriorityCyclic);
+        result.latency.record(quint64(timer.nsecsElapsed() / 1000));
+        result.requests++;
+        result.pdus += quint64(report.telegrams);
+        result.tagReads += quint64(report.writes);
+        result.failures += quint64(report.failedWrites);
+    });
+}
+
+// 结构体模式：DB1 中连续存放的UDT数组，每个周期整块读取后一次解码，
+// 变量数按 记录数 × 字段数 统计
+struct BenchRecord {
+    qint16 id;
+    bool running;
+    bool fault;
+    float speed;
+    qint32 counter;
+    S7_String<16> name;
+};
+
+using BenchRecordLayout = S7_Layout<BenchRecord,
+    S7_Field<&BenchRecord::id, 0>,
+    S7_Bit<&BenchRecord::running, 2, 0>,
+    S7_Bit<&BenchRecord::fault, 2, 1>,
+    S7_Field<&BenchRecord::speed, 4>,
+    S7_Field<&BenchRecord::counter, 8>,
+    S7_Field<&BenchRecord::name, 12>>;
+
+void runLayout(const BenchConfig &config, S7_BASE &s7, BenchResult &result)
+{
+    const int count = qMin(config.tags, DbSize / BenchRecordLayout::stride);
+    QVector<BenchRecord> records;
+    QElapsedTimer timer;
+    runPaced(config, [&]() {
+        timer.start();
+        const int error = BenchRecordLayout::readArray(&s7, S7AreaDB, 1, 0, records, count);
+        result.latency.record(quint64(timer.nsecsElapsed() / 1000));
+        result.requests++;
+        result.pdus += quint64((count * BenchRecordLayout::stride + s7.PduPayloadSize() - 1) / s7.PduPayloadSize());
+        result.tagReads += quint64(count) * BenchRecordLayout::fieldCount;
+        if (error != 0)
+            result.failures++;
+    });
+}
+
+// 调度器模式：在当前线程中手动驱动 poll()，到期时间由调度器给出
+void runScheduler(const BenchConfig &config, const QVector<TagAddress> &tags, S7_BASE &s7,
+                  S7_ConnectionPool *pool, BenchResult &result)
+{
+    S7_TagTable table;
+    S7_Scheduler scheduler(&s7);
+    scheduler.setTagTable(&table);
+    scheduler.setConnectionPool(pool);
+    for (int i = 0; i < tags.size(); ++i) {
+        table.defineTag(i, QString("tag%1").arg(i), tags[i]);
+        scheduler.addTask(i, tags[i], qMax(1, config.interval));
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 endMs = qint64(config.duration * 1000);
+    quint64 lastTick = 0;
+    while (clock.elapsed() < endMs) {
+        const qint64 next = scheduler.poll(scheduler.elapsedMs());
+        const TickStats tick = scheduler.lastStats();
+        if (tick.tickIndex != lastTick) {
+            lastTick = tick.tickIndex;
+            result.latency.record(quint64(tick.elapsedUs));
+            result.requests++;
+            result.tagReads += quint64(tick.tagsServed);
+            result.failures += quint64(tick.tagsFailed);
+            result.pdus += quint64(tick.pdusSent);
+            result.changed += quint64(tick.tagsChanged);
+        }
+        const qint64 wait = next - scheduler.elapsedMs();
+        if (wait > 0)
+            QThread::msleep(quint64(wait));
+    }
+}
+
+// 分配计数模式：预热后按周期步进虚拟时钟，每次 poll() 所有变量都到期，不等待；
+// S7_BASE 为直连模式，报文收发也在当前线程中执行，计入统计
+void runAllocs(const BenchConfig &config, const QVector<TagAddress> &tags, S7_BASE &s7, BenchResult &result)
+{
+    const int WarmupPasses = 16;    // 预热批次，复用的缓冲区在此期间扩容到位
+
+    S7_TagTable table;
+    S7_Scheduler scheduler(&s7);
+    scheduler.setTagTable(&table);
+    const int interval = qMax(1, config.interval);
+    for (int i = 0; i < tags.size(); ++i) {
+        table.defineTag(i, QString("tag%1").arg(i), tags[i]);
+        scheduler.addTask(i, tags[i], interval);
+    }
+
+    qint64 now = 0;
+    for (int i = 0; i < WarmupPasses; ++i)
+        scheduler.poll(now += interval);
+
+    allocCount = 0;
+    allocTracking = true;
+    for (int i = 0; i < config.passes; ++i) {
+        scheduler.poll(now += interval);
+        const TickStats tick = scheduler.lastStats();
+        result.latency.record(quint64(tick.elapsedUs));
+        result.requests++;
+        result.tagReads += quint64(tick.tagsServed);
+        result.failures += quint64(tick.tagsFailed);
+        result.pdus += quint64(tick.pdusSent);
+        result.changed += quint64(tick.tagsChanged);
+    }
+    allocTracking = false;
+    result.allocations = qint64(allocCount.load());
+}
+
+//————————————————————————————
+// 输出
+void printResult(const BenchConfig &config, const BenchResult &r)
+{
+    const double seconds = r.wallUs / 1e6;
+    const double tagsPerSecond = seconds > 0 ? r.tagReads / seconds : 0;
+    const double pdusPerSecond = seconds > 0 ? r.pdus / seconds : 0;
+    const double cpuPerTag = r.tagReads ? double(r.cpuUs) / r.tagReads : 0;
+    const char *unit = (config.mode == "direct") ? "request" : "cycle";
+
+    if (config.json) {
+        printf("{\"mode\":\"%s\",\"tags\":%d,\"type\":\"%s\",\"interval_ms\":%d,\"duration_s\":%.3f,"
+               "\"requests\":%llu,\"tag_reads\":%llu,\"failures\":%llu,\"pdus\":%llu,\"changed\":%llu,"
+               "\"tags_per_s\":%.1f,\"pdus_per_s\":%.1f,"
+               "\"latency_us\":{\"unit\":\"%s\",\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu,\"mean\":%.1f},"
+               "\"cpu_us\":%lld,\"cpu_us_per_tag\":%.3f,\"cpu_includes_server\":%s,"
+               "\"server\":{\"latency_ms\":%d,\"jitter_ms\":%d,\"error_rate\":%.4f,\"stall_rate\":%.4f}",
+               qPrintable(config.mode), config.tags, qPrintable(config.type), config.interval, seconds,
+               (unsigned long long)r.requests, (unsigned long long)r.tagReads, (unsigned long long)r.failures,
+               (unsigned long long)r.pdus, (unsigned long long)r.changed, tagsPerSecond, pdusPerSecond, unit,
+               (unsigned long long)r.latency.percentile(0.5), (unsigned long long)r.latency.percentile(0.99),
+               (unsigned long long)r.latency.percentile(0.999), (unsigned long long)r.latency.max(),
+               r.latency.mean(), (long long)r.cpuUs, cpuPerTag, config.localServer ? "true" : "false",
+               config.latencyMs, config.jitterMs, config.errorRate, config.stallRate);
+        if (r.allocations >= 0)
+            printf(",\"allocations\":%lld", (long long)r.allocations);
+        printf("}\n");
+        return;
+    }
+
+    printf("模式 %s  变量 %d（%s）  间隔 %dms  时长 %.1fs\n",
+           qPrintable(config.mode), config.tags, qPrintable(config.type), config.interval, seconds);
+    printf("请求/批次 %llu  变量读取 %llu  失败 %llu  报文 %llu  变化 %llu\n",
+           (unsigned long long)r.requests, (unsigned long long)r.tagReads, (unsigned long long)r.failures,
+           (unsigned long long)r.pdus, (unsigned long long)r.changed);
+    printf("吞吐 %.0f 变量/s  %.0f 报文/s\n", tagsPerSecond, pdusPerSecond);
+    printf("延迟（每%s，us） p50 %llu  p99 %llu  p999 %llu  最大 %llu  平均 %.1f\n",
+           config.mode == "direct" ? "请求" : "批次",
+           (unsigned long long)r.latency.percentile(0.5), (unsigned long long)r.latency.percentile(0.99),
+           (unsigned long long)r.latency.percentile(0.999), (unsigned long long)r.latency.max(), r.latency.mean());
+    printf("CPU %.1fms  每变量 %.2fus%s\n", r.cpuUs / 1000.0, cpuPerTag,
+           config.localServer ? "（含进程内服务器）" : "");
+    if (config.latencyMs || config.jitterMs || config.errorRate > 0 || config.stallRate > 0)
+        printf("仿真PLC 延迟 %dms±%dms  错误率 %.2f%%  挂起率 %.2f%%\n", config.latencyMs, config.jitterMs,
+               config.errorRate * 100, config.stallRate * 100);
+    if (r.allocations >= 0)
+        printf("内存分配 %lld 次（%llu 个批次）%s\n", (long long)r.allocations,
+               (unsigned long long)r.requests, r.allocations == 0 ? "" : "  失败：采集路径存在分配");
+}
+
+} // namespace
+
+//————————————————————————————
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("s7_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("S7 acquisition benchmark against a loopback snap7 server");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"mode", "direct | multivars | scheduler | pool | writes | layout | allocs", "mode", "scheduler"},
+        {"tags", "Number of tags", "count", "200"},
+        {"type", "int | float | bool | char | string | mixed", "type", "mixed"},
+        {"strlen", "String max length", "bytes", "20"},
+        {"stride", "Address distance between tags (0 = packed)", "bytes", "0"},
+        {"all-areas", "Spread tags over DB/M/I/Q"},
+        {"interval", "Cycle interval in ms (0 = back-to-back, direct/multivars/writes only)", "ms", "100"},
+        {"duration", "Measurement time in seconds", "s", "10"},
+        {"sessions", "Sessions in pool mode", "count", "2"},
+        {"passes", "Counted scheduler passes in allocs mode", "count", "1000"},
+        {"churn", "Server rewrites values every N ms (0 = static)", "ms", "0"},
+        {"script", "Server value generator script (see s7_simulator.h)", "file"},
+        {"latency", "Server delay per PDU", "ms", "0"},
+        {"jitter", "Server delay jitter per PDU", "ms", "0"},
+        {"pdu", "Server PDU size (240..960)", "bytes", "480"},
+        {"max-clients", "Server connection limit", "count", "32"},
+        {"error-rate", "Probability that the server fails an item", "p", "0"},
+        {"stall-rate", "Probability that the server stalls a PDU for --stall ms", "p", "0"},
+        {"stall", "Stall time", "ms", "5000"},
+        {"host", "Connect to an external server instead of starting one", "ip"},
+        {"server-only", "Only run the server (on --listen) until killed"},
+        {"listen", "Server address", "ip", "127.0.0.1"},
+        {"json", "Print one JSON line"},
+        {"metrics", "Also print the per-operation metrics dump (JSON) of the measured run"},
+    });
+    parser.process(app);
+
+    BenchConfig config;
+    config.mode = parser.value("mode");
+    config.tags = qMax(1, parser.value("tags").toInt());
+    config.type = parser.value("type");
+    config.strLength = qBound(1, parser.value("strlen").toInt(), 254);
+    config.stride = qMax(0, parser.value("stride").toInt());
+    config.allAreas = parser.isSet("all-areas");
+    config.interval = qMax(0, parser.value("interval").toInt());
+    config.duration = qMax(0.1, parser.value("duration").toDouble());
+    config.sessions = qMax(1, parser.value("sessions").toInt());
+    config.passes = qMax(1, parser.value("passes").toInt());
+    config.churnMs = qMax(0, parser.value("churn").toInt());
+    config.latencyMs = qMax(0, parser.value("latency").toInt());
+    config.jitterMs = qMax(0, parser.value("jitter").toInt());
+    config.errorRate = parser.value("error-rate").toDouble();
+    config.stallRate = parser.value("stall-rate").toDouble();
+    config.json = parser.isSet("json");
+    config.localServer = !parser.isSet("host");
+    if (!config.localServer)
+        config.host = parser.value("host");
+
+    int dbCount = 1;
+    const QVector<TagAddress> tags = buildTags(config, dbCount);
+
+    // 服务器
+    QScopedPointer<S7_Simulator> server;
+    if (config.localServer || parser.isSet("server-only")) {
+        server.reset(new S7_Simulator);
+        setupSimulator(*server, dbCount, config.churnMs);
+        if (parser.isSet("script")) {
+            QFile file(parser.value("script"));
+            QString error;
+            if (!file.open(QIODevice::ReadOnly | QIODevice::Text)
+                || !server->loadScript(QString::fromUtf8(file.readAll()), &error)) {
+                fprintf(stderr, "script %s: %s\n", qPrintable(file.fileName()),
+                        qPrintable(error.isEmpty() ? file.errorString() : error));
+                return 1;
+            }
+        }
+        server->setLatency(config.latencyMs, config.jitterMs);
+        server->setPduSize(parser.value("pdu").toInt());
+        server->setMaxClients(parser.value("max-clients").toInt());
+        server->setErrorRate(config.errorRate);
+        server->setStallRate(config.stallRate, parser.value("stall").toInt());
+
+        const QString listen = parser.value("listen");
+        if (!server->start(listen)) {
+            fprintf(stderr, "server start failed on %s:102: %s\n", qPrintable(listen),
+                    qPrintable(server->errorString()));
+            return 2;
+        }
+        if (parser.isSet("server-only")) {
+            fprintf(stderr, "server listening on %s:102 (DB1..DB%d, M/I/Q)\n", qPrintable(listen), dbCount);
+            return app.exec();
+        }
+        config.host = listen;
+    }
+
+    // 客户端（allocs 模式用直连模式，报文收发在计数线程中执行）
+    S7_BASE s7(config.mode != "allocs");
+    if (!s7.Connect(config.host, 0, 1)) {
+        fprintf(stderr, "connect to %s failed\n", qPrintable(config.host));
+        return 3;
+    }
+    QScopedPointer<S7_ConnectionPool> pool;
+    if (config.mode == "pool") {
+        pool.reset(new S7_ConnectionPool);
+        if (pool->open(config.host, 0, 1, config.sessions) == 0) {
+            fprintf(stderr, "pool open failed\n");
+            return 3;
+        }
+    }
+
+    BenchResult result;
+    const S7_Metrics::Snapshot metricsStart = S7_Metrics::snapshot();
+    QElapsedTimer wall;
+    const qint64 cpuStart = processCpuUs();
+    wall.start();
+
+    if (config.mode == "direct")
+        runDirect(config, tags, s7, result);
+    else if (config.mode == "multivars")
+        runMultiVars(config, tags, s7, result);
+    else if (config.mode == "scheduler" || config.mode == "pool")
+        runScheduler(config, tags, s7, pool.data(), result);
+    else if (config.mode == "writes")
+        runWrites(config, tags, s7, result);
+    else if (config.mode == "layout")
+        runLayout(config, s7, result);
+    else if (config.mode == "allocs")
+        runAllocs(config, tags, s7, result);
+    else {
+        fprintf(stderr, "unknown mode: %s\n", qPrintable(config.mode));
+        return 1;
+    }
+
+    result.wallUs = wall.nsecsElapsed() / 1000;
+    result.cpuUs = processCpuUs() - cpuStart;
+    printResult(config, result);
+    if (parser.isSet("metrics"))
+        printf("%s\n", S7_Metrics::snapshot().since(metricsStart).toJson().constData());
+
+    if (pool)
+        pool->close();
+    s7.Disconnect();
+    if (result.allocations > 0)
+        return 5;
+    return result.failures == 0 ? 0 : 4;
+}
@@ -0,0 +1,44 @@
+QT       += core
+QT       -= gui
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = s7_bench
+
+# 与主程序共用采集相关源码
+INCLUDEPATH += $$PWD/..
+LIBS += $$PWD/../Lib/snap7.lib
+
+SOURCES += \
+    ../Lib/snap7.cpp \
+    ../s7_base.cpp \
+    ../s7_histcodec.cpp \
+    ../s7_historian.cpp \
+    ../s7_metrics.cpp \
+    ../s7_planner.cpp \
+    ../s7_pool.cpp \
+    ../s7_scheduler.cpp \
+    ../s7_simulator.cpp \
+    ../s7_tagtable.cpp \
+    ../s7_writequeue.cpp \
+    s7_bench.cpp
+
+HEADERS += \
+    ../Lib/snap7.h \
+    ../s7_base.h \
+    ../s7_bitstream.h \
+    ../s7_histcodec.h \
+    ../s7_historian.h \
+    ../s7_layout.h \
+    ../s7_metrics.h \
+    ../s7_planner.h \
+    ../s7_pool.h \
+    ../s7_queue.h \
+    ../s7_result.h \
+    ../s7_scheduler.h \
+    ../s7_simulator.h \
+    ../s7_tag.h \
+    ../s7_tagtable.h \
+    ../s7_trendbuffer.h \
+    ../s7_writequeue.h
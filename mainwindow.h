@@ -3,20 +3,25 @@
 
 #include <QWidget>
 #include "s7_base.h"
+#include "s7_layout.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class S7Tester; }
 QT_END_NAMESPACE
 
-// 测试用结构体（保持1字节对齐）
-#pragma pack(push, 1)
+// 测试用结构体，PLC中的布局由 TestStructLayout 描述，本地对齐不影响收发
 struct TestStruct {
     qint16 id;
     float value;
     bool status;
     quint8 checksum;
 };
-#pragma pack(pop)
+
+using TestStructLayout = S7_Layout<TestStruct,
+    S7_Field<&TestStruct::id, 0>,           // INT   偏移0
+    S7_Field<&TestStruct::value, 2>,        // REAL  偏移2
+    S7_Bit<&TestStruct::status, 6, 0>,      // BOOL  偏移6.0
+    S7_Field<&TestStruct::checksum, 7>>;    // BYTE  偏移7
 
 class S7Tester : public QWidget
 {
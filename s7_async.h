@@ -0,0 +1,89 @@
+﻿#ifndef S7_ASYNC_H
+#define S7_ASYNC_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QQueue>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <functional>
+#include <Lib/snap7.h>
+#include "s7_metrics.h"
+
+// 异步S7客户端：基于 Cli_AsReadArea/Cli_AsWriteArea 与完成回调，
+// 调用方立即返回，结果通过回调函数或 finished 信号在本对象所在线程中送达。
+// 只用于界面的手动读取。循环采集不经过本类：snap7 没有异步的 MultiVars 接口，
+// 改走本类会把一个打包多项的报文拆成逐区域的报文；同一会话同一时刻只有一个报文在途，
+// 下一个 MultiVars 请求的准备只需几微秒，与报文重叠没有收益；每个请求还要分配缓冲区和回调，
+// 采集路径将不再是零分配。循环读取的并行由连接池的多个会话提供（S7_ConnectionPool）
+class S7_AsyncClient : public QObject
+{
+    Q_OBJECT
+public:
+    using Completion = std::function<void(int result, const QByteArray &data)>;
+
+    explicit S7_AsyncClient(QObject *parent = nullptr);
+    ~S7_AsyncClient();
+
+    void setConnectionType(quint16 type);   // 需在 connectTo 之前设置
+    bool connectTo(const QString &ip, int rack, int slot);
+    void disconnectFromPlc();
+    bool isLinked() const;
+    // 使用上次的连接参数重新连接（主连接掉线恢复后调用）
+    bool reconnect();
+
+    // 提交请求，返回请求编号；请求排队执行，前一个报文在途时下一个已准备好
+    quint64 readArea(int area, int dbNumber, int start, int size, Completion done = Completion());
+    quint64 writeArea(int area, int dbNumber, int start, const QByteArray &data, Completion done = Completion());
+    quint64 writeBit(int area, int dbNumber, int startByte, int bitPosition, bool value, Completion done = Completion());
+
+    // 观测数据：排队深度（含在途请求）与延迟
+    int queueDepth() const;
+    int lastLatencyUs() const;
+    int averageLatencyUs() const;
+
+signals:
+    void finished(quint64 requestId, int result, const QByteArray &data, int latencyUs);
+    void queueDepthChanged(int depth);
+
+private:
+    struct Request {
+        quint64 id;
+        bool write;
+        int area;
+        int dbNumber;
+        int start;
+        int amount;
+        int wordLen;
+        QByteArray data;
+        Completion done;
+        qint64 enqueuedNs;      // 入队时刻，用于统计排队等待
+    };
+
+    static void S7API completionCallback(void *usrPtr, int opCode, int opResult);
+    quint64 enqueue(Request req);
+    bool submitLocked();                  // 需持有 mutex
+    void deliver(Request req, int result, int latencyUs);
+
+    S7Object client;
+    bool connected;
+    QString lastIp;
+    int lastRack;
+    int lastSlot;
+
+    mutable QMutex mutex;
+    QQueue<Request> pending;
+    Request inFlight;
+    bool busy;
+    QElapsedTimer inFlightTimer;
+    qint64 inFlightQueueWaitUs;
+    quint64 nextId;
+
+    std::atomic<int> depth;
+    std::atomic<int> lastLatency;
+    std::atomic<qint64> totalLatency;
+    std::atomic<qint64> completedCount;
+};
+
+#endif
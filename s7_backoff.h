@@ -0,0 +1,29 @@
+﻿#ifndef S7_BACKOFF_H
+#define S7_BACKOFF_H
+
+#include <QtGlobal>
+#include <QRandomGenerator>
+#include <cmath>
+
+// 带抖动的指数退避：第n次失败后等待 initialMs*factor^(n-1)，不超过 maximumMs，
+// 再乘以 [1-jitter, 1+jitter] 内的随机系数，避免多个会话同时重连
+struct S7_Backoff {
+    int initialMs = 500;
+    int maximumMs = 30000;
+    double factor = 2.0;
+    double jitter = 0.2;
+    int failures = 0;           // 连续失败次数
+
+    // 记一次失败，返回下次重试前的等待时间（毫秒）
+    int next()
+    {
+        failures++;
+        const double base = qMin(double(maximumMs), initialMs * std::pow(factor, qMin(failures - 1, 30)));
+        const double spread = 1.0 + jitter * (2.0 * QRandomGenerator::global()->generateDouble() - 1.0);
+        return qMax(1, int(base * spread));
+    }
+
+    void reset() { failures = 0; }
+};
+
+#endif
@@ -15,6 +15,19 @@
  * @note
  * - 修改记录：
  *   2025-4-10 实现基础功能V1.0
+ *   2026-10-16 增加PDU长度查询与缓冲区解析函数
+ *   2026-10-16 增加基于 Cli_ReadMultiVars/Cli_WriteMultiVars 的批量读写
+ *   2026-10-16 增加缓冲区编码函数，供异步写入复用
+ *   2026-10-16 增加连接类型设置、健康检查与重连
+ *   2026-10-16 所有操作经无锁队列由单一I/O线程执行，支持多线程调用与优先级
+ *   2026-10-16 请求完成信号量按调用线程复用，提交请求不再分配内存
+ *   2026-10-16 每个操作记录执行耗时、排队等待、字节数、报文数与错误码
+ *   2026-10-16 链路错误时标记中断并停止发送，支持由监督器重连；修正 isConnected 返回值取反
+ *   2026-10-16 增加带质量码的读取结果，批量读写的数据项带回PLC执行耗时
+ *   2026-10-16 WriteBool 改为 S7WLBit 单报文写入，批量数据项支持位访问
+ *   2026-10-16 增加返回错误码的 ReadArea 与整块读取 DBGet
+ *   2026-10-16 增加非阻塞的 Post，界面线程的手动写入按手动优先级排队
+ *   2026-10-16 PDU长度在连接时记录，查询不再经I/O线程排队
  *
  *
  *         .--,       .--,
@@ -35,174 +48,675 @@
 #include "s7_base.h"
 #include <QByteArray>
 #include <QtEndian>
+#include <QDateTime>
 #include <QDebug>
+#include <cstring>
 
-S7_BASE::S7_BASE()
+S7_BASE::S7_BASE(bool useIoThread)
 {
     connected = false;
+    linkLost = false;
+    linkError = 0;
+    lastOkNs = 0;
+    pduLength = 240;
+    connType = CONNTYPE_PG;
+    lastRack = 0;
+    lastSlot = 1;
+    queueWaitUs = 0;
     client = Cli_Create();
+
+    ioThread = nullptr;
+    if(useIoThread) {
+        ioThread = QThread::create([this]() { ioLoop(); });
+        ioThread->start();
+    }
 }
 
 S7_BASE::~S7_BASE()
 {
     Disconnect();
+    if(ioThread) {
+        // 停止请求排在已入队的请求之后
+        IoRequest stop;
+        stop.invoke = nullptr;
+        stop.context = nullptr;
+        stop.done = &callerSemaphore();
+        stop.enqueuedNs = 0;
+        queues[PriorityCyclic].push(&stop);
+        wakeup.release();
+        stop.done->acquire();
+        ioThread->wait();
+        delete ioThread;
+    }
     if(client) {
         Cli_Destroy(&client);
     }
 }
 
+// 每个调用线程同一时刻只有一个请求在等待，信号量按线程创建一次后复用
+QSemaphore &S7_BASE::callerSemaphore()
+{
+    static thread_local QSemaphore semaphore;
+    return semaphore;
+}
+
+//————————————————————————————
+// I/O线程：手动请求队列优先，其次是循环采集队列
+void S7_BASE::ioLoop()
+{
+    for(;;) {
+        wakeup.acquire();
+        S7_QueueNode *node = nullptr;
+        // 生产者可能尚未完成链接，短暂让出CPU后重试
+        while(!(node = queues[PriorityManual].pop()) && !(node = queues[PriorityCyclic].pop()))
+            QThread::yieldCurrentThread();
+
+        IoRequest *request = static_cast<IoRequest*>(node);
+        if(!request->invoke) {
+            request->done->release();
+            return;
+        }
+        queueWaitUs = (S7_Metrics::nowNs() - request->enqueuedNs) / 1000;
+        request->invoke(request->context);
+        if(request->done)
+            request->done->release();
+        else
+            delete static_cast<PostedRequest*>(request);
+    }
+}
+
+// 非阻塞提交：请求在堆上分配，调用方不等待
+void S7_BASE::Post(Priority priority, std::function<void()> fn)
+{
+    if(!ioThread || QThread::currentThread() == ioThread) {
+        fn();
+        return;
+    }
+
+    PostedRequest *request = new PostedRequest;
+    request->fn = std::move(fn);
+    request->invoke = [](void *context) { static_cast<PostedRequest*>(context)->fn(); };
+    request->context = request;
+    request->done = nullptr;
+    request->enqueuedNs = S7_Metrics::nowNs();
+    queues[priority].push(request);
+    wakeup.release();
+}
+
 // 建立连接
 bool S7_BASE::Connect(const QString &ip, int rack, int slot)
 {
-    if(!client) return false;
+    bool ok = false;
+    execute(PriorityManual, [&]() {
+        if(!client) return;
 
-    // 使用ConnectTo进行连接
-    int result = Cli_ConnectTo(client,
-                               ip.toLatin1().constData(),
-                               rack,
-                               slot);
+        lastIp = ip;
+        lastRack = rack;
+        lastSlot = slot;
+        Cli_SetConnectionType(client, connType);
 
-    connected = (result == 0);
-    return connected;
+        // 使用ConnectTo进行连接
+        const qint64 start = S7_Metrics::nowNs();
+        int result = Cli_ConnectTo(client,
+                                   ip.toLatin1().constData(),
+                                   rack,
+                                   slot);
+        record(S7_Metrics::OpControl, result, start, 0, 1);
+
+        // 协商的PDU长度只在连接时变化，记录下来供采集线程直接读取
+        int requested = 0;
+        int length = 0;
+        if(result == 0 && Cli_GetPduLength(client, &requested, &length) == 0 && length > 0)
+            pduLength = length;
+        else
+            pduLength = 240;
+
+        connected = (result == 0);
+        if(connected)
+            linkLost = false;
+        ok = connected;
+    });
+    return ok;
 }
 
-// 断开连接
+// 断开连接（用户主动断开，不再重连）
 void S7_BASE::Disconnect()
 {
-    if(client && connected) {
-        Cli_Disconnect(client);
-        connected = false;
-    }
+    execute(PriorityManual, [&]() {
+        linkLost = false;
+        if(client && connected) {
+            Cli_Disconnect(client);
+            connected = false;
+        }
+    });
 }
 
 //连接状态判断
 bool S7_BASE::isConnected(){
-    return (connected == 0);
+    return connected;
+}
+
+bool S7_BASE::IsLinkLost() const
+{
+    return linkLost;
+}
+
+int S7_BASE::LinkError() const
+{
+    return linkError;
+}
+
+qint64 S7_BASE::IdleMs() const
+{
+    const qint64 last = lastOkNs;
+    return last > 0 ? (S7_Metrics::nowNs() - last) / 1000000 : -1;
+}
+
+bool S7_BASE::IsLinkError(int code)
+{
+    return (code & 0x000FFFFF) != 0 || code == int(errCliInvalidPlcAnswer);
+}
+
+// 在执行请求的线程中调用：成功时记录时刻，链路错误时关闭套接字，后续请求不再发送
+void S7_BASE::trackLink(int result)
+{
+    if(result == 0) {
+        lastOkNs = S7_Metrics::nowNs();
+        return;
+    }
+    if(!IsLinkError(result) || !connected)
+        return;
+    Cli_Disconnect(client);
+    connected = false;
+    linkError = result;
+    linkLost = true;
+}
+
+// 设置连接类型（PG/OP/S7-basic）
+void S7_BASE::SetConnectionType(quint16 type)
+{
+    execute(PriorityManual, [&]() {
+        connType = type;
+    });
+}
+
+// 健康检查
+bool S7_BASE::CheckConnection()
+{
+    bool ok = false;
+    execute(PriorityManual, [&]() {
+        if(!client || !connected) return;
+
+        int linked = 0;
+        if(Cli_GetConnected(client, &linked) != 0 || !linked) {
+            trackLink(errIsoConnect);
+            return;
+        }
+        int status = 0;
+        const qint64 start = S7_Metrics::nowNs();
+        int result = Cli_GetPlcStatus(client, &status);
+        record(S7_Metrics::OpControl, result, start, 0, 1);
+        ok = result == 0;
+    });
+    return ok;
+}
+
+// 重新连接（断开与连接在I/O线程中连续执行），失败时保持链路中断状态
+bool S7_BASE::Reconnect()
+{
+    bool ok = false;
+    execute(PriorityManual, [&]() {
+        if(lastIp.isEmpty()) return;
+        const bool wasLost = linkLost;
+        Disconnect();
+        ok = Connect(lastIp, lastRack, lastSlot);
+        if(!ok && wasLost)
+            linkLost = true;
+    });
+    return ok;
+}
+
+bool S7_BASE::RestoreLink()
+{
+    bool ok = false;
+    execute(PriorityManual, [&]() {
+        ok = linkLost ? Reconnect() : bool(connected);
+    });
+    return ok;
 }
 
 // 基础字节读写实现，支持所有区域（I, Q, M, DB等）
-bool S7_BASE::ReadBytes(int area, int dbNumber, int startByte, quint8 *buffer, size_t size)
+bool S7_BASE::ReadBytes(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                        Priority priority)
+{
+    return readRaw(area, dbNumber, startByte, buffer, size, priority, nullptr) == 0;
+}
+
+int S7_BASE::ReadArea(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                      Priority priority)
+{
+    return readRaw(area, dbNumber, startByte, buffer, size, priority, nullptr);
+}
+
+int S7_BASE::DBGet(int dbNumber, QByteArray &image)
+{
+    int error = errIsoConnect;
+    execute(PriorityManual, [&]() {
+        if(!client || !connected) return;
+
+        image.resize(65536);
+        int size = image.size();
+        const qint64 start = S7_Metrics::nowNs();
+        int result = Cli_DBGet(client, dbNumber, image.data(), &size);
+        image.resize(result == 0 ? size : 0);
+        // 块信息查询一个报文，数据按PDU分包
+        const int payload = PduPayloadSize();
+        error = record(S7_Metrics::OpRead, result, start, quint64(image.size()),
+                       1 + (image.size() + payload - 1) / payload);
+    });
+    return error;
+}
+
+// 返回错误码（未连接时为 errIsoConnect），execMs 非空时带回PLC执行耗时
+int S7_BASE::readRaw(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                     Priority priority, int *execMs)
 {
-    if(!client || !connected) return false;
+    int error = errIsoConnect;
+    execute(priority, [&]() {
+        if(!client || !connected) return;
 
-    return Cli_ReadArea(client,
-                        area,
-                        dbNumber,
-                        startByte,
-                        static_cast<int>(size),
-                        S7WLByte,
-                        buffer) == 0;
+        const qint64 start = S7_Metrics::nowNs();
+        int result = Cli_ReadArea(client,
+                                  area,
+                                  dbNumber,
+                                  startByte,
+                                  static_cast<int>(size),
+                                  S7WLByte,
+                                  buffer);
+        const int payload = PduPayloadSize();
+        error = record(S7_Metrics::OpRead, result, start, size,
+                       static_cast<int>((size + payload - 1) / payload), execMs);
+    });
+    return error;
 }
 
 bool S7_BASE::WriteBytes(int area, int dbNumber, int startByte, const quint8 *buffer, size_t size)
 {
-    if(!client || !connected) return false;
+    bool ok = false;
+    execute(PriorityManual, [&]() {
+        if(!client || !connected) return;
+
+        const qint64 start = S7_Metrics::nowNs();
+        int result = Cli_WriteArea(client,
+                                   area,
+                                   dbNumber,
+                                   startByte,
+                                   static_cast<int>(size),
+                                   S7WLByte,
+                                   const_cast<quint8*>(buffer));
+        // 写请求还需容纳数据项头，每个报文的数据比读请求少
+        const int payload = PduLength() - 35;
+        record(S7_Metrics::OpWrite, result, start, size, static_cast<int>((size + payload - 1) / payload));
+        ok = result == 0;
+    });
+    return ok;
+}
+
+//————————————————————————————
+// 批量读写：将分散的数据项打包为尽量少的 MultiVars 请求
+int S7_BASE::ReadMultiVars(QVector<S7_MultiItem> &items, Priority priority)
+{
+    int telegrams = 0;
+    execute(priority, [&]() {
+        telegrams = transferMultiVars(items, false);
+    });
+    return telegrams;
+}
 
-    return Cli_WriteArea(client,
-                         area,
-                         dbNumber,
-                         startByte,
-                         static_cast<int>(size),
-                         S7WLByte,
-                         const_cast<quint8*>(buffer)) == 0;
+int S7_BASE::WriteMultiVars(QVector<S7_MultiItem> &items, Priority priority)
+{
+    int telegrams = 0;
+    execute(priority, [&]() {
+        telegrams = transferMultiVars(items, true);
+    });
+    return telegrams;
+}
+
+int S7_BASE::transferMultiVars(QVector<S7_MultiItem> &items, bool write)
+{
+    if(!client || !connected) {
+        for(S7_MultiItem &item : items) {
+            item.result = errIsoConnect;
+            item.execTimeMs = -1;
+        }
+        return 0;
+    }
+
+    const int pdu = PduLength();
+    const int payload = pdu - 18;
+    int telegrams = 0;
+
+    TS7DataItem batch[MaxVars];
+    int batchIndex[MaxVars];
+    int count = 0;
+    int requestBytes = 12;   // 报文头10字节 + 功能码/项数2字节
+    int responseBytes = 14;  // 应答头12字节 + 功能码/项数2字节
+
+    auto flush = [&]() {
+        if(count == 0) return;
+        // 本请求中前面的报文已使链路中断，剩余的项不再发送
+        if(!connected) {
+            for(int k = 0; k < count; ++k) {
+                items[batchIndex[k]].result = errIsoConnect;
+                items[batchIndex[k]].execTimeMs = -1;
+            }
+        } else {
+            const qint64 start = S7_Metrics::nowNs();
+            int rc = write ? Cli_WriteMultiVars(client, batch, count)
+                           : Cli_ReadMultiVars(client, batch, count);
+            telegrams++;
+            // 报文成功但有数据项失败时，以第一个失败项的错误码计入统计
+            int failure = rc;
+            quint64 bytes = 0;
+            for(int k = 0; k < count; ++k) {
+                items[batchIndex[k]].result = (rc != 0) ? rc : batch[k].Result;
+                if(failure == 0)
+                    failure = batch[k].Result;
+                bytes += quint64(batch[k].Amount);
+            }
+            int execMs = -1;
+            record(write ? S7_Metrics::OpWriteMulti : S7_Metrics::OpReadMulti, failure, start, bytes, 1, &execMs);
+            for(int k = 0; k < count; ++k)
+                items[batchIndex[k]].execTimeMs = execMs;
+        }
+        count = 0;
+        requestBytes = 12;
+        responseBytes = 14;
+    };
+
+    for(int i = 0; i < items.size(); ++i) {
+        S7_MultiItem &item = items[i];
+        // 每项：地址描述12字节；数据区4字节头 + 数据（奇数长度补齐1字节）
+        int dataCost = 4 + item.size + (item.size & 1);
+        int reqCost = write ? 12 + dataCost : 12;
+        int resCost = write ? 1 : dataCost;
+
+        // 单项超过PDU时无法打包，改用 ReadArea/WriteArea 由snap7自动分包
+        if(12 + reqCost > pdu || 14 + resCost > pdu) {
+            if(!connected) {
+                item.result = errIsoConnect;
+                item.execTimeMs = -1;
+                continue;
+            }
+            const qint64 start = S7_Metrics::nowNs();
+            item.result = write ? Cli_WriteArea(client, item.area, item.dbNumber, item.start,
+                                                item.size, item.wordLen, item.buffer)
+                                : Cli_ReadArea(client, item.area, item.dbNumber, item.start,
+                                               item.size, item.wordLen, item.buffer);
+            const int parts = (item.size + payload - 1) / payload;
+            telegrams += parts;
+            record(write ? S7_Metrics::OpWrite : S7_Metrics::OpRead, item.result, start,
+                   quint64(item.size), parts, &item.execTimeMs);
+            continue;
+        }
+
+        if(count == MaxVars || requestBytes + reqCost > pdu || responseBytes + resCost > pdu)
+            flush();
+
+        TS7DataItem &data = batch[count];
+        data.Area = item.area;
+        data.WordLen = item.wordLen;
+        data.Result = 0;
+        data.DBNumber = item.dbNumber;
+        data.Start = item.start;
+        data.Amount = item.size;
+        data.pdata = item.buffer;
+        batchIndex[count] = i;
+        count++;
+        requestBytes += reqCost;
+        responseBytes += resCost;
+    }
+    flush();
+    return telegrams;
+}
+
+// 记录一次操作：PLC侧耗时取自 Cli_GetExecTime，排队等待只计入请求中的第一个操作。
+// 返回细化后的错误码，execMs 非空时带回PLC执行耗时（毫秒）
+int S7_BASE::record(S7_Metrics::Op op, int result, qint64 startNs, quint64 bytes, int pdus,
+                    int *execMs)
+{
+    S7_Metrics::Sample sample;
+    sample.serviceUs = (S7_Metrics::nowNs() - startNs) / 1000;
+    sample.queueWaitUs = queueWaitUs;
+    queueWaitUs = 0;
+    sample.bytes = bytes;
+    sample.pdus = pdus;
+    int exec = 0;
+    if(Cli_GetExecTime(client, &exec) == 0)
+        sample.plcExecUs = qint64(exec) * 1000;
+    if(execMs)
+        *execMs = sample.plcExecUs >= 0 ? exec : -1;
+    if(result != 0) {
+        int lastError = 0;
+        sample.result = (Cli_GetLastError(client, &lastError) == 0 && lastError != 0) ? lastError : result;
+    }
+    trackLink(sample.result);
+    S7_Metrics::record(op, sample);
+    return sample.result;
+}
+
+// 协商后的PDU长度（连接时记录），未连接时返回S7默认值240；不经I/O线程，可在任意线程调用
+int S7_BASE::PduLength()
+{
+    return connected ? pduLength.load() : 240;
+}
+
+// 单个读请求的最大数据长度（PDU减去18字节的报文头）
+int S7_BASE::PduPayloadSize()
+{
+    return PduLength() - 18;
+}
+
+//————————————————————————————
+// 带质量码的读取：一次读取给出值、质量、错误码、时间戳与PLC执行耗时
+template <typename T, typename Decode>
+S7_Result<T> S7_BASE::readTyped(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                                Decode decode)
+{
+    S7_Result<T> result;
+    result.error = readRaw(area, dbNumber, startByte, buffer, size, PriorityManual, &result.execTimeMs);
+    result.timestamp = QDateTime::currentMSecsSinceEpoch();
+    if(result.error == 0) {
+        result.value = decode(buffer);
+        result.quality = QualityGood;
+    }
+    return result;
+}
+
+S7_Result<bool> S7_BASE::ReadBoolResult(int area, int dbNumber, int startByte, int bitPosition)
+{
+    quint8 buffer = 0;
+    return readTyped<bool>(area, dbNumber, startByte, &buffer, 1, [bitPosition](const quint8 *data) {
+        return GetBool(data, bitPosition);
+    });
+}
+
+S7_Result<int> S7_BASE::ReadIntResult(int area, int dbNumber, int startByte)
+{
+    quint8 buffer[2] = {0};
+    return readTyped<int>(area, dbNumber, startByte, buffer, 2, &S7_BASE::GetInt);
+}
+
+S7_Result<float> S7_BASE::ReadFloatResult(int area, int dbNumber, int startByte)
+{
+    quint8 buffer[4] = {0};
+    return readTyped<float>(area, dbNumber, startByte, buffer, 4, &S7_BASE::GetFloat);
+}
+
+S7_Result<QString> S7_BASE::ReadStringResult(int area, int dbNumber, int startByte, quint16 maxLength)
+{
+    QByteArray buffer(maxLength + 2, 0);
+    return readTyped<QString>(area, dbNumber, startByte, reinterpret_cast<quint8*>(buffer.data()),
+                              buffer.size(), [maxLength](const quint8 *data) {
+        return GetString(data, maxLength);
+    });
+}
+
+S7_Result<char> S7_BASE::ReadCharResult(int area, int dbNumber, int startByte)
+{
+    quint8 buffer = 0;
+    return readTyped<char>(area, dbNumber, startByte, &buffer, 1, &S7_BASE::GetChar);
 }
 
 // 读取bool
 bool S7_BASE::ReadBool(int area, int dbNumber, int startByte, int bitPosition)
 {
-    quint8 buffer;
-    if(ReadBytes(area, dbNumber, startByte, &buffer, 1)) {
-        return (buffer & (1 << bitPosition)) != 0;
-    }
-    return false;
+    return ReadBoolResult(area, dbNumber, startByte, bitPosition).value;
 }
 
-// 写入bool
+// 写入bool：S7WLBit 的起始地址为 字节*8+位，PLC只修改该位，同一字节的其他位不受影响
 bool S7_BASE::WriteBool(int area, int dbNumber, int startByte, int bitPosition, bool value)
 {
-    quint8 buffer;
-    if(!ReadBytes(area, dbNumber, startByte, &buffer, 1))
-        return false;
-
-    if(value)
-        buffer |= (1 << bitPosition);
-    else
-        buffer &= ~(1 << bitPosition);
+    bool ok = false;
+    execute(PriorityManual, [&]() {
+        if(!client || !connected) return;
 
-    return WriteBytes(area, dbNumber, startByte, &buffer, 1);
+        quint8 buffer = value ? 1 : 0;
+        const qint64 start = S7_Metrics::nowNs();
+        int result = Cli_WriteArea(client,
+                                   area,
+                                   dbNumber,
+                                   startByte * 8 + bitPosition,
+                                   1,
+                                   S7WLBit,
+                                   &buffer);
+        record(S7_Metrics::OpWrite, result, start, 1, 1);
+        ok = result == 0;
+    });
+    return ok;
 }
 
 // 读取int
 int S7_BASE::ReadInt(int area, int dbNumber, int startByte)
 {
-    qint16 buffer;
-    if(ReadBytes(area, dbNumber, startByte, reinterpret_cast<quint8*>(&buffer), 2)) {
-        return qFromBigEndian(buffer);  // 西门子使用大端字节序
-    }
-    return 0;
+    return ReadIntResult(area, dbNumber, startByte).value;
 }
 
 // 写入int
 bool S7_BASE::WriteInt(int area, int dbNumber, int startByte, int value)
 {
-    qint16 val = qToBigEndian(static_cast<qint16>(value));
-    return WriteBytes(area, dbNumber, startByte, reinterpret_cast<quint8*>(&val), 2);
+    quint8 buffer[2];
+    SetInt(buffer, value);
+    return WriteBytes(area, dbNumber, startByte, buffer, 2);
 }
 
 // 读取float
 float S7_BASE::ReadFloat(int area, int dbNumber, int startByte)
 {
-    quint32 buffer;
-    if(ReadBytes(area, dbNumber, startByte, reinterpret_cast<quint8*>(&buffer), 4)) {
-        buffer = qFromBigEndian(buffer);
-        return *reinterpret_cast<float*>(&buffer);
-    }
-    return 0.0f;
+    return ReadFloatResult(area, dbNumber, startByte).value;
 }
 
 // 写入float
 bool S7_BASE::WriteFloat(int area, int dbNumber, int startByte, float value)
 {
-    quint32 buffer = qToBigEndian(*reinterpret_cast<quint32*>(&value));
-    return WriteBytes(area, dbNumber, startByte, reinterpret_cast<quint8*>(&buffer), 4);
+    quint8 buffer[4];
+    SetFloat(buffer, value);
+    return WriteBytes(area, dbNumber, startByte, buffer, 4);
 }
 
 //读string
 QString S7_BASE::ReadString(int area, int dbNumber, int startByte, quint16 maxLength)
 {
-    QByteArray buffer(maxLength + 2, 0);
-    if(ReadBytes(area, dbNumber, startByte, reinterpret_cast<quint8*>(buffer.data()), buffer.size())) {
-        quint16 currentLength = static_cast<quint8>(buffer[1]); // 从第二个字节获取当前长度
-        return QString::fromLatin1(buffer.constData() + 2, qMin(currentLength, maxLength));
-    }
-    return QString();
+    return ReadStringResult(area, dbNumber, startByte, maxLength).value;
 }
 
 // 写string
 bool S7_BASE::WriteString(int area, int dbNumber, int startByte, const QString &value, quint16 maxLength)
 {
     QByteArray buffer(maxLength + 2, 0);
-    buffer[0] = static_cast<char>(maxLength);   // 第一个字节为最大长度
-    buffer[1] = static_cast<char>(value.length()); // 第二个字节为当前长度
-    QByteArray strData = value.left(maxLength).toLatin1();
-    memcpy(buffer.data() + 2, strData.constData(), strData.size());
+    SetString(reinterpret_cast<quint8*>(buffer.data()), value, maxLength);
     return WriteBytes(area, dbNumber, startByte, reinterpret_cast<quint8*>(buffer.data()), buffer.size());
 }
 
 // 读取char
 char S7_BASE::ReadChar(int area, int dbNumber, int startByte)
 {
-    quint8 buffer;
-    if(ReadBytes(area, dbNumber, startByte, &buffer, 1)) {
-        return static_cast<char>(buffer);
-    }
-    return 0;
+    return ReadCharResult(area, dbNumber, startByte).value;
 }
 
 // 写入char
 bool S7_BASE::WriteChar(int area, int dbNumber, int startByte, char value)
 {
-    quint8 buffer = static_cast<quint8>(value);
+    quint8 buffer;
+    SetChar(&buffer, value);
     return WriteBytes(area, dbNumber, startByte, &buffer, 1);
 }
 
+//————————————————————————————
+// 错误码转文字
+QString S7_BASE::ErrorText(int code)
+{
+    char text[256] = {0};
+    Cli_ErrorText(code, text, sizeof(text));
+    return QString::fromLatin1(text);
+}
+
+//————————————————————————————
+// 缓冲区解析，data 指向变量在缓冲区中的起始字节
+bool S7_BASE::GetBool(const quint8 *data, int bitPosition)
+{
+    return (data[0] & (1 << bitPosition)) != 0;
+}
+
+int S7_BASE::GetInt(const quint8 *data)
+{
+    return qFromBigEndian<qint16>(data);  // 西门子使用大端字节序
+}
+
+float S7_BASE::GetFloat(const quint8 *data)
+{
+    quint32 raw = qFromBigEndian<quint32>(data);
+    float value;
+    memcpy(&value, &raw, sizeof(value));
+    return value;
+}
+
+QString S7_BASE::GetString(const quint8 *data, quint16 maxLength)
+{
+    quint16 currentLength = data[1]; // 从第二个字节获取当前长度
+    return QString::fromLatin1(reinterpret_cast<const char*>(data) + 2, qMin(currentLength, maxLength));
+}
+
+char S7_BASE::GetChar(const quint8 *data)
+{
+    return static_cast<char>(data[0]);
+}
+
+//————————————————————————————
+// 缓冲区编码，data 指向变量在缓冲区中的起始字节
+void S7_BASE::SetInt(quint8 *data, int value)
+{
+    qToBigEndian<qint16>(static_cast<qint16>(value), data);
+}
+
+void S7_BASE::SetFloat(quint8 *data, float value)
+{
+    quint32 raw;
+    memcpy(&raw, &value, sizeof(raw));
+    qToBigEndian<quint32>(raw, data);
+}
+
+void S7_BASE::SetString(quint8 *data, const QString &value, quint16 maxLength)
+{
+    QByteArray strData = value.left(maxLength).toLatin1();
+    data[0] = static_cast<quint8>(maxLength);       // 第一个字节为最大长度
+    data[1] = static_cast<quint8>(strData.size());  // 第二个字节为当前长度
+    memset(data + 2, 0, maxLength);
+    memcpy(data + 2, strData.constData(), strData.size());
+}
+
+void S7_BASE::SetChar(quint8 *data, char value)
+{
+    data[0] = static_cast<quint8>(value);
+}
+
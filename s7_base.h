@@ -3,23 +3,85 @@
 
 #include <QString>
 #include <QByteArray>
+#include <QVector>
+#include <QThread>
+#include <QSemaphore>
+#include <atomic>
+#include <functional>
+#include <type_traits>
 #include <Lib/snap7.h>
+#include "s7_queue.h"
+#include "s7_metrics.h"
+#include "s7_result.h"
 
+// 批量读写的单个数据项，默认按字节读写；wordLen 为 S7WLBit 时 start 为 字节*8+位，size 为1
+struct S7_MultiItem {
+    int area = 0;
+    int dbNumber = 0;
+    int start = 0;
+    int size = 0;
+    quint8 *buffer = nullptr;
+    int result = 0;         // 该项的结果码，0为成功
+    int execTimeMs = -1;    // 所在报文的PLC侧执行耗时（毫秒），-1表示未发送
+    int wordLen = S7WLByte;
+};
+
+// S7通信基础类：所有操作经无锁请求队列交给唯一的I/O线程执行，可被多个线程同时调用
 class S7_BASE
 {
 public:
-    S7_BASE();
+    // 请求优先级：手动读写优先于循环采集
+    enum Priority {
+        PriorityManual,
+        PriorityCyclic
+    };
+
+    // useIoThread 为 false 时不创建I/O线程，操作在调用线程中直接执行，由调用方保证串行
+    explicit S7_BASE(bool useIoThread = true);
     ~S7_BASE();
 
     bool Connect(const QString &ip, int rack, int slot);
     void Disconnect();
-    bool isConnected();
+    bool isConnected();     // 链路当前是否已连接
+
+    // 链路中断：操作返回TCP/ISO层错误或健康检查失败时关闭套接字并置位，
+    // 之后的操作直接失败、不再发送报文，直到重连成功或调用 Disconnect
+    bool IsLinkLost() const;
+    int LinkError() const;  // 导致中断的错误码
+    qint64 IdleMs() const;  // 距上次成功通信的毫秒数
+    // 仅在链路中断时使用上次的参数重连，与 Disconnect 在I/O线程中串行，不会覆盖用户的断开操作
+    bool RestoreLink();
+    // 错误码是否表示链路故障（TCP/ISO层错误或应答错乱），PLC拒绝某个数据项不算
+    static bool IsLinkError(int code);
+
+    // 连接类型（CONNTYPE_PG/CONNTYPE_OP/CONNTYPE_BASIC），需在 Connect 之前设置
+    void SetConnectionType(quint16 type);
+    // 健康检查：确认套接字仍连接且PLC能应答状态查询
+    bool CheckConnection();
+    // 使用上次的IP/机架/插槽重新连接
+    bool Reconnect();
 
     // 支持多区域操作
-    bool ReadBytes(int area, int dbNumber, int startByte, quint8 *buffer, size_t size);
+    bool ReadBytes(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                   Priority priority = PriorityManual);
     bool WriteBytes(int area, int dbNumber, int startByte, const quint8 *buffer, size_t size);
+    // 同 ReadBytes，返回错误码；超过PDU的长度由snap7按PDU分包读取
+    int ReadArea(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                 Priority priority = PriorityManual);
+    // 读取整个DB（Cli_DBGet），DB长度由块信息查询得到，返回错误码。
+    // PLC需支持块信息查询，S7-1200/1500的优化访问DB不支持，此时改用 ReadArea 并指定长度
+    int DBGet(int dbNumber, QByteArray &image);
 
-    // 对应不同数据类型的读写
+    // 分散数据项的批量读写：每个请求最多打包 MaxVars 项且不超过PDU长度，
+    // 返回发送的报文数，各项结果写入 result
+    int ReadMultiVars(QVector<S7_MultiItem> &items, Priority priority = PriorityManual);
+    int WriteMultiVars(QVector<S7_MultiItem> &items, Priority priority = PriorityManual);
+
+    // 提交后立即返回：fn 按优先级排队，在I/O线程中执行（直连模式下在调用线程中直接执行），
+    // fn 内调用本类的读写不再排队。供界面线程发起手动操作而不阻塞，结果由 fn 自行送回
+    void Post(Priority priority, std::function<void()> fn);
+
+    // 对应不同数据类型的读写，WriteBool 以 S7WLBit 一个报文写入单个位，不读-改-写
     bool ReadBool(int area, int dbNumber, int startByte, int bitPosition);
     bool WriteBool(int area, int dbNumber, int startByte, int bitPosition, bool value);
 
@@ -35,10 +97,97 @@ public:
     char ReadChar(int area, int dbNumber, int startByte);
     bool WriteChar(int area, int dbNumber, int startByte, char value);
 
+    // 带质量码的读取：失败时质量为 QualityBad 并给出错误码，不再以0/false表示失败。
+    // 上面不带质量码的读取函数保留兼容，失败时仍返回默认值
+    S7_Result<bool> ReadBoolResult(int area, int dbNumber, int startByte, int bitPosition);
+    S7_Result<int> ReadIntResult(int area, int dbNumber, int startByte);
+    S7_Result<float> ReadFloatResult(int area, int dbNumber, int startByte);
+    S7_Result<QString> ReadStringResult(int area, int dbNumber, int startByte, quint16 maxLength);
+    S7_Result<char> ReadCharResult(int area, int dbNumber, int startByte);
+
+    // 协商后的PDU长度（连接时记录，直接读取不排队），及单个读请求可承载的最大数据字节数
+    int PduLength();
+    int PduPayloadSize();
+
+    // 错误码转文字
+    static QString ErrorText(int code);
+
+    // 从已读取的原始缓冲区中解析数据（大端字节序）
+    static bool GetBool(const quint8 *data, int bitPosition);
+    static int GetInt(const quint8 *data);
+    static float GetFloat(const quint8 *data);
+    static QString GetString(const quint8 *data, quint16 maxLength);
+    static char GetChar(const quint8 *data);
+
+    // 将数据编码到待写入的缓冲区（大端字节序），string 需 maxLength+2 字节
+    static void SetInt(quint8 *data, int value);
+    static void SetFloat(quint8 *data, float value);
+    static void SetString(quint8 *data, const QString &value, quint16 maxLength);
+    static void SetChar(quint8 *data, char value);
+
 private:
+    // I/O请求：在调用方栈上构造，入队后等待完成，不分配内存
+    struct IoRequest : S7_QueueNode {
+        void (*invoke)(void *context);
+        void *context;
+        QSemaphore *done;       // 调用线程专用的信号量
+        qint64 enqueuedNs;      // 入队时刻，用于统计排队等待
+    };
+    // Post 提交的请求：在堆上分配，done 为空，由I/O线程执行后释放
+    struct PostedRequest : IoRequest {
+        std::function<void()> fn;
+    };
+
+    template <typename F>
+    void execute(Priority priority, F &&fn);
+    void ioLoop();
+    static QSemaphore &callerSemaphore();
+    int transferMultiVars(QVector<S7_MultiItem> &items, bool write);
+    int readRaw(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                Priority priority, int *execMs);
+    template <typename T, typename Decode>
+    S7_Result<T> readTyped(int area, int dbNumber, int startByte, quint8 *buffer, size_t size,
+                           Decode decode);
+    int record(S7_Metrics::Op op, int result, qint64 startNs, quint64 bytes, int pdus,
+               int *execMs = nullptr);
+    void trackLink(int result);
+
+    QThread *ioThread;              // 唯一的I/O线程，直连模式下为空
+    S7_MpscQueue queues[2];         // 按优先级分开的请求队列
+    QSemaphore wakeup;              // 每入队一个请求释放一次
+    qint64 queueWaitUs;             // 当前请求的排队等待，由执行请求的线程读写
+
     S7Object client;  // S7客户端对象
-    bool connected;  // 是否已连接
+    std::atomic<bool> connected;  // 是否已连接
+    std::atomic<bool> linkLost;   // 链路中断，等待重连
+    std::atomic<int> linkError;
+    std::atomic<qint64> lastOkNs; // 上次成功通信的时刻
+    std::atomic<int> pduLength;   // 连接时协商的PDU长度
+    quint16 connType; // 连接类型
+    QString lastIp;   // 上次连接参数，用于重连
+    int lastRack;
+    int lastSlot;
 };
 
+// 在I/O线程中执行 fn 并等待完成；直连模式或已在I/O线程中时直接执行
+template <typename F>
+void S7_BASE::execute(Priority priority, F &&fn)
+{
+    if(!ioThread || QThread::currentThread() == ioThread) {
+        fn();
+        return;
+    }
+
+    using Fn = typename std::remove_reference<F>::type;
+    IoRequest request;
+    request.invoke = [](void *context) { (*static_cast<Fn*>(context))(); };
+    request.context = &fn;
+    request.done = &callerSemaphore();
+    request.enqueuedNs = S7_Metrics::nowNs();
+    queues[priority].push(&request);
+    wakeup.release();
+    request.done->acquire();
+}
+
 #endif
 
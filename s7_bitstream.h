@@ -0,0 +1,94 @@
+﻿#ifndef S7_BITSTREAM_H
+#define S7_BITSTREAM_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+// 位流写入：高位在前，缓冲区按字节增长，clear() 保留容量
+class S7_BitWriter
+{
+public:
+    S7_BitWriter() : bitCount(0) {}
+
+    void clear()
+    {
+        bytes.resize(0);
+        bitCount = 0;
+    }
+
+    void reserve(int byteCount)
+    {
+        bytes.reserve(byteCount);
+    }
+
+    // 写入 value 的低 n 位（n <= 64）
+    void writeBits(quint64 value, int n)
+    {
+        while (n > 0) {
+            const int used = bitCount & 7;
+            if (used == 0)
+                bytes.append('\0');
+            const int room = 8 - used;
+            const int take = n < room ? n : room;
+            const quint8 part = static_cast<quint8>((value >> (n - take)) & ((1u << take) - 1));
+            bytes.data()[bytes.size() - 1] |= static_cast<char>(part << (room - take));
+            bitCount += take;
+            n -= take;
+        }
+    }
+
+    void writeBit(bool bit)
+    {
+        writeBits(bit ? 1 : 0, 1);
+    }
+
+    const QByteArray &data() const { return bytes; }
+    qint64 bits() const { return bitCount; }
+
+private:
+    QByteArray bytes;
+    qint64 bitCount;
+};
+
+// 位流读取：直接读取外部缓冲区（可为内存映射文件），越界时返回 0 并置错误标志
+class S7_BitReader
+{
+public:
+    S7_BitReader(const uchar *data, qint64 byteCount)
+        : buffer(data), totalBits(byteCount * 8), position(0), overrun(false) {}
+
+    quint64 readBits(int n)
+    {
+        quint64 value = 0;
+        if (position + n > totalBits) {
+            overrun = true;
+            position = totalBits;
+            return 0;
+        }
+        while (n > 0) {
+            const int used = static_cast<int>(position & 7);
+            const int room = 8 - used;
+            const int take = n < room ? n : room;
+            const quint8 byte = buffer[position >> 3];
+            value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+            position += take;
+            n -= take;
+        }
+        return value;
+    }
+
+    bool readBit()
+    {
+        return readBits(1) != 0;
+    }
+
+    bool failed() const { return overrun; }
+
+private:
+    const uchar *buffer;
+    qint64 totalBits;
+    qint64 position;
+    bool overrun;
+};
+
+#endif
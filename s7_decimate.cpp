@@ -0,0 +1,80 @@
+﻿/******************************************************************************
+ * @file    s7_decimate.cpp
+ * @brief   趋势图抽稀算法
+ *
+ * @details
+ * 功能描述：
+ *    - LTTB 算法：首尾点固定，中间按桶选取与前一选中点、后一桶均值构成最大三角形的点
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现 LTTB 抽稀
+ *****************************************************************************/
+
+#include "s7_decimate.h"
+#include <cmath>
+
+void lttbSelect(const qint64 *times, const double *values, int n, int threshold, QVector<int> &out)
+{
+    out.resize(0);
+    if (n <= 0)
+        return;
+    if (threshold >= n) {
+        for (int i = 0; i < n; ++i)
+            out.append(i);
+        return;
+    }
+    if (threshold < 3) {
+        out.append(0);
+        if (n > 1)
+            out.append(n - 1);
+        return;
+    }
+
+    // 时间以首点为原点，避免大数相乘损失精度
+    const qint64 origin = times[0];
+    const double every = double(n - 2) / (threshold - 2);
+    int selected = 0;
+    out.append(0);
+
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        // 下一桶的均值点
+        int nextBegin = int(std::floor((bucket + 1) * every)) + 1;
+        int nextEnd = qMin(int(std::floor((bucket + 2) * every)) + 1, n);
+        if (bucket == threshold - 3) {
+            nextBegin = n - 1;
+            nextEnd = n;
+        }
+        double avgT = 0;
+        double avgV = 0;
+        for (int i = nextBegin; i < nextEnd; ++i) {
+            avgT += double(times[i] - origin);
+            avgV += values[i];
+        }
+        const int nextCount = qMax(1, nextEnd - nextBegin);
+        avgT /= nextCount;
+        avgV /= nextCount;
+
+        // 当前桶中与选中点、下一桶均值构成三角形面积最大的点
+        const int begin = int(std::floor(bucket * every)) + 1;
+        const int end = int(std::floor((bucket + 1) * every)) + 1;
+        const double aT = double(times[selected] - origin);
+        const double aV = values[selected];
+        double bestArea = -1;
+        int best = begin;
+        for (int i = begin; i < end; ++i) {
+            const double area = std::fabs((aT - avgT) * (values[i] - aV)
+                                          - (aT - double(times[i] - origin)) * (avgV - aV));
+            if (area > bestArea) {
+                bestArea = area;
+                best = i;
+            }
+        }
+        out.append(best);
+        selected = best;
+    }
+    out.append(n - 1);
+}
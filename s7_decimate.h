@@ -0,0 +1,33 @@
+﻿#ifndef S7_DECIMATE_H
+#define S7_DECIMATE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+// 绘图抽稀：每像素一列，记录列内首值、末值、最小值、最大值，
+// 折线按 首->最小/最大->末 绘制，峰值不会丢失
+struct TrendColumn {
+    double first = 0;
+    double last = 0;
+    double min = 0;
+    double max = 0;
+    int count = 0;
+
+    void add(double value)
+    {
+        if (count == 0) {
+            first = min = max = value;
+        } else {
+            if (value < min) min = value;
+            if (value > max) max = value;
+        }
+        last = value;
+        count++;
+    }
+};
+
+// LTTB（Largest-Triangle-Three-Buckets）：从 n 个点中选出 threshold 个保留形状的点，
+// 结果为点下标（升序），n <= threshold 时全部保留
+void lttbSelect(const qint64 *times, const double *values, int n, int threshold, QVector<int> &out);
+
+#endif
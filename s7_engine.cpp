@@ -0,0 +1,306 @@
+﻿/******************************************************************************
+ * @file    s7_engine.cpp
+ * @brief   多PLC采集引擎，固定线程池驱动多个PLC的批量调度
+ *
+ * @details
+ * 功能描述：
+ *    - 管理多个PLC端点，每个端点拥有独立的连接、任务表和调度器
+ *    - 分发器按各端点的下次到期时间把批次交给固定大小的线程池执行，线程数与PLC数量无关
+ *    - 连接在独立的连接通道（小线程池）中建立，不占用采集线程；
+ *      失败或掉线后按带抖动的指数退避重试，任务与变量表保持不变
+ *    - 统计各PLC的批次数、读取成功/失败数、报文数、连接次数与耗时
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现多PLC采集引擎
+ *   2026-10-16 结果写入各PLC的变量表，按批次通知
+ *   2026-10-16 任务支持变化过滤，仅在有变量变化时通知
+ *   2026-10-16 重连改为指数退避，链路错误后立即尝试一次重连
+ *   2026-10-16 掉线只依据链路错误判断，整批失败时不再发送状态查询
+ *   2026-10-16 连接尝试移到独立的连接通道，不可达的PLC不再占用采集线程
+ *   2026-10-16 批次结束时只降低到期时间，不覆盖执行期间新增任务的立即执行请求
+ *****************************************************************************/
+
+#include "s7_engine.h"
+#include <QThread>
+#include <limits>
+
+static const qint64 IdleDue = std::numeric_limits<qint64>::max();
+
+// 到期时间只降不升，多个线程同时设置时保留最早的
+static void lowerDue(std::atomic<qint64> &target, qint64 due)
+{
+    qint64 current = target.load();
+    while (due < current && !target.compare_exchange_weak(current, due)) {
+    }
+}
+
+S7_Engine::S7_Engine(int workerCount, QObject *parent)
+    : QObject(parent),
+    nextPlcId(1),
+    running(false),
+    reconnectMs(500),
+    reconnectMaxMs(30000),
+    maxGapBytes(16)
+{
+    workers.setMaxThreadCount(workerCount > 0 ? workerCount : qMax(2, QThread::idealThreadCount()));
+    connectors.setMaxThreadCount(4);
+    clock.start();
+    dispatchTimer = new QTimer(this);
+    dispatchTimer->setSingleShot(true);
+    dispatchTimer->setTimerType(Qt::PreciseTimer);
+    connect(dispatchTimer, &QTimer::timeout, this, &S7_Engine::dispatch);
+}
+
+S7_Engine::~S7_Engine()
+{
+    stop();
+    for (Endpoint *ep : qAsConst(endpoints)) {
+        ep->s7.Disconnect();
+        releaseEndpoint(ep);
+    }
+    endpoints.clear();
+}
+
+//————————————————————————————
+// 端点管理
+int S7_Engine::addEndpoint(const QString &ip, int rack, int slot, quint16 connectionType)
+{
+    Endpoint *ep = new Endpoint;
+    ep->id = nextPlcId++;
+    ep->ip = ip;
+    ep->rack = rack;
+    ep->slot = slot;
+    ep->s7.SetConnectionType(connectionType);
+    ep->scheduler = new S7_Scheduler(&ep->s7);
+    ep->scheduler->setMaxGap(maxGapBytes);
+    ep->scheduler->setTagTable(&ep->tags);
+
+    endpoints.insert(ep->id, ep);
+    scheduleDispatch();
+    return ep->id;
+}
+
+void S7_Engine::removeEndpoint(int plcId)
+{
+    Endpoint *ep = endpoints.take(plcId);
+    if (!ep)
+        return;
+    // 正在执行的端点交给工作线程在批次结束后释放
+    if (ep->state.exchange(Removed) == Idle)
+        releaseEndpoint(ep);
+}
+
+void S7_Engine::releaseEndpoint(Endpoint *ep)
+{
+    ep->s7.Disconnect();
+    delete ep->scheduler;
+    delete ep;
+}
+
+QList<int> S7_Engine::endpointIds() const
+{
+    return endpoints.keys();
+}
+
+int S7_Engine::endpointCount() const
+{
+    return endpoints.size();
+}
+
+bool S7_Engine::addTask(int plcId, int taskId, const TagAddress &tag, int interval,
+                        const TagFilter &filter)
+{
+    Endpoint *ep = endpoints.value(plcId);
+    if (!ep)
+        return false;
+    ep->tags.defineTag(taskId, QString(), tag, filter);
+    ep->scheduler->addTask(taskId, tag, interval);
+    lowerDue(ep->nextDue, 0);   // 批次执行中时由工作线程保留
+    scheduleDispatch();
+    return true;
+}
+
+bool S7_Engine::removeTask(int plcId, int taskId)
+{
+    Endpoint *ep = endpoints.value(plcId);
+    if (!ep)
+        return false;
+    ep->scheduler->removeTask(taskId);
+    ep->tags.removeTag(taskId);
+    return true;
+}
+
+EndpointStats S7_Engine::endpointStats(int plcId) const
+{
+    EndpointStats stats;
+    Endpoint *ep = endpoints.value(plcId);
+    if (!ep)
+        return stats;
+
+    stats.plcId = ep->id;
+    stats.address = QString("%1/%2/%3").arg(ep->ip).arg(ep->rack).arg(ep->slot);
+    stats.connected = ep->linked;
+    stats.taskCount = ep->scheduler->taskCount();
+    stats.passes = ep->passes;
+    stats.tagsRead = ep->tagsRead;
+    stats.tagsFailed = ep->tagsFailed;
+    stats.pdusSent = ep->pdusSent;
+    stats.connectAttempts = ep->connectAttempts;
+    stats.connectFailures = ep->connectFailures;
+    stats.busyUs = ep->busyUs;
+    stats.lastElapsedUs = ep->lastElapsedUs;
+    return stats;
+}
+
+const S7_TagTable *S7_Engine::tagTable(int plcId) const
+{
+    Endpoint *ep = endpoints.value(plcId);
+    return ep ? &ep->tags : nullptr;
+}
+
+int S7_Engine::workerCount() const
+{
+    return workers.maxThreadCount();
+}
+
+void S7_Engine::setConnectLanes(int count)
+{
+    connectors.setMaxThreadCount(qMax(1, count));
+}
+
+int S7_Engine::connectLanes() const
+{
+    return connectors.maxThreadCount();
+}
+
+void S7_Engine::setReconnectInterval(int initialMs, int maximumMs)
+{
+    reconnectMs = qMax(100, initialMs);
+    reconnectMaxMs = qMax(reconnectMs.load(), maximumMs);
+}
+
+void S7_Engine::setMaxGap(int bytes)
+{
+    maxGapBytes = qMax(0, bytes);
+    for (Endpoint *ep : qAsConst(endpoints))
+        ep->scheduler->setMaxGap(maxGapBytes);
+}
+
+//————————————————————————————
+// 启动与停止
+void S7_Engine::start()
+{
+    running = true;
+    dispatch();
+}
+
+void S7_Engine::stop()
+{
+    running = false;
+    dispatchTimer->stop();
+    workers.waitForDone();
+    connectors.waitForDone();
+}
+
+void S7_Engine::scheduleDispatch()
+{
+    if (running)
+        QMetaObject::invokeMethod(this, "dispatch", Qt::QueuedConnection);
+}
+
+// 分发：到期且空闲的端点交给线程池（未连接的交给连接通道），定时器对准剩余端点中最早的到期时间
+void S7_Engine::dispatch()
+{
+    if (!running)
+        return;
+
+    const qint64 now = clock.elapsed();
+    qint64 next = IdleDue;
+    for (Endpoint *ep : qAsConst(endpoints)) {
+        if (ep->state.load() != Idle)
+            continue;
+        qint64 due = ep->nextDue;
+        if (due > now) {
+            next = qMin(next, due);
+            continue;
+        }
+        int expected = Idle;
+        if (!ep->state.compare_exchange_strong(expected, Busy))
+            continue;
+        if (ep->linked)
+            workers.start([this, ep]() { runEndpoint(ep); });
+        else
+            connectors.start([this, ep]() { connectEndpoint(ep); });
+    }
+
+    if (next == IdleDue)
+        dispatchTimer->stop();
+    else
+        dispatchTimer->start(static_cast<int>(qMax<qint64>(0, next - clock.elapsed())));
+}
+
+// 连接通道：建立连接，成功后立即参与分发，失败按退避推迟下一次尝试
+void S7_Engine::connectEndpoint(Endpoint *ep)
+{
+    ep->connectAttempts++;
+    if (ep->s7.Connect(ep->ip, ep->rack, ep->slot)) {
+        ep->linked = true;
+        ep->backoff.reset();
+        ep->nextDue = clock.elapsed();
+        emit endpointStateChanged(ep->id, true);
+    } else {
+        ep->connectFailures++;
+        ep->backoff.initialMs = reconnectMs;
+        ep->backoff.maximumMs = reconnectMaxMs;
+        ep->nextDue = clock.elapsed() + ep->backoff.next();
+    }
+    finishEndpoint(ep);
+}
+
+// 工作线程：执行一个批次并累计计数。
+// 开始前把到期时间置为空闲，执行期间 addTask 写入的立即执行请求在结束时不会被覆盖
+void S7_Engine::runEndpoint(Endpoint *ep)
+{
+    ep->nextDue = IdleDue;
+    const qint64 now = clock.elapsed();
+
+    qint64 due = ep->scheduler->poll(now);
+    TickStats tick = ep->scheduler->lastStats();
+    if (tick.tickIndex != ep->lastTick) {
+        ep->lastTick = tick.tickIndex;
+        ep->passes++;
+        ep->tagsRead += tick.tagsServed - tick.tagsFailed;
+        ep->tagsFailed += tick.tagsFailed;
+        ep->pdusSent += tick.pdusSent;
+        ep->busyUs += tick.elapsedUs;
+        ep->lastElapsedUs = tick.elapsedUs;
+        if (tick.tagsChanged > 0)
+            emit endpointUpdated(ep->id);
+
+        // 读取返回链路错误即视为掉线（数据项被拒绝不算），立即尝试重连一次
+        if (ep->s7.IsLinkLost()) {
+            ep->s7.Disconnect();
+            ep->linked = false;
+            due = clock.elapsed();
+            emit endpointStateChanged(ep->id, false);
+        }
+    }
+    if (due >= 0)
+        lowerDue(ep->nextDue, due);
+    finishEndpoint(ep);
+}
+
+// 批次或连接尝试结束：恢复空闲并重新分发，执行期间已被移除的端点在此释放
+void S7_Engine::finishEndpoint(Endpoint *ep)
+{
+    int expected = Busy;
+    if (!ep->state.compare_exchange_strong(expected, Idle)) {
+        releaseEndpoint(ep);    // 执行期间已被移除
+        return;
+    }
+    QMetaObject::invokeMethod(this, "dispatch", Qt::QueuedConnection);
+}
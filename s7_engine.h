@@ -0,0 +1,127 @@
+﻿#ifndef S7_ENGINE_H
+#define S7_ENGINE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <atomic>
+#include "s7_base.h"
+#include "s7_tag.h"
+#include "s7_scheduler.h"
+#include "s7_tagtable.h"
+#include "s7_backoff.h"
+
+// 单个PLC的累计计数，吞吐量由两次读取的差值除以时间间隔得到
+struct EndpointStats {
+    int plcId = 0;
+    QString address;            // IP/机架/插槽
+    bool connected = false;
+    int taskCount = 0;
+    quint64 passes = 0;         // 已执行的批次数
+    quint64 tagsRead = 0;       // 成功读取的变量数
+    quint64 tagsFailed = 0;     // 读取失败的变量数
+    quint64 pdusSent = 0;       // 发送的报文数
+    quint64 connectAttempts = 0;
+    quint64 connectFailures = 0;
+    quint64 busyUs = 0;         // 累计采集耗时（微秒）
+    int lastElapsedUs = 0;      // 最近一个批次的耗时
+};
+
+// 多PLC采集引擎：每个PLC一个连接、一张任务表和一个调度器，
+// 所有PLC共用固定大小的线程池，到期的PLC由分发器交给空闲工作线程执行一个批次。
+// 建立连接会阻塞到TCP/ISO握手结束或超时，在单独的小线程池（连接通道）中执行，
+// 不可达的PLC不会占用采集线程。
+// 除信号外，接口需在引擎所在线程中调用
+class S7_Engine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit S7_Engine(int workerCount = 0, QObject *parent = nullptr);
+    ~S7_Engine();
+
+    // 添加PLC，返回PLC编号；连接在连接通道中建立，失败后按指数退避重试
+    int addEndpoint(const QString &ip, int rack, int slot, quint16 connectionType = CONNTYPE_PG);
+    void removeEndpoint(int plcId);
+    QList<int> endpointIds() const;
+    int endpointCount() const;
+
+    bool addTask(int plcId, int taskId, const TagAddress &tag, int interval,
+                 const TagFilter &filter = TagFilter());
+    bool removeTask(int plcId, int taskId);
+
+    EndpointStats endpointStats(int plcId) const;
+    // 各PLC的变量表，变量编号即任务编号；PLC被移除后指针失效
+    const S7_TagTable *tagTable(int plcId) const;
+
+    int workerCount() const;
+    // 连接通道的线程数，同时进行的连接尝试不超过该数，默认4
+    void setConnectLanes(int count);
+    int connectLanes() const;
+    // 重连退避：首次等待 initialMs，每次失败翻倍（带抖动），不超过 maximumMs
+    void setReconnectInterval(int initialMs, int maximumMs = 30000);
+    void setMaxGap(int bytes);
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    // 某个PLC的批次中有变量发生变化，新值已写入其变量表
+    void endpointUpdated(int plcId);
+    void endpointStateChanged(int plcId, bool connected);
+
+private slots:
+    void dispatch();
+
+private:
+    // 状态流转：空闲 -> 执行中 -> 空闲；移除时若正在执行，由工作线程负责释放
+    enum EndpointState { Idle, Busy, Removed };
+
+    struct Endpoint {
+        Endpoint() : s7(false) {}
+
+        int id = 0;
+        QString ip;
+        int rack = 0;
+        int slot = 1;
+        S7_BASE s7;                         // 直连模式，同一时刻只有一个工作线程访问
+        S7_Scheduler *scheduler = nullptr;
+        S7_TagTable tags;
+        std::atomic<int> state{Idle};
+        std::atomic<qint64> nextDue{0};     // 下一次需要执行的时间，引擎时钟
+        std::atomic<bool> linked{false};
+        quint64 lastTick = 0;               // 仅工作线程访问
+        S7_Backoff backoff;                 // 仅工作线程访问
+
+        std::atomic<quint64> passes{0};
+        std::atomic<quint64> tagsRead{0};
+        std::atomic<quint64> tagsFailed{0};
+        std::atomic<quint64> pdusSent{0};
+        std::atomic<quint64> connectAttempts{0};
+        std::atomic<quint64> connectFailures{0};
+        std::atomic<quint64> busyUs{0};
+        std::atomic<int> lastElapsedUs{0};
+    };
+
+    void runEndpoint(Endpoint *ep);
+    void connectEndpoint(Endpoint *ep);
+    void finishEndpoint(Endpoint *ep);
+    static void releaseEndpoint(Endpoint *ep);
+    void scheduleDispatch();
+
+    QHash<int, Endpoint*> endpoints;
+    int nextPlcId;
+    QThreadPool workers;                    // 采集线程，只执行批次
+    QThreadPool connectors;                 // 连接通道，只执行连接尝试
+    QTimer *dispatchTimer;
+    QElapsedTimer clock;
+    bool running;
+    std::atomic<int> reconnectMs;
+    std::atomic<int> reconnectMaxMs;
+    std::atomic<int> maxGapBytes;
+};
+
+#endif
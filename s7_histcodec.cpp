@@ -0,0 +1,352 @@
+﻿/******************************************************************************
+ * @file    s7_histcodec.cpp
+ * @brief   历史数据块编解码
+ *
+ * @details
+ * 功能描述：
+ *    - 时间戳二阶差分变长编码，固定周期采样每点约1位
+ *    - float 采用 Gorilla 异或压缩，int/char 差值变长编码
+ *    - bool 与质量采用游程编码
+ *    - 块头与索引项为固定长度小端格式，可直接从内存映射文件解析
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现历史数据块编解码
+ *****************************************************************************/
+
+#include "s7_histcodec.h"
+#include <QtEndian>
+#include <QtAlgorithms>
+#include <cstring>
+
+//————————————————————————————
+// 有符号变长编码：0 -> '0'，小值用短前缀，其余写完整64位
+static void writeSigned(S7_BitWriter &writer, qint64 v)
+{
+    if (v == 0) {
+        writer.writeBits(0, 1);
+    } else if (v >= -63 && v <= 64) {
+        writer.writeBits(0x2, 2);
+        writer.writeBits(static_cast<quint64>(v + 63), 7);
+    } else if (v >= -255 && v <= 256) {
+        writer.writeBits(0x6, 3);
+        writer.writeBits(static_cast<quint64>(v + 255), 9);
+    } else if (v >= -2047 && v <= 2048) {
+        writer.writeBits(0xE, 4);
+        writer.writeBits(static_cast<quint64>(v + 2047), 12);
+    } else {
+        writer.writeBits(0xF, 4);
+        writer.writeBits(static_cast<quint64>(v), 64);
+    }
+}
+
+static qint64 readSigned(S7_BitReader &reader)
+{
+    if (!reader.readBit())
+        return 0;
+    if (!reader.readBit())
+        return static_cast<qint64>(reader.readBits(7)) - 63;
+    if (!reader.readBit())
+        return static_cast<qint64>(reader.readBits(9)) - 255;
+    if (!reader.readBit())
+        return static_cast<qint64>(reader.readBits(12)) - 2047;
+    return static_cast<qint64>(reader.readBits(64));
+}
+
+static quint64 doubleBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bitsDouble(quint64 bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//————————————————————————————
+// 索引项读写
+void HistIndexEntry::write(uchar *dst) const
+{
+    qToLittleEndian<quint32>(tagId, dst);
+    qToLittleEndian<quint32>(count, dst + 4);
+    qToLittleEndian<qint64>(minTime, dst + 8);
+    qToLittleEndian<qint64>(maxTime, dst + 16);
+    qToLittleEndian<quint64>(offset, dst + 24);
+    qToLittleEndian<quint32>(length, dst + 32);
+    dst[36] = dataType;
+    dst[37] = dst[38] = dst[39] = 0;
+}
+
+bool HistIndexEntry::read(const uchar *src)
+{
+    tagId = qFromLittleEndian<quint32>(src);
+    count = qFromLittleEndian<quint32>(src + 4);
+    minTime = qFromLittleEndian<qint64>(src + 8);
+    maxTime = qFromLittleEndian<qint64>(src + 16);
+    offset = qFromLittleEndian<quint64>(src + 24);
+    length = qFromLittleEndian<quint32>(src + 32);
+    dataType = src[36];
+    return length >= quint32(HistBlockHeader::Size) && count > 0;
+}
+
+//————————————————————————————
+// 编码器
+S7_HistEncoder::S7_HistEncoder()
+{
+    start(0, DT_Float);
+}
+
+void S7_HistEncoder::start(int tagId, DataType dataType)
+{
+    tag = tagId;
+    type = dataType;
+    samples = 0;
+    firstTs = 0;
+    prevTs = 0;
+    prevDelta = 0;
+    prevBits = 0;
+    prevLeading = -1;
+    prevTrailing = 0;
+    prevInt = 0;
+    valueRun = false;
+    valueRunLength = 0;
+    qualityRun = false;
+    qualityRunLength = 0;
+    tsStream.clear();
+    valueStream.clear();
+    qualityStream.clear();
+}
+
+// 游程编码：首位为初始值，之后每次值变化写出上一段的长度
+void S7_HistEncoder::appendRun(S7_BitWriter &writer, bool &runValue, qint64 &runLength, bool bit)
+{
+    if (runLength == 0) {
+        writer.writeBit(bit);
+        runValue = bit;
+        runLength = 1;
+    } else if (bit == runValue) {
+        runLength++;
+    } else {
+        writeSigned(writer, runLength);
+        runValue = bit;
+        runLength = 1;
+    }
+}
+
+void S7_HistEncoder::append(qint64 timestamp, double value, bool good)
+{
+    // 时间戳
+    if (samples == 0) {
+        firstTs = timestamp;
+    } else {
+        const qint64 delta = timestamp - prevTs;
+        writeSigned(tsStream, delta - prevDelta);
+        prevDelta = delta;
+    }
+    prevTs = timestamp;
+
+    // 值
+    switch (type) {
+    case DT_Float: {
+        const quint64 bits = doubleBits(value);
+        if (samples == 0) {
+            valueStream.writeBits(bits, 64);
+        } else {
+            const quint64 x = bits ^ prevBits;
+            if (x == 0) {
+                valueStream.writeBit(false);
+            } else {
+                valueStream.writeBit(true);
+                const int leading = qMin(31, int(qCountLeadingZeroBits(x)));
+                const int trailing = int(qCountTrailingZeroBits(x));
+                if (prevLeading >= 0 && leading >= prevLeading && trailing >= prevTrailing) {
+                    // 有效位落在上一个窗口内，沿用窗口
+                    valueStream.writeBit(false);
+                    valueStream.writeBits(x >> prevTrailing, 64 - prevLeading - prevTrailing);
+                } else {
+                    const int significant = 64 - leading - trailing;
+                    valueStream.writeBit(true);
+                    valueStream.writeBits(static_cast<quint64>(leading), 5);
+                    valueStream.writeBits(static_cast<quint64>(significant - 1), 6);
+                    valueStream.writeBits(x >> trailing, significant);
+                    prevLeading = leading;
+                    prevTrailing = trailing;
+                }
+            }
+        }
+        prevBits = bits;
+        break;
+    }
+    case DT_Bool:
+        appendRun(valueStream, valueRun, valueRunLength, value != 0);
+        break;
+    default: {
+        const qint64 v = static_cast<qint64>(value);
+        writeSigned(valueStream, v - prevInt);
+        prevInt = v;
+        break;
+    }
+    }
+
+    appendRun(qualityStream, qualityRun, qualityRunLength, good);
+    samples++;
+}
+
+int S7_HistEncoder::encodedBytes() const
+{
+    return HistBlockHeader::Size + tsStream.data().size() + valueStream.data().size()
+           + qualityStream.data().size() + 16;
+}
+
+QByteArray S7_HistEncoder::encode() const
+{
+    // 游程编码的最后一段在生成块时补写
+    S7_BitWriter values = valueStream;
+    if (type == DT_Bool && valueRunLength > 0)
+        writeSigned(values, valueRunLength);
+    S7_BitWriter quality = qualityStream;
+    if (qualityRunLength > 0)
+        writeSigned(quality, qualityRunLength);
+
+    const QByteArray &ts = tsStream.data();
+    const QByteArray &vs = values.data();
+    const QByteArray &qs = quality.data();
+
+    QByteArray block(HistBlockHeader::Size + ts.size() + vs.size() + qs.size(), 0);
+    uchar *dst = reinterpret_cast<uchar*>(block.data());
+    qToLittleEndian<quint16>(HistBlockHeader::Magic, dst);
+    dst[2] = static_cast<uchar>(type);
+    dst[3] = 0;
+    qToLittleEndian<quint32>(static_cast<quint32>(tag), dst + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(samples), dst + 8);
+    qToLittleEndian<quint32>(static_cast<quint32>(ts.size()), dst + 12);
+    qToLittleEndian<quint32>(static_cast<quint32>(vs.size()), dst + 16);
+    qToLittleEndian<quint32>(static_cast<quint32>(qs.size()), dst + 20);
+    qToLittleEndian<qint64>(firstTs, dst + 24);
+
+    uchar *p = dst + HistBlockHeader::Size;
+    std::memcpy(p, ts.constData(), ts.size());
+    p += ts.size();
+    std::memcpy(p, vs.constData(), vs.size());
+    p += vs.size();
+    std::memcpy(p, qs.constData(), qs.size());
+    return block;
+}
+
+//————————————————————————————
+// 解码
+bool readHistHeader(const uchar *data, qint64 size, HistBlockHeader &header)
+{
+    if (size < HistBlockHeader::Size)
+        return false;
+    header.magic = qFromLittleEndian<quint16>(data);
+    header.dataType = data[2];
+    header.tagId = qFromLittleEndian<quint32>(data + 4);
+    header.count = qFromLittleEndian<quint32>(data + 8);
+    header.tsBytes = qFromLittleEndian<quint32>(data + 12);
+    header.valueBytes = qFromLittleEndian<quint32>(data + 16);
+    header.qualityBytes = qFromLittleEndian<quint32>(data + 20);
+    header.firstTimestamp = qFromLittleEndian<qint64>(data + 24);
+    if (header.magic != HistBlockHeader::Magic)
+        return false;
+    return qint64(HistBlockHeader::Size) + header.tsBytes + header.valueBytes + header.qualityBytes <= size;
+}
+
+namespace {
+// 游程解码
+struct RunReader {
+    explicit RunReader(S7_BitReader &r) : reader(r), remaining(0), value(false), started(false) {}
+
+    bool next()
+    {
+        if (!started) {
+            value = reader.readBit();
+            remaining = readSigned(reader);
+            started = true;
+        } else if (remaining == 0) {
+            value = !value;
+            remaining = readSigned(reader);
+        }
+        remaining--;
+        return value;
+    }
+
+    S7_BitReader &reader;
+    qint64 remaining;
+    bool value;
+    bool started;
+};
+}
+
+bool decodeHistBlock(const uchar *data, qint64 size, qint64 from, qint64 to, QVector<HistPoint> &out)
+{
+    HistBlockHeader header;
+    if (!readHistHeader(data, size, header))
+        return false;
+
+    const uchar *p = data + HistBlockHeader::Size;
+    S7_BitReader tsReader(p, header.tsBytes);
+    S7_BitReader valueReader(p + header.tsBytes, header.valueBytes);
+    S7_BitReader qualityReader(p + header.tsBytes + header.valueBytes, header.qualityBytes);
+    RunReader boolRuns(valueReader);
+    RunReader qualityRuns(qualityReader);
+
+    qint64 ts = header.firstTimestamp;
+    qint64 delta = 0;
+    quint64 bits = 0;
+    int leading = 0;
+    int trailing = 0;
+    qint64 intValue = 0;
+
+    for (quint32 i = 0; i < header.count; ++i) {
+        if (i > 0) {
+            delta += readSigned(tsReader);
+            ts += delta;
+        }
+
+        double value = 0;
+        switch (header.dataType) {
+        case DT_Float:
+            if (i == 0) {
+                bits = valueReader.readBits(64);
+            } else if (valueReader.readBit()) {
+                if (valueReader.readBit()) {
+                    leading = static_cast<int>(valueReader.readBits(5));
+                    const int significant = static_cast<int>(valueReader.readBits(6)) + 1;
+                    trailing = 64 - leading - significant;
+                }
+                bits ^= valueReader.readBits(64 - leading - trailing) << trailing;
+            }
+            value = bitsDouble(bits);
+            break;
+        case DT_Bool:
+            value = boolRuns.next() ? 1 : 0;
+            break;
+        default:
+            intValue += readSigned(valueReader);
+            value = static_cast<double>(intValue);
+            break;
+        }
+        const bool good = qualityRuns.next();
+
+        if (tsReader.failed() || valueReader.failed() || qualityReader.failed())
+            return false;
+        if (ts > to)
+            break;
+        if (ts >= from) {
+            HistPoint point;
+            point.timestamp = ts;
+            point.value = value;
+            point.good = good;
+            out.append(point);
+        }
+    }
+    return true;
+}
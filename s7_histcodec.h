@@ -0,0 +1,100 @@
+﻿#ifndef S7_HISTCODEC_H
+#define S7_HISTCODEC_H
+
+#include <QByteArray>
+#include <QVector>
+#include "s7_tag.h"
+#include "s7_bitstream.h"
+
+// 历史数据点
+struct HistPoint {
+    qint64 timestamp = 0;   // 毫秒，UTC
+    double value = 0;
+    bool good = true;       // 读取成功
+};
+
+// 块头：每个块保存一个变量的一段连续采样，固定32字节，小端
+struct HistBlockHeader {
+    static const quint16 Magic = 0x4248;    // "HB"
+    static const int Size = 32;
+
+    quint16 magic = Magic;
+    quint8 dataType = 0;
+    quint32 tagId = 0;
+    quint32 count = 0;          // 采样数
+    quint32 tsBytes = 0;        // 时间戳流长度
+    quint32 valueBytes = 0;     // 值流长度
+    quint32 qualityBytes = 0;   // 质量流长度
+    qint64 firstTimestamp = 0;
+};
+
+// 索引项：段索引文件中每个块一项，固定40字节，小端
+struct HistIndexEntry {
+    static const int Size = 40;
+
+    quint32 tagId = 0;
+    quint32 count = 0;
+    qint64 minTime = 0;
+    qint64 maxTime = 0;
+    quint64 offset = 0;         // 块在段数据文件中的偏移
+    quint32 length = 0;         // 块长度（含块头）
+    quint8 dataType = 0;
+
+    void write(uchar *dst) const;
+    bool read(const uchar *src);
+};
+
+// 块编码器：
+//  - 时间戳：首个时间戳写入块头，其后按二阶差分（delta-of-delta）变长编码
+//  - float：Gorilla 异或压缩
+//  - int/char：与上一值的差值变长编码
+//  - bool 与质量：游程编码
+class S7_HistEncoder
+{
+public:
+    S7_HistEncoder();
+
+    void start(int tagId, DataType type);
+    void append(qint64 timestamp, double value, bool good);
+
+    int tagId() const { return tag; }
+    DataType dataType() const { return type; }
+    int count() const { return samples; }
+    qint64 firstTimestamp() const { return firstTs; }
+    qint64 lastTimestamp() const { return prevTs; }
+    int encodedBytes() const;
+
+    // 生成完整的块（块头 + 三个数据流），不改变编码器状态
+    QByteArray encode() const;
+
+private:
+    void appendRun(S7_BitWriter &writer, bool &runValue, qint64 &runLength, bool bit);
+
+    int tag;
+    DataType type;
+    int samples;
+
+    qint64 firstTs;
+    qint64 prevTs;
+    qint64 prevDelta;
+    quint64 prevBits;           // 上一个 float 值的位模式
+    int prevLeading;            // 上一个异或值的前导零，-1 表示尚无窗口
+    int prevTrailing;
+    qint64 prevInt;
+    bool valueRun;              // bool 值当前游程
+    qint64 valueRunLength;
+    bool qualityRun;            // 质量当前游程
+    qint64 qualityRunLength;
+
+    S7_BitWriter tsStream;
+    S7_BitWriter valueStream;
+    S7_BitWriter qualityStream;
+};
+
+// 解析块头，数据不完整或标志不符时返回 false
+bool readHistHeader(const uchar *data, qint64 size, HistBlockHeader &header);
+
+// 解码一个块，时间落在 [from, to] 内的点追加到 out
+bool decodeHistBlock(const uchar *data, qint64 size, qint64 from, qint64 to, QVector<HistPoint> &out);
+
+#endif
@@ -0,0 +1,407 @@
+﻿/******************************************************************************
+ * @file    s7_historian.cpp
+ * @brief   嵌入式时序历史库，记录循环采集的数据
+ *
+ * @details
+ * 功能描述：
+ *    - 每个变量一个内存编码块，采集线程只做编码，写盘由独立线程按固定间隔批量执行
+ *    - 段文件只追加不修改，按时长滚动；块写入后在段索引中追加一项（变量、时间范围、偏移）
+ *    - 写盘失败时块留在待写队列中，下一次写盘重试，超过上限才丢弃最早的块并计数
+ *    - 按变量地址分配序列编号（series.map，只追加），历史不依赖会被复用的任务编号
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现历史库
+ *   2026-10-16 等待期间不再持有写盘锁；写盘失败的块保留重写并计数；
+ *              删除与查询引擎重复的 query()
+ *   2026-10-16 历史按地址分配的序列编号存放，不再使用任务编号
+ *   2026-10-16 写盘不完整时段文件与索引截回原长度，重写不再错位或重复
+ *****************************************************************************/
+
+#include "s7_historian.h"
+#include <QDir>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <algorithm>
+
+static const int SeriesRecordSize = 16;
+
+S7_Historian::S7_Historian()
+    : opened(false),
+    stopping(false),
+    writer(nullptr),
+    nextSeries(1),
+    segmentStart(0),
+    segmentMs(60 * 60 * 1000),
+    maxSamples(1024),
+    maxAgeMs(60 * 1000),
+    flushMs(1000),
+    sampleTotal(0),
+    byteTotal(0),
+    failureTotal(0),
+    droppedTotal(0)
+{
+
+}
+
+S7_Historian::~S7_Historian()
+{
+    close();
+}
+
+//————————————————————————————
+// 打开与关闭
+bool S7_Historian::open(const QString &directory)
+{
+    close();
+    if (!QDir().mkpath(directory))
+        return false;
+
+    // 已有的序列编号继续沿用，新地址从最大编号之后分配
+    const QHash<quint64, int> known = loadSeries(directory);
+    int maxSeries = 0;
+    for (int id : known)
+        maxSeries = qMax(maxSeries, id);
+
+    QMutexLocker locker(&mutex);
+    dir = directory;
+    seriesIds = known;
+    nextSeries = maxSeries + 1;
+    pendingSeries.clear();
+    stopping = false;
+    opened = true;
+    writer = QThread::create([this]() { writerLoop(); });
+    writer->start();
+    return true;
+}
+
+void S7_Historian::close()
+{
+    QThread *thread;
+    {
+        QMutexLocker locker(&mutex);
+        if (!opened)
+            return;
+        opened = false;
+        stopping = true;
+        thread = writer;
+        writer = nullptr;
+        wake.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+
+    qDeleteAll(encoders);
+    encoders.clear();
+    seriesFile.close();
+    dataFile.close();
+    indexFile.close();
+}
+
+bool S7_Historian::isOpen() const
+{
+    QMutexLocker locker(&mutex);
+    return opened;
+}
+
+QString S7_Historian::directory() const
+{
+    QMutexLocker locker(&mutex);
+    return dir;
+}
+
+void S7_Historian::setSegmentMinutes(int minutes)
+{
+    segmentMs = qMax(1, minutes) * 60 * 1000;
+}
+
+void S7_Historian::setMaxBlockSamples(int count)
+{
+    maxSamples = qMax(2, count);
+}
+
+void S7_Historian::setMaxBlockAge(int ms)
+{
+    maxAgeMs = qMax(100, ms);
+}
+
+void S7_Historian::setFlushInterval(int ms)
+{
+    flushMs = qMax(10, ms);
+}
+
+quint64 S7_Historian::samplesAppended() const
+{
+    return sampleTotal;
+}
+
+quint64 S7_Historian::bytesWritten() const
+{
+    return byteTotal;
+}
+
+quint64 S7_Historian::writeFailures() const
+{
+    return failureTotal;
+}
+
+quint64 S7_Historian::blocksDropped() const
+{
+    return droppedTotal;
+}
+
+//————————————————————————————
+// 采集：追加到变量的当前块，块满即封存
+void S7_Historian::append(const TagAddress &tag, qint64 timestamp, double value, bool good)
+{
+    const DataType type = tag.dataType;
+    if (type == DT_String)
+        return;     // string 不记录
+
+    QMutexLocker locker(&mutex);
+    if (!opened)
+        return;
+
+    const quint64 key = tagAddressKey(tag);
+    int series = seriesIds.value(key, 0);
+    if (series == 0) {
+        series = nextSeries++;
+        seriesIds.insert(key, series);
+        pendingSeries.append(SeriesRecord{series, key});
+    }
+
+    S7_HistEncoder *encoder = encoders.value(series);
+    if (!encoder) {
+        encoder = new S7_HistEncoder;
+        encoder->start(series, type);
+        encoders.insert(series, encoder);
+    } else if (timestamp < encoder->lastTimestamp()) {
+        // 时间回退，另起一块
+        if (encoder->count() > 0)
+            sealLocked(encoder);
+        encoder->start(series, type);
+    }
+
+    encoder->append(timestamp, value, good);
+    sampleTotal++;
+    if (encoder->count() >= maxSamples)
+        sealLocked(encoder);
+}
+
+void S7_Historian::sealLocked(S7_HistEncoder *encoder)
+{
+    PendingBlock block;
+    block.data = encoder->encode();
+    block.entry.tagId = static_cast<quint32>(encoder->tagId());
+    block.entry.count = static_cast<quint32>(encoder->count());
+    block.entry.minTime = encoder->firstTimestamp();
+    block.entry.maxTime = encoder->lastTimestamp();
+    block.entry.length = static_cast<quint32>(block.data.size());
+    block.entry.dataType = static_cast<quint8>(encoder->dataType());
+    pending.append(block);
+    encoder->start(encoder->tagId(), encoder->dataType());
+}
+
+//————————————————————————————
+// 写线程：按间隔封存超时的块并批量写盘，关闭时写完所有数据后退出
+void S7_Historian::writerLoop()
+{
+    for (;;) {
+        QVector<PendingBlock> batch;
+        QVector<SeriesRecord> records;
+        bool exiting;
+        qint64 now;
+        {
+            QMutexLocker locker(&mutex);
+            if (!stopping)
+                wake.wait(&mutex, static_cast<unsigned long>(flushMs.load()));
+            now = QDateTime::currentMSecsSinceEpoch();
+            const int age = maxAgeMs;
+            for (S7_HistEncoder *encoder : qAsConst(encoders)) {
+                if (encoder->count() > 0 && (stopping || now - encoder->firstTimestamp() >= age))
+                    sealLocked(encoder);
+            }
+            batch.swap(pending);
+            records.swap(pendingSeries);
+            exiting = stopping;
+        }
+        // 序列表先于块写盘，索引中的序列编号一定能在序列表中找到
+        const bool seriesWritten = writeSeries(records);
+        if (seriesWritten)
+            records.clear();
+        if (!seriesWritten || !writeBlocks(batch, now)) {
+            failureTotal++;
+            qWarning("S7_Historian: failed to write %d block(s) to %s", batch.size(), qPrintable(dir));
+            if (exiting) {
+                droppedTotal += static_cast<quint64>(batch.size());
+                return;
+            }
+            // 失败的块放回待写队列前部，保持时间顺序，下一次写盘重试
+            QMutexLocker locker(&mutex);
+            records.append(pendingSeries);
+            pendingSeries.swap(records);
+            batch.append(pending);
+            pending.swap(batch);
+            const int excess = pending.size() - MaxPendingBlocks;
+            if (excess > 0) {
+                pending.remove(0, excess);
+                droppedTotal += static_cast<quint64>(excess);
+            }
+            continue;
+        }
+        if (exiting)
+            return;
+    }
+}
+
+// 序列表只追加；写入不完整时截回原长度，整批留待重写
+bool S7_Historian::writeSeries(const QVector<SeriesRecord> &records)
+{
+    if (records.isEmpty())
+        return true;
+    if (!seriesFile.isOpen()) {
+        seriesFile.setFileName(seriesPath(dir));
+        if (!seriesFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered))
+            return false;
+        // 上次截断失败留下的不完整尾部先去掉，保证后续项对齐
+        const qint64 tail = seriesFile.size() % SeriesRecordSize;
+        if (tail != 0 && !seriesFile.resize(seriesFile.size() - tail)) {
+            seriesFile.close();
+            return false;
+        }
+    }
+
+    QByteArray bytes(records.size() * SeriesRecordSize, 0);
+    uchar *dst = reinterpret_cast<uchar*>(bytes.data());
+    for (const SeriesRecord &record : records) {
+        qToLittleEndian<quint32>(quint32(record.id), dst);
+        qToLittleEndian<quint64>(record.key, dst + 8);
+        dst += SeriesRecordSize;
+    }
+    const qint64 size = seriesFile.size();
+    if (seriesFile.write(bytes) == bytes.size())
+        return true;
+    if (!seriesFile.resize(size))
+        seriesFile.close();     // 截断失败时关闭，下次打开时再去掉不完整的尾部
+    return false;
+}
+
+// 块数据先于索引项写入，索引中出现的块一定完整。段文件以无缓冲方式打开，write 返回即已交给系统；
+// 任一写入不完整时两个文件都截回写入前的长度再返回 false，整批块由调用方保留重写，
+// 索引中不会留下半个索引项或重复的块。截断也失败时放弃该段，重写进入新段
+bool S7_Historian::writeBlocks(QVector<PendingBlock> &blocks, qint64 nowMs)
+{
+    if (blocks.isEmpty())
+        return true;
+    if (!rollSegment(nowMs))
+        return false;
+
+    const qint64 dataSize = dataFile.size();
+    const qint64 indexSize = indexFile.size();
+    QByteArray index(blocks.size() * HistIndexEntry::Size, 0);
+    uchar *entry = reinterpret_cast<uchar*>(index.data());
+    bool ok = true;
+    for (PendingBlock &block : blocks) {
+        block.entry.offset = static_cast<quint64>(dataFile.pos());
+        if (dataFile.write(block.data) != block.data.size()) {
+            ok = false;
+            break;
+        }
+        block.entry.write(entry);
+        entry += HistIndexEntry::Size;
+    }
+    if (ok && indexFile.write(index) != index.size())
+        ok = false;
+    if (!ok) {
+        if (!dataFile.resize(dataSize) || !indexFile.resize(indexSize)) {
+            dataFile.close();
+            indexFile.close();
+        }
+        return false;
+    }
+    for (const PendingBlock &block : qAsConst(blocks))
+        byteTotal += static_cast<quint64>(block.data.size());
+    return true;
+}
+
+// 段未打开（首次写盘、打开失败或被放弃）或到期时新建段；段名不与上一个段重复
+bool S7_Historian::rollSegment(qint64 nowMs)
+{
+    if (dataFile.isOpen() && nowMs < segmentStart + segmentMs)
+        return true;
+
+    dataFile.close();
+    indexFile.close();
+    segmentStart = qMax(nowMs, segmentStart + 1);
+    const QString base = QDir(dir).filePath(QString::number(segmentStart));
+    dataFile.setFileName(base + ".seg");
+    indexFile.setFileName(base + ".idx");
+    if (dataFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)
+        && indexFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered))
+        return true;
+    // 只打开了一半时全部关闭，下一次写盘重新打开
+    dataFile.close();
+    indexFile.close();
+    return false;
+}
+
+//————————————————————————————
+// 查询
+QHash<quint64, int> S7_Historian::loadSeries(const QString &directory)
+{
+    QHash<quint64, int> series;
+    QFile file(seriesPath(directory));
+    if (!file.open(QIODevice::ReadOnly))
+        return series;
+    const QByteArray bytes = file.readAll();
+    const uchar *src = reinterpret_cast<const uchar*>(bytes.constData());
+    const int records = bytes.size() / SeriesRecordSize;    // 末尾不完整的项忽略
+    for (int i = 0; i < records; ++i, src += SeriesRecordSize) {
+        const int id = int(qFromLittleEndian<quint32>(src));
+        if (id > 0)
+            series.insert(qFromLittleEndian<quint64>(src + 8), id);
+    }
+    return series;
+}
+
+QString S7_Historian::seriesPath(const QString &directory)
+{
+    return QDir(directory).filePath("series.map");
+}
+
+QVector<S7_Historian::Segment> S7_Historian::segments() const
+{
+    return listSegments(directory());
+}
+
+QVector<S7_Historian::Segment> S7_Historian::listSegments(const QString &directory)
+{
+    QVector<Segment> list;
+    QDir folder(directory);
+    const QStringList names = folder.entryList(QStringList() << "*.seg", QDir::Files);
+    for (const QString &name : names) {
+        bool ok = false;
+        const qint64 start = name.left(name.size() - 4).toLongLong(&ok);
+        if (!ok)
+            continue;
+        Segment segment;
+        segment.startMs = start;
+        segment.dataPath = folder.filePath(name);
+        segment.indexPath = folder.filePath(QString::number(start) + ".idx");
+        list.append(segment);
+    }
+    std::sort(list.begin(), list.end(), [](const Segment &a, const Segment &b) {
+        return a.startMs < b.startMs;
+    });
+    return list;
+}
+
+// 段内的块在段打开期间写入，块的最早时间不早于 写入时间 - 块保留时间 - 写盘间隔
+qint64 S7_Historian::segmentSlackMs() const
+{
+    return qint64(maxAgeMs) + flushMs + 1000;
+}
@@ -0,0 +1,108 @@
+﻿#ifndef S7_HISTORIAN_H
+#define S7_HISTORIAN_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <atomic>
+#include "s7_histcodec.h"
+
+// 嵌入式历史库：采样先编码进各变量的内存块，块满或超时后封存，
+// 由写线程批量追加到段文件（<起始毫秒>.seg），每个块在段索引文件（.idx）中记一项，
+// 段按时长滚动，查询时按段起始时间和索引项的时间范围裁剪，只解码命中的块。
+// 块和索引按序列编号存放：每个变量地址（区域/DB/偏移/位/类型）首次出现时分配一个序列编号，
+// 记入目录下的 series.map 且不再复用，任务编号被复用或重新分配时不会混入其他地址的历史
+class S7_Historian
+{
+public:
+    static const int MaxPendingBlocks = 65536;  // 写盘失败时保留的待写块上限
+
+    S7_Historian();
+    ~S7_Historian();
+
+    S7_Historian(const S7_Historian &) = delete;
+    S7_Historian &operator=(const S7_Historian &) = delete;
+
+    bool open(const QString &directory);
+    void close();                           // 封存所有未满的块并写盘
+    bool isOpen() const;
+    QString directory() const;
+
+    void setSegmentMinutes(int minutes);    // 段时长，默认60分钟
+    void setMaxBlockSamples(int count);     // 块最大采样数，默认1024
+    void setMaxBlockAge(int ms);            // 块最长保留时间，默认60秒
+    void setFlushInterval(int ms);          // 写盘间隔，默认1秒
+
+    // 采集线程调用：只做内存编码，不访问磁盘
+    void append(const TagAddress &tag, qint64 timestamp, double value, bool good);
+
+    // 序列表：地址键（tagAddressKey）-> 序列编号，文件中每项16字节 {序列 u32, 保留 u32, 地址键 u64}，小端
+    static QHash<quint64, int> loadSeries(const QString &directory);
+    static QString seriesPath(const QString &directory);
+
+    // 段文件列表（按起始时间升序）与块保留时间，供查询引擎裁剪
+    struct Segment {
+        qint64 startMs;
+        QString dataPath;
+        QString indexPath;
+    };
+    QVector<Segment> segments() const;
+    static QVector<Segment> listSegments(const QString &directory);
+    qint64 segmentSlackMs() const;          // 段内数据可早于段起始的最大时长
+
+    quint64 samplesAppended() const;
+    quint64 bytesWritten() const;
+    // 写盘失败次数（段文件打不开或写入不完整），失败的块留待下次重写
+    quint64 writeFailures() const;
+    // 写盘持续失败、待写块超过上限后丢弃的块数
+    quint64 blocksDropped() const;
+
+private:
+    struct PendingBlock {
+        HistIndexEntry entry;
+        QByteArray data;
+    };
+    struct SeriesRecord {
+        int id;
+        quint64 key;
+    };
+
+    void writerLoop();
+    void sealLocked(S7_HistEncoder *encoder);
+    bool writeSeries(const QVector<SeriesRecord> &records);
+    bool writeBlocks(QVector<PendingBlock> &blocks, qint64 nowMs);
+    bool rollSegment(qint64 nowMs);
+
+    QString dir;
+    bool opened;
+
+    mutable QMutex mutex;                   // 保护编码器与待写块
+    QWaitCondition wake;
+    bool stopping;
+    QHash<int, S7_HistEncoder*> encoders;   // 序列编号 -> 编码器
+    QHash<quint64, int> seriesIds;          // 地址键 -> 序列编号
+    int nextSeries;
+    QVector<SeriesRecord> pendingSeries;    // 新分配、尚未写盘的序列，先于引用它的块写盘
+    QVector<PendingBlock> pending;
+    QThread *writer;
+
+    QFile seriesFile;                       // 仅写线程访问
+    QFile dataFile;
+    QFile indexFile;
+    qint64 segmentStart;
+
+    std::atomic<int> segmentMs;
+    std::atomic<int> maxSamples;
+    std::atomic<int> maxAgeMs;
+    std::atomic<int> flushMs;
+    std::atomic<quint64> sampleTotal;
+    std::atomic<quint64> byteTotal;
+    std::atomic<quint64> failureTotal;
+    std::atomic<quint64> droppedTotal;
+};
+
+#endif
@@ -0,0 +1,451 @@
+﻿/******************************************************************************
+ * @file    s7_histquery.cpp
+ * @brief   历史数据查询与导出
+ *
+ * @details
+ * 功能描述：
+ *    - 段文件与索引文件以内存映射方式读取，段文件增长后重新映射
+ *    - 索引项按变量分组并统计段的时间范围，只扫描一次
+ *    - 先按段时间范围、再按索引项时间范围裁剪，只解码重叠的块
+ *    - min/max/avg/last 降采样在解码时逐块流式完成
+ *    - 导出 CSV（文本）或列式文件（每个变量每列一段连续数组，文件尾为列目录）
+ *
+ * 列式文件格式（小端）：
+ *    文件头 8 字节 "S7COL" 0 1 0；
+ *    随后为各列数据段，只有坏点的桶 min/max/avg/last 为 NaN；
+ *    文件尾为列目录：每项 32 字节 {变量 u32, 列号 u8, 类型 u8, 保留 u16, 行数 u32, 保留 u32, 偏移 u64, 字节数 u64}，
+ *    最后 8 字节为 {列目录项数 u32, "S7CL"}
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现历史查询与导出
+ *   2026-10-16 只有坏点的桶在 CSV 中留空、列式文件中写 NaN，不再输出0
+ *   2026-10-16 按变量地址查找序列编号，查询不再依赖任务编号
+ *   2026-10-16 索引被写入方截短时重新分组
+ *****************************************************************************/
+
+#include "s7_histquery.h"
+#include <QFileInfo>
+#include <QtEndian>
+#include <QLocale>
+#include <cstring>
+
+namespace {
+
+// 列式文件的列类型与列号
+enum ColumnType : quint8 { ColInt64 = 0, ColFloat64 = 1, ColUInt8 = 2, ColUInt32 = 3 };
+enum ColumnId : quint8 {
+    ColTime = 0, ColValue = 1, ColGood = 2,
+    ColMin = 3, ColMax = 4, ColAvg = 5, ColLast = 6, ColCount = 7
+};
+
+// 降采样累加器：点按时间升序到达，越过桶边界时输出上一个桶
+struct BucketFolder {
+    qint64 from;
+    qint64 width;
+    HistBucket current;
+    bool open = false;
+
+    template <typename Emit>
+    void add(const HistPoint &point, Emit &&emit)
+    {
+        const qint64 start = from + (point.timestamp - from) / width * width;
+        if (open && start != current.start) {
+            emit(current);
+            open = false;
+        }
+        if (!open) {
+            current = HistBucket();
+            current.start = start;
+            open = true;
+        }
+        if (!point.good) {
+            current.badCount++;
+            return;
+        }
+        if (current.count == 0) {
+            current.min = current.max = point.value;
+        } else {
+            if (point.value < current.min) current.min = point.value;
+            if (point.value > current.max) current.max = point.value;
+        }
+        current.sum += point.value;
+        current.last = point.value;
+        current.lastTime = point.timestamp;
+        current.count++;
+    }
+
+    template <typename Emit>
+    void finish(Emit &&emit)
+    {
+        if (open)
+            emit(current);
+        open = false;
+    }
+};
+
+template <typename T>
+void appendLittle(QByteArray &out, T value)
+{
+    uchar bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), int(sizeof(T)));
+}
+
+void appendDouble(QByteArray &out, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    appendLittle<quint64>(out, bits);
+}
+
+// 写出缓冲区超过该大小时落盘
+const int CsvFlushBytes = 1 << 20;
+
+} // namespace
+
+S7_HistQuery::S7_HistQuery(const QString &directory)
+    : dir(directory),
+    seriesBytes(-1),
+    blockTotal(0),
+    pointTotal(0)
+{
+
+}
+
+S7_HistQuery::~S7_HistQuery()
+{
+    for (Mapped &segment : segments)
+        unmap(segment);
+}
+
+QString S7_HistQuery::errorString() const
+{
+    return error;
+}
+
+quint64 S7_HistQuery::blocksDecoded() const
+{
+    return blockTotal;
+}
+
+quint64 S7_HistQuery::pointsDecoded() const
+{
+    return pointTotal;
+}
+
+int S7_HistQuery::seriesOf(const TagAddress &tag)
+{
+    const qint64 size = QFileInfo(S7_Historian::seriesPath(dir)).size();
+    if (size != seriesBytes) {
+        series = S7_Historian::loadSeries(dir);
+        seriesBytes = size;
+    }
+    return series.value(tagAddressKey(tag), -1);
+}
+
+//————————————————————————————
+// 映射管理：已映射且大小未变的段直接复用，增长的段（通常是最后一个）重新映射，
+// 已分组的索引项保留，只扫描新增部分
+void S7_HistQuery::refresh()
+{
+    const QVector<S7_Historian::Segment> list = S7_Historian::listSegments(dir);
+    QVector<Mapped> next;
+    next.reserve(list.size());
+
+    for (const S7_Historian::Segment &info : list) {
+        Mapped current;
+        for (Mapped &old : segments) {
+            if (old.startMs == info.startMs && old.data) {
+                current = old;
+                old = Mapped();
+                break;
+            }
+        }
+        if (current.data && QFileInfo(info.dataPath).size() == current.dataSize
+            && QFileInfo(info.indexPath).size() == current.indexSize) {
+            next.append(current);
+            continue;
+        }
+        if (!mapSegment(current, info))
+            continue;
+        // 写入方写盘失败时会把索引截回原长度，已分组的索引项可能已不存在，重新分组
+        if (qint64(current.scanned) * HistIndexEntry::Size > current.indexSize) {
+            current.scanned = 0;
+            current.minTime = 0;
+            current.maxTime = -1;
+            current.tagEntries.clear();
+        }
+        scanIndex(current);
+        next.append(current);
+    }
+
+    for (Mapped &old : segments)
+        unmap(old);
+    segments.swap(next);
+}
+
+bool S7_HistQuery::mapSegment(Mapped &segment, const S7_Historian::Segment &info)
+{
+    delete segment.data;
+    delete segment.index;
+    segment.dataBase = segment.indexBase = nullptr;
+    segment.startMs = info.startMs;
+    segment.index = new QFile(info.indexPath);
+    segment.data = new QFile(info.dataPath);
+    // 先读索引再读数据：写入方先刷新数据再追加索引，数据文件不会短于索引覆盖的范围
+    if (!segment.index->open(QIODevice::ReadOnly) || !segment.data->open(QIODevice::ReadOnly)) {
+        unmap(segment);
+        return false;
+    }
+    segment.indexSize = segment.index->size();
+    segment.dataSize = segment.data->size();
+    if (segment.indexSize > 0)
+        segment.indexBase = segment.index->map(0, segment.indexSize);
+    if (segment.dataSize > 0)
+        segment.dataBase = segment.data->map(0, segment.dataSize);
+    if ((segment.indexSize > 0 && !segment.indexBase) || (segment.dataSize > 0 && !segment.dataBase)) {
+        unmap(segment);
+        return false;
+    }
+    return true;
+}
+
+// 索引项按变量分组，同时得到段的时间范围；末尾不完整或越过数据文件的索引项留到下次
+void S7_HistQuery::scanIndex(Mapped &segment)
+{
+    const int entries = int(segment.indexSize / HistIndexEntry::Size);
+    for (; segment.scanned < entries; ++segment.scanned) {
+        HistIndexEntry entry;
+        if (!entry.read(segment.indexBase + qint64(segment.scanned) * HistIndexEntry::Size))
+            continue;
+        if (qint64(entry.offset) + entry.length > segment.dataSize)
+            break;
+        if (segment.maxTime < segment.minTime) {
+            segment.minTime = entry.minTime;
+            segment.maxTime = entry.maxTime;
+        } else {
+            segment.minTime = qMin(segment.minTime, entry.minTime);
+            segment.maxTime = qMax(segment.maxTime, entry.maxTime);
+        }
+        segment.tagEntries[entry.tagId].append(segment.scanned);
+    }
+}
+
+void S7_HistQuery::unmap(Mapped &segment)
+{
+    delete segment.data;      // 关闭文件时自动解除映射
+    delete segment.index;
+    segment = Mapped();
+}
+
+//————————————————————————————
+// 扫描：按时间顺序把与 [from, to] 重叠的块逐个解码后交给 sink(const HistPoint*, int)
+template <typename Sink>
+void S7_HistQuery::scan(int tagId, qint64 from, qint64 to, Sink &&sink)
+{
+    for (const Mapped &segment : qAsConst(segments)) {
+        if (segment.maxTime < from || segment.minTime > to)
+            continue;
+        const auto found = segment.tagEntries.constFind(quint32(tagId));
+        if (found == segment.tagEntries.constEnd())
+            continue;
+
+        for (int k : found.value()) {
+            HistIndexEntry entry;
+            entry.read(segment.indexBase + qint64(k) * HistIndexEntry::Size);
+            if (entry.maxTime < from || entry.minTime > to)
+                continue;
+
+            scratch.resize(0);
+            decodeHistBlock(segment.dataBase + entry.offset, entry.length, from, to, scratch);
+            blockTotal++;
+            pointTotal += quint64(scratch.size());
+            if (!scratch.isEmpty())
+                sink(scratch.constData(), scratch.size());
+        }
+    }
+}
+
+//————————————————————————————
+// 查询
+QVector<HistPoint> S7_HistQuery::raw(int tagId, qint64 from, qint64 to)
+{
+    QVector<HistPoint> out;
+    if (to < from)
+        return out;
+    refresh();
+    scan(tagId, from, to, [&out](const HistPoint *points, int count) {
+        for (int i = 0; i < count; ++i)
+            out.append(points[i]);
+    });
+    return out;
+}
+
+QVector<HistBucket> S7_HistQuery::downsample(int tagId, qint64 from, qint64 to, qint64 bucketMs)
+{
+    QVector<HistBucket> out;
+    if (to < from || bucketMs <= 0)
+        return out;
+    refresh();
+
+    BucketFolder folder{from, bucketMs, HistBucket()};
+    auto emitBucket = [&out](const HistBucket &bucket) { out.append(bucket); };
+    scan(tagId, from, to, [&](const HistPoint *points, int count) {
+        for (int i = 0; i < count; ++i)
+            folder.add(points[i], emitBucket);
+    });
+    folder.finish(emitBucket);
+    return out;
+}
+
+//————————————————————————————
+// CSV 导出：原始点为 timestamp_ms,tag,value,good；
+// 降采样为 timestamp_ms,tag,min,max,avg,last,count,bad，只有坏点的桶 min/max/avg/last 留空
+bool S7_HistQuery::exportCsv(const QString &path, const QVector<int> &tagIds, qint64 from, qint64 to, qint64 bucketMs)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = file.errorString();
+        return false;
+    }
+    refresh();
+
+    QByteArray buffer;
+    buffer.reserve(CsvFlushBytes + 4096);
+    buffer.append(bucketMs > 0 ? "timestamp_ms,tag,min,max,avg,last,count,bad\n"
+                               : "timestamp_ms,tag,value,good\n");
+    auto flush = [&]() {
+        if (buffer.size() >= CsvFlushBytes) {
+            file.write(buffer);
+            buffer.resize(0);
+        }
+    };
+
+    for (int tagId : tagIds) {
+        const QByteArray tag = "," + QByteArray::number(tagId) + ",";
+        if (bucketMs <= 0) {
+            scan(tagId, from, to, [&](const HistPoint *points, int count) {
+                for (int i = 0; i < count; ++i) {
+                    buffer.append(QByteArray::number(points[i].timestamp));
+                    buffer.append(tag);
+                    buffer.append(QByteArray::number(points[i].value, 'g', QLocale::FloatingPointShortest));
+                    buffer.append(points[i].good ? ",1\n" : ",0\n");
+                }
+                flush();
+            });
+            continue;
+        }
+
+        BucketFolder folder{from, bucketMs, HistBucket()};
+        auto emitBucket = [&](const HistBucket &bucket) {
+            buffer.append(QByteArray::number(bucket.start));
+            buffer.append(tag);
+            if (bucket.count > 0) {
+                buffer.append(QByteArray::number(bucket.min, 'g', QLocale::FloatingPointShortest)).append(',');
+                buffer.append(QByteArray::number(bucket.max, 'g', QLocale::FloatingPointShortest)).append(',');
+                buffer.append(QByteArray::number(bucket.avg(), 'g', QLocale::FloatingPointShortest)).append(',');
+                buffer.append(QByteArray::number(bucket.last, 'g', QLocale::FloatingPointShortest)).append(',');
+            } else {
+                buffer.append(",,,,");
+            }
+            buffer.append(QByteArray::number(bucket.count)).append(',');
+            buffer.append(QByteArray::number(bucket.badCount)).append('\n');
+            flush();
+        };
+        scan(tagId, from, to, [&](const HistPoint *points, int count) {
+            for (int i = 0; i < count; ++i)
+                folder.add(points[i], emitBucket);
+        });
+        folder.finish(emitBucket);
+    }
+
+    file.write(buffer);
+    if (file.error() != QFileDevice::NoError) {
+        error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+//————————————————————————————
+// 列式导出：逐个变量收集各列，写出后记录到列目录
+bool S7_HistQuery::exportColumnar(const QString &path, const QVector<int> &tagIds, qint64 from, qint64 to, qint64 bucketMs)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = file.errorString();
+        return false;
+    }
+    refresh();
+
+    file.write("S7COL\0\1\0", 8);
+    QByteArray directory;
+    int columnCount = 0;
+    auto writeColumn = [&](int tagId, ColumnId column, ColumnType type, quint32 rows, const QByteArray &bytes) {
+        appendLittle<quint32>(directory, quint32(tagId));
+        directory.append(char(column));
+        directory.append(char(type));
+        appendLittle<quint16>(directory, 0);
+        appendLittle<quint32>(directory, rows);
+        appendLittle<quint32>(directory, 0);
+        appendLittle<quint64>(directory, quint64(file.pos()));
+        appendLittle<quint64>(directory, quint64(bytes.size()));
+        file.write(bytes);
+        columnCount++;
+    };
+
+    for (int tagId : tagIds) {
+        if (bucketMs <= 0) {
+            QByteArray times, values, good;
+            scan(tagId, from, to, [&](const HistPoint *points, int count) {
+                for (int i = 0; i < count; ++i) {
+                    appendLittle<qint64>(times, points[i].timestamp);
+                    appendDouble(values, points[i].value);
+                    good.append(char(points[i].good ? 1 : 0));
+                }
+            });
+            const quint32 rows = quint32(good.size());
+            writeColumn(tagId, ColTime, ColInt64, rows, times);
+            writeColumn(tagId, ColValue, ColFloat64, rows, values);
+            writeColumn(tagId, ColGood, ColUInt8, rows, good);
+            continue;
+        }
+
+        QByteArray times, mins, maxs, avgs, lasts, counts;
+        quint32 rows = 0;
+        BucketFolder folder{from, bucketMs, HistBucket()};
+        auto emitBucket = [&](const HistBucket &bucket) {
+            appendLittle<qint64>(times, bucket.start);
+            appendDouble(mins, bucket.min);
+            appendDouble(maxs, bucket.max);
+            appendDouble(avgs, bucket.avg());
+            appendDouble(lasts, bucket.last);
+            appendLittle<quint32>(counts, bucket.count);
+            rows++;
+        };
+        scan(tagId, from, to, [&](const HistPoint *points, int count) {
+            for (int i = 0; i < count; ++i)
+                folder.add(points[i], emitBucket);
+        });
+        folder.finish(emitBucket);
+        writeColumn(tagId, ColTime, ColInt64, rows, times);
+        writeColumn(tagId, ColMin, ColFloat64, rows, mins);
+        writeColumn(tagId, ColMax, ColFloat64, rows, maxs);
+        writeColumn(tagId, ColAvg, ColFloat64, rows, avgs);
+        writeColumn(tagId, ColLast, ColFloat64, rows, lasts);
+        writeColumn(tagId, ColCount, ColUInt32, rows, counts);
+    }
+
+    appendLittle<quint32>(directory, quint32(columnCount));
+    directory.append("S7CL", 4);
+    file.write(directory);
+    if (file.error() != QFileDevice::NoError) {
+        error = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+﻿#ifndef S7_HISTQUERY_H
+#define S7_HISTQUERY_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QFile>
+#include <limits>
+#include "s7_historian.h"
+
+// 降采样桶：只统计质量为好的点，坏点单独计数；
+// 只有坏点的桶（count 为0）min/max/avg/last 为 NaN
+struct HistBucket {
+    qint64 start = 0;       // 桶起始时间（毫秒）
+    double min = std::numeric_limits<double>::quiet_NaN();
+    double max = std::numeric_limits<double>::quiet_NaN();
+    double sum = 0;
+    double last = std::numeric_limits<double>::quiet_NaN();    // 桶内最后一个好点的值
+    qint64 lastTime = 0;
+    quint32 count = 0;      // 好点数
+    quint32 badCount = 0;   // 坏点数
+
+    double avg() const { return count > 0 ? sum / count : std::numeric_limits<double>::quiet_NaN(); }
+};
+
+// 历史查询引擎：内存映射历史库的段文件和索引，首次映射时从索引得到段的时间范围
+// 并按变量分组索引项（段只追加，之后只扫描新增的索引项），查询时按段和块的时间范围裁剪，
+// 只解码与查询范围重叠的块，逐块流式聚合，不保存中间结果。
+// 只读取已写盘的数据，可与写入中的历史库同时使用（索引晚于数据写入，读到的索引项一定完整）
+class S7_HistQuery
+{
+public:
+    explicit S7_HistQuery(const QString &directory);
+    ~S7_HistQuery();
+
+    S7_HistQuery(const S7_HistQuery &) = delete;
+    S7_HistQuery &operator=(const S7_HistQuery &) = delete;
+
+    // 变量地址对应的序列编号，从未记录过的地址返回 -1；以下查询与导出的 tagId 均为序列编号
+    int seriesOf(const TagAddress &tag);
+
+    // 原始点，按时间升序
+    QVector<HistPoint> raw(int tagId, qint64 from, qint64 to);
+    // 按 bucketMs 对齐到 from 的桶做 min/max/avg/last，只返回非空桶
+    QVector<HistBucket> downsample(int tagId, qint64 from, qint64 to, qint64 bucketMs);
+
+    // 导出：bucketMs 为0时导出原始点，否则导出降采样结果
+    bool exportCsv(const QString &path, const QVector<int> &tagIds, qint64 from, qint64 to, qint64 bucketMs = 0);
+    bool exportColumnar(const QString &path, const QVector<int> &tagIds, qint64 from, qint64 to, qint64 bucketMs = 0);
+
+    QString errorString() const;
+    quint64 blocksDecoded() const;  // 累计解码的块数（裁剪效果）
+    quint64 pointsDecoded() const;
+
+private:
+    struct Mapped {
+        qint64 startMs = 0;
+        QFile *data = nullptr;
+        QFile *index = nullptr;
+        const uchar *dataBase = nullptr;
+        const uchar *indexBase = nullptr;
+        qint64 dataSize = 0;
+        qint64 indexSize = 0;
+        int scanned = 0;                    // 已分组的索引项数
+        qint64 minTime = 0;                 // 段内数据的时间范围
+        qint64 maxTime = -1;
+        QHash<quint32, QVector<int>> tagEntries;    // 变量 -> 索引项序号（时间顺序）
+    };
+
+    void refresh();
+    void unmap(Mapped &segment);
+    bool mapSegment(Mapped &segment, const S7_Historian::Segment &info);
+    void scanIndex(Mapped &segment);
+    template <typename Sink>
+    void scan(int tagId, qint64 from, qint64 to, Sink &&sink);
+
+    QString dir;
+    QHash<quint64, int> series;     // 地址键 -> 序列编号，序列表增长时重新读取
+    qint64 seriesBytes;
+    QVector<Mapped> segments;
+    QVector<HistPoint> scratch;     // 单块解码缓冲区（复用）
+    QString error;
+    quint64 blockTotal;
+    quint64 pointTotal;
+};
+
+#endif
@@ -0,0 +1,249 @@
+﻿#ifndef S7_LAYOUT_H
+#define S7_LAYOUT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QDateTime>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include "s7_base.h"
+#include "s7_result.h"
+
+// DB/UDT 布局描述：用成员指针、偏移和位号把PLC中的结构映射到本地结构体，
+// 字段列表在编译期展开为逐字段的定长拷贝与字节交换，解码时没有按数据类型的分支。
+//
+//   struct Motor { qint16 speed; float current; bool running; S7_String<16> name; };
+//   using MotorLayout = S7_Layout<Motor,
+//       S7_Field<&Motor::speed, 0>,          // INT      DBW0
+//       S7_Field<&Motor::current, 2>,        // REAL     DBD2
+//       S7_Bit<&Motor::running, 6, 0>,       // BOOL     DBX6.0
+//       S7_Field<&Motor::name, 8>>;          // STRING[16] DBB8
+//
+//   Motor m;
+//   MotorLayout::decode(image + offset, m);
+//   S7_Result<Motor> r = MotorLayout::read(s7, S7AreaDB, 10, 0);
+//
+// 成员类型决定编码：qint8/quint8(SINT/USINT/BYTE)、char(CHAR)、qint16/quint16(INT/WORD)、
+// qint32/quint32(DINT/DWORD)、qint64/quint64(LINT)、float(REAL)、double(LREAL)、
+// S7_String<N>(STRING[N])，以及这些类型的定长数组（ARRAY）；bool 只能用 S7_Bit 描述
+
+// S7 STRING[N]：当前长度 + N 个字符，与PLC中的布局一致，解码不分配内存
+template <int N>
+struct S7_String {
+    static_assert(N >= 1 && N <= 254, "S7 STRING length must be 1..254");
+    quint8 length = 0;
+    char text[N] = {};
+
+    QString toString() const
+    {
+        return QString::fromLatin1(text, qMin<int>(length, N));
+    }
+
+    void set(const QString &value)
+    {
+        const QByteArray latin = value.left(N).toLatin1();
+        length = static_cast<quint8>(latin.size());
+        std::memset(text, 0, N);
+        std::memcpy(text, latin.constData(), size_t(latin.size()));
+    }
+};
+
+// 与类型等宽的无符号整数，用于浮点的字节交换
+template <int Size> struct S7_UIntOf;
+template <> struct S7_UIntOf<1> { using Type = quint8; };
+template <> struct S7_UIntOf<2> { using Type = quint16; };
+template <> struct S7_UIntOf<4> { using Type = quint32; };
+template <> struct S7_UIntOf<8> { using Type = quint64; };
+
+// 单个类型的编解码（大端），未特化的类型（含 bool）编译失败
+template <typename T, typename Enable = void>
+struct S7_Codec;
+
+template <typename T>
+struct S7_Codec<T, std::enable_if_t<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>> {
+    static constexpr int size = sizeof(T);
+    using Bits = typename S7_UIntOf<sizeof(T)>::Type;
+
+    static void decode(const quint8 *data, T &value)
+    {
+        const Bits bits = qFromBigEndian<Bits>(data);
+        std::memcpy(&value, &bits, sizeof(T));
+    }
+
+    static void encode(quint8 *data, const T &value)
+    {
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        qToBigEndian<Bits>(bits, data);
+    }
+};
+
+template <int N>
+struct S7_Codec<S7_String<N>, void> {
+    static constexpr int size = N + 2;
+
+    static void decode(const quint8 *data, S7_String<N> &value)
+    {
+        value.length = qMin<quint8>(data[1], quint8(N));
+        std::memcpy(value.text, data + 2, N);
+    }
+
+    static void encode(quint8 *data, const S7_String<N> &value)
+    {
+        data[0] = quint8(N);
+        data[1] = qMin<quint8>(value.length, quint8(N));
+        std::memcpy(data + 2, value.text, N);
+    }
+};
+
+// ARRAY[0..K-1] OF T：元素首尾相接
+template <typename T, int K>
+struct S7_Codec<T[K], void> {
+    static constexpr int size = K * S7_Codec<T>::size;
+
+    static void decode(const quint8 *data, T (&value)[K])
+    {
+        for (int i = 0; i < K; ++i)
+            S7_Codec<T>::decode(data + i * S7_Codec<T>::size, value[i]);
+    }
+
+    static void encode(quint8 *data, const T (&value)[K])
+    {
+        for (int i = 0; i < K; ++i)
+            S7_Codec<T>::encode(data + i * S7_Codec<T>::size, value[i]);
+    }
+};
+
+// 成员指针的所属结构体与成员类型
+template <typename M> struct S7_MemberOf;
+template <typename S, typename T>
+struct S7_MemberOf<T S::*> {
+    using Struct = S;
+    using Type = T;
+};
+
+// 字段：成员 + 字节偏移，编码由成员类型决定
+template <auto Member, int Offset>
+struct S7_Field {
+    using Struct = typename S7_MemberOf<decltype(Member)>::Struct;
+    using Type = typename S7_MemberOf<decltype(Member)>::Type;
+    static_assert(Offset >= 0, "field offset must not be negative");
+    static constexpr int end = Offset + S7_Codec<Type>::size;
+
+    static void decode(const quint8 *image, Struct &out)
+    {
+        S7_Codec<Type>::decode(image + Offset, out.*Member);
+    }
+
+    static void encode(const Struct &in, quint8 *image)
+    {
+        S7_Codec<Type>::encode(image + Offset, in.*Member);
+    }
+};
+
+// 位字段：bool 成员 + DBX偏移.位，编码时只改该位
+template <auto Member, int Offset, int Bit>
+struct S7_Bit {
+    using Struct = typename S7_MemberOf<decltype(Member)>::Struct;
+    using Type = typename S7_MemberOf<decltype(Member)>::Type;
+    static_assert(std::is_same<Type, bool>::value, "S7_Bit needs a bool member");
+    static_assert(Offset >= 0 && Bit >= 0 && Bit <= 7, "bit address out of range");
+    static constexpr int end = Offset + 1;
+
+    static void decode(const quint8 *image, Struct &out)
+    {
+        out.*Member = (image[Offset] >> Bit) & 1;
+    }
+
+    static void encode(const Struct &in, quint8 *image)
+    {
+        if (in.*Member)
+            image[Offset] |= quint8(1 << Bit);
+        else
+            image[Offset] &= quint8(~(1 << Bit));
+    }
+};
+
+// 布局：字段按折叠表达式逐个展开。size 为最后一个字段的结束位置，
+// stride 为 ARRAY OF UDT 中相邻元素的间距（UDT长度向上取偶）
+template <typename Struct, typename... Fields>
+class S7_Layout
+{
+public:
+    static_assert(sizeof...(Fields) > 0, "layout needs at least one field");
+    static_assert((std::is_same<typename Fields::Struct, Struct>::value && ...),
+                  "all fields must be members of the layout struct");
+
+    using Type = Struct;
+    static constexpr int fieldCount = int(sizeof...(Fields));
+    static constexpr int size = std::max({Fields::end...});
+    static constexpr int stride = (size + 1) & ~1;
+
+    static void decode(const quint8 *image, Struct &out)
+    {
+        (Fields::decode(image, out), ...);
+    }
+
+    // 只改写布局中描述的字节与位，image 中其余数据保持不变
+    static void encode(const Struct &in, quint8 *image)
+    {
+        (Fields::encode(in, image), ...);
+    }
+
+    static void decodeArray(const quint8 *image, Struct *out, int count, int elementStride = stride)
+    {
+        for (int i = 0; i < count; ++i)
+            decode(image + i * elementStride, out[i]);
+    }
+
+    static void encodeArray(const Struct *in, quint8 *image, int count, int elementStride = stride)
+    {
+        for (int i = 0; i < count; ++i)
+            encode(in[i], image + i * elementStride);
+    }
+
+    // 一次读取 size 字节并解码
+    static S7_Result<Struct> read(S7_BASE *s7, int area, int dbNumber, int startByte)
+    {
+        quint8 buffer[size];
+        S7_Result<Struct> result;
+        result.error = s7->ReadArea(area, dbNumber, startByte, buffer, size);
+        result.timestamp = QDateTime::currentMSecsSinceEpoch();
+        if (result.error == 0) {
+            decode(buffer, result.value);
+            result.quality = QualityGood;
+        }
+        return result;
+    }
+
+    // 连续的 count 个元素一次读取（snap7按PDU分包），返回错误码
+    static int readArray(S7_BASE *s7, int area, int dbNumber, int startByte, QVector<Struct> &out, int count,
+                         int elementStride = stride)
+    {
+        if (count <= 0)
+            return 0;
+        QByteArray buffer((count - 1) * elementStride + size, Qt::Uninitialized);
+        const quint8 *data = reinterpret_cast<const quint8*>(buffer.constData());
+        const int error = s7->ReadArea(area, dbNumber, startByte, reinterpret_cast<quint8*>(buffer.data()),
+                                       size_t(buffer.size()));
+        if (error != 0)
+            return error;
+        out.resize(count);
+        decodeArray(data, out.data(), count, elementStride);
+        return 0;
+    }
+
+    // 写入 size 字节。布局未描述的字节与同一字节中未描述的位写为0，
+    // 需要保留时先 read 或对已上传的映像（如 S7_Recipe）调用 encode
+    static bool write(S7_BASE *s7, int area, int dbNumber, int startByte, const Struct &value)
+    {
+        quint8 buffer[size] = {};
+        encode(value, buffer);
+        return s7->WriteBytes(area, dbNumber, startByte, buffer, size);
+    }
+};
+
+#endif
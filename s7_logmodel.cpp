@@ -0,0 +1,168 @@
+﻿/******************************************************************************
+ * @file    s7_logmodel.cpp
+ * @brief   有界日志模型，替代不断增长的 QTextEdit 日志
+ *
+ * @details
+ * 功能描述：
+ *    - 环形缓冲区保存最近N条日志，内存占用固定
+ *    - 追加的日志按固定间隔批量插入模型，限制视图刷新频率
+ *    - 时间与颜色按行保存，只有视图请求的可见行才格式化
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现有界日志模型
+ *   2026-10-16 待提交队列改为整批丢弃最旧记录，追加不再逐条移动队列
+ *****************************************************************************/
+
+#include "s7_logmodel.h"
+#include <QDateTime>
+
+S7_LogModel::S7_LogModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent),
+    head(0),
+    count(0),
+    cap(qMax(1, capacity)),
+    total(0)
+{
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(100);
+    connect(flushTimer, &QTimer::timeout, this, &S7_LogModel::flush);
+}
+
+//————————————————————————————
+// 追加与清空
+void S7_LogModel::append(const QString &text, const QColor &color)
+{
+    // 超过容量的待提交记录提交后也会被丢弃；累积到两倍容量时整批丢掉最旧的，
+    // 每次丢弃移动 cap 条，均摊到每次追加为常数
+    if (pending.size() >= 2 * cap)
+        pending.erase(pending.begin(), pending.end() - cap);
+
+    Entry entry;
+    entry.timeMs = QDateTime::currentMSecsSinceEpoch();
+    entry.text = text;
+    entry.color = color;
+    pending.append(entry);
+    total++;
+
+    if (!flushTimer->isActive())
+        flushTimer->start();
+}
+
+void S7_LogModel::clear()
+{
+    flushTimer->stop();
+    beginResetModel();
+    ring.clear();
+    pending.clear();
+    head = 0;
+    count = 0;
+    total = 0;
+    endResetModel();
+    emit totalCountChanged(total);
+}
+
+// 批量提交：先删除将被覆盖的最旧行，再在末尾插入新行
+void S7_LogModel::flush()
+{
+    if (pending.isEmpty())
+        return;
+
+    const int skip = qMax(0, pending.size() - cap);   // 待提交队列中超出容量的最旧记录
+    const int incoming = pending.size() - skip;
+    const int overflow = qMax(0, count + incoming - cap);
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        head = (head + overflow) % cap;
+        count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), count, count + incoming - 1);
+    for (auto it = pending.begin() + skip; it != pending.end(); ++it) {
+        Entry &entry = *it;
+        const int slot = (head + count) % cap;
+        if (slot < ring.size())
+            ring[slot] = std::move(entry);
+        else
+            ring.append(std::move(entry));
+        count++;
+    }
+    pending.clear();
+    endInsertRows();
+
+    emit totalCountChanged(total);
+}
+
+//————————————————————————————
+// 配置
+void S7_LogModel::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if (capacity == cap)
+        return;
+
+    flush();
+    beginResetModel();
+    const int keep = qMin(count, capacity);
+    QVector<Entry> resized;
+    resized.reserve(keep);
+    for (int row = count - keep; row < count; ++row)
+        resized.append(entryAt(row));
+    ring.swap(resized);
+    head = 0;
+    count = keep;
+    cap = capacity;
+    endResetModel();
+}
+
+int S7_LogModel::capacity() const
+{
+    return cap;
+}
+
+void S7_LogModel::setFlushInterval(int ms)
+{
+    flushTimer->setInterval(qMax(0, ms));
+}
+
+quint64 S7_LogModel::totalCount() const
+{
+    return total;
+}
+
+//————————————————————————————
+// 模型接口
+const S7_LogModel::Entry &S7_LogModel::entryAt(int row) const
+{
+    return ring[(head + row) % cap];
+}
+
+int S7_LogModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : count;
+}
+
+QVariant S7_LogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= count)
+        return QVariant();
+
+    const Entry &entry = entryAt(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString("[%1]%2")
+            .arg(QDateTime::fromMSecsSinceEpoch(entry.timeMs).toString("HH:mm:ss"))
+            .arg(entry.text);
+    case Qt::ForegroundRole:
+        if (entry.color.isValid())
+            return entry.color;
+        return QVariant();
+    default:
+        return QVariant();
+    }
+}
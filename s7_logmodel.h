@@ -0,0 +1,53 @@
+﻿#ifndef S7_LOGMODEL_H
+#define S7_LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QColor>
+#include <QTimer>
+
+// 日志模型：环形缓冲区保存最近 capacity 条日志，超出后丢弃最旧的记录。
+// 追加的日志先进入待提交队列，由定时器按固定间隔批量插入，视图刷新频率与日志频率无关。
+// 配合 QListView（setUniformItemSizes）使用，只有可见行会被格式化和绘制
+class S7_LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit S7_LogModel(int capacity = 5000, QObject *parent = nullptr);
+
+    void append(const QString &text, const QColor &color = QColor());
+    void clear();
+
+    void setCapacity(int capacity);        // 保留条数上限
+    int capacity() const;
+    void setFlushInterval(int ms);         // 批量插入间隔
+    quint64 totalCount() const;            // 累计追加的日志数（含已丢弃的）
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+public slots:
+    void flush();
+
+signals:
+    void totalCountChanged(quint64 total);
+
+private:
+    struct Entry {
+        qint64 timeMs = 0;
+        QString text;
+        QColor color;
+    };
+
+    const Entry &entryAt(int row) const;
+
+    QVector<Entry> ring;        // 环形缓冲区，容量为 cap
+    int head;                   // 最旧记录的下标
+    int count;                  // 当前记录数
+    int cap;
+    QVector<Entry> pending;     // 待提交的日志，达到 2*cap 条时整批丢弃最旧的，提交时只取最后 cap 条
+    quint64 total;
+    QTimer *flushTimer;
+};
+
+#endif
@@ -0,0 +1,303 @@
+﻿/******************************************************************************
+ * @file    s7_metrics.cpp
+ * @brief   通信计量，区分网络/PLC耗时与本地排队、处理耗时
+ *
+ * @details
+ * 功能描述：
+ *    - 每个操作记录 Cli_GetExecTime、本地服务耗时、排队等待、字节数、报文数与错误码
+ *    - 每个线程独占一个计数槽，只有本线程写入，计数用 relaxed 读写代替原子加
+ *    - 线程退出后计数槽交给后续新线程复用，累计值不丢失
+ *    - 快照汇总所有计数槽，可相减得到区间统计，可输出 JSON
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现通信计量
+ *****************************************************************************/
+
+#include "s7_metrics.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <chrono>
+
+namespace {
+
+// 单写者计数：本线程读后写，其他线程只读
+inline void bump(std::atomic<quint64> &counter, quint64 delta)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+struct LiveHistogram {
+    std::atomic<quint64> counts[S7_Histogram::Buckets];
+    std::atomic<quint64> total{0};
+    std::atomic<quint64> sum{0};
+    std::atomic<quint64> maximum{0};
+
+    LiveHistogram()
+    {
+        for (auto &count : counts)
+            count.store(0, std::memory_order_relaxed);
+    }
+
+    void add(qint64 value)
+    {
+        const quint64 v = value > 0 ? quint64(value) : 0;
+        bump(counts[S7_Histogram::bucketOf(v)], 1);
+        bump(total, 1);
+        bump(sum, v);
+        if (v > maximum.load(std::memory_order_relaxed))
+            maximum.store(v, std::memory_order_relaxed);
+    }
+
+    void collect(S7_Histogram &out) const
+    {
+        for (int i = 0; i < S7_Histogram::Buckets; ++i)
+            out.counts[i] += counts[i].load(std::memory_order_relaxed);
+        out.total += total.load(std::memory_order_relaxed);
+        out.sum += sum.load(std::memory_order_relaxed);
+        out.maximum = qMax(out.maximum, maximum.load(std::memory_order_relaxed));
+    }
+};
+
+struct LiveOp {
+    std::atomic<quint64> count{0};
+    std::atomic<quint64> errors{0};
+    std::atomic<quint64> bytes{0};
+    std::atomic<quint64> pdus{0};
+    std::atomic<int> lastError{0};
+    LiveHistogram queueWait;
+    LiveHistogram service;
+    LiveHistogram plcExec;
+};
+
+struct ThreadSlot {
+    std::atomic<bool> inUse{true};
+    LiveOp ops[S7_Metrics::OpCount];
+};
+
+// 计数槽登记表：只在线程首次记录和取快照时加锁，计数槽永不释放
+struct SlotRegistry {
+    QMutex mutex;
+    QVector<ThreadSlot*> slots;
+
+    ThreadSlot *acquire()
+    {
+        QMutexLocker locker(&mutex);
+        for (ThreadSlot *slot : qAsConst(slots)) {
+            if (!slot->inUse.load(std::memory_order_relaxed)) {
+                slot->inUse.store(true, std::memory_order_relaxed);
+                return slot;
+            }
+        }
+        slots.append(new ThreadSlot);
+        return slots.last();
+    }
+};
+
+SlotRegistry &registry()
+{
+    static SlotRegistry instance;
+    return instance;
+}
+
+// 线程退出时归还计数槽
+struct SlotHolder {
+    ThreadSlot *slot = nullptr;
+    ~SlotHolder()
+    {
+        if (slot)
+            slot->inUse.store(false, std::memory_order_release);
+    }
+};
+
+ThreadSlot *threadSlot()
+{
+    static thread_local SlotHolder holder;
+    if (!holder.slot)
+        holder.slot = registry().acquire();
+    return holder.slot;
+}
+
+std::atomic<bool> metricsEnabled{true};
+
+void subtract(S7_Histogram &h, const S7_Histogram &earlier)
+{
+    for (int i = 0; i < S7_Histogram::Buckets; ++i)
+        h.counts[i] -= earlier.counts[i];
+    h.total -= earlier.total;
+    h.sum -= earlier.sum;
+}
+
+QJsonObject histogramJson(const S7_Histogram &h)
+{
+    QJsonObject object;
+    object["count"] = double(h.total);
+    object["mean"] = h.mean();
+    object["p50"] = double(h.percentile(0.5));
+    object["p90"] = double(h.percentile(0.9));
+    object["p99"] = double(h.percentile(0.99));
+    object["p999"] = double(h.percentile(0.999));
+    object["max"] = double(h.maximum);
+    return object;
+}
+
+} // namespace
+
+//————————————————————————————
+// 直方图
+int S7_Histogram::bucketOf(quint64 value)
+{
+    if (value < 16)
+        return int(value);
+    const int msb = qMin(63 - qCountLeadingZeroBits(value), 40);
+    if (msb == 40 && (value >> 40) > 1)
+        return Buckets - 1;
+    return 16 + (msb - 4) * 8 + int((value >> (msb - 3)) & 7);
+}
+
+quint64 S7_Histogram::upperBound(int index)
+{
+    if (index < 16)
+        return quint64(index);
+    const int msb = (index - 16) / 8 + 4;
+    const quint64 low = quint64(8 + (index - 16) % 8) << (msb - 3);
+    return low + (quint64(1) << (msb - 3)) - 1;
+}
+
+quint64 S7_Histogram::percentile(double p) const
+{
+    if (total == 0)
+        return 0;
+    const quint64 rank = qMax<quint64>(1, quint64(p * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < Buckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+            return qMin(upperBound(i), maximum);
+    }
+    return maximum;
+}
+
+//————————————————————————————
+// 记录
+void S7_Metrics::record(Op op, const Sample &sample)
+{
+    if (!metricsEnabled.load(std::memory_order_relaxed))
+        return;
+
+    LiveOp &live = threadSlot()->ops[op];
+    bump(live.count, 1);
+    bump(live.bytes, sample.bytes);
+    bump(live.pdus, quint64(qMax(0, sample.pdus)));
+    if (sample.result != 0) {
+        bump(live.errors, 1);
+        live.lastError.store(sample.result, std::memory_order_relaxed);
+    }
+    live.queueWait.add(sample.queueWaitUs);
+    live.service.add(sample.serviceUs);
+    if (sample.plcExecUs >= 0)
+        live.plcExec.add(sample.plcExecUs);
+}
+
+S7_Metrics::Snapshot S7_Metrics::snapshot()
+{
+    Snapshot snap;
+    snap.timestampMs = QDateTime::currentMSecsSinceEpoch();
+
+    SlotRegistry &reg = registry();
+    QMutexLocker locker(&reg.mutex);
+    snap.threads = reg.slots.size();
+    for (const ThreadSlot *slot : qAsConst(reg.slots)) {
+        for (int k = 0; k < OpCount; ++k) {
+            const LiveOp &live = slot->ops[k];
+            OpStats &stats = snap.ops[k];
+            stats.count += live.count.load(std::memory_order_relaxed);
+            stats.errors += live.errors.load(std::memory_order_relaxed);
+            stats.bytes += live.bytes.load(std::memory_order_relaxed);
+            stats.pdus += live.pdus.load(std::memory_order_relaxed);
+            const int lastError = live.lastError.load(std::memory_order_relaxed);
+            if (lastError != 0)
+                stats.lastError = lastError;
+            live.queueWait.collect(stats.queueWait);
+            live.service.collect(stats.service);
+            live.plcExec.collect(stats.plcExec);
+        }
+    }
+    return snap;
+}
+
+S7_Metrics::Snapshot S7_Metrics::Snapshot::since(const Snapshot &earlier) const
+{
+    Snapshot delta = *this;
+    for (int k = 0; k < OpCount; ++k) {
+        OpStats &stats = delta.ops[k];
+        const OpStats &base = earlier.ops[k];
+        stats.count -= base.count;
+        stats.errors -= base.errors;
+        stats.bytes -= base.bytes;
+        stats.pdus -= base.pdus;
+        subtract(stats.queueWait, base.queueWait);
+        subtract(stats.service, base.service);
+        subtract(stats.plcExec, base.plcExec);
+    }
+    return delta;
+}
+
+// 机器可读输出：每种操作一个对象，时间单位为微秒
+QByteArray S7_Metrics::Snapshot::toJson() const
+{
+    QJsonObject ops;
+    for (int k = 0; k < OpCount; ++k) {
+        const OpStats &stats = this->ops[k];
+        QJsonObject object;
+        object["count"] = double(stats.count);
+        object["errors"] = double(stats.errors);
+        object["last_error"] = stats.lastError;
+        object["bytes"] = double(stats.bytes);
+        object["pdus"] = double(stats.pdus);
+        object["queue_wait_us"] = histogramJson(stats.queueWait);
+        object["service_us"] = histogramJson(stats.service);
+        object["plc_exec_us"] = histogramJson(stats.plcExec);
+        ops[opName(Op(k))] = object;
+    }
+    QJsonObject root;
+    root["timestamp_ms"] = double(timestampMs);
+    root["threads"] = threads;
+    root["ops"] = ops;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+const char *S7_Metrics::opName(Op op)
+{
+    switch (op) {
+    case OpRead:       return "read";
+    case OpWrite:      return "write";
+    case OpReadMulti:  return "read_multi";
+    case OpWriteMulti: return "write_multi";
+    case OpControl:    return "control";
+    default:           return "unknown";
+    }
+}
+
+void S7_Metrics::setEnabled(bool enabled)
+{
+    metricsEnabled = enabled;
+}
+
+bool S7_Metrics::isEnabled()
+{
+    return metricsEnabled;
+}
+
+qint64 S7_Metrics::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
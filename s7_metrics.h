@@ -0,0 +1,84 @@
+﻿#ifndef S7_METRICS_H
+#define S7_METRICS_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+// 延迟直方图：对数分桶，小于16精确计数，之后每个2的幂区间再分8档（相对误差约12%），上限约2^40
+struct S7_Histogram {
+    static const int Buckets = 16 + 37 * 8;
+
+    QVector<quint64> counts = QVector<quint64>(Buckets, 0);
+    quint64 total = 0;
+    quint64 sum = 0;
+    quint64 maximum = 0;
+
+    quint64 percentile(double p) const;     // 第 p 分位（0~1）所在桶的上界
+    double mean() const { return total ? double(sum) / total : 0; }
+
+    static int bucketOf(quint64 value);
+    static quint64 upperBound(int index);
+};
+
+// 通信计量：S7_BASE 与异步客户端的每个操作记录执行耗时（Cli_GetExecTime）、本地服务耗时、
+// 排队等待、字节数、报文数与错误码。每个线程写自己的计数槽（单写者，无锁无原子读改写），
+// 读取时汇总所有线程，热路径不与其他线程竞争缓存行
+class S7_Metrics
+{
+public:
+    enum Op {
+        OpRead,         // ReadArea
+        OpWrite,        // WriteArea
+        OpReadMulti,    // ReadMultiVars，每个报文一次
+        OpWriteMulti,   // WriteMultiVars，每个报文一次
+        OpControl,      // 连接、状态查询等
+        OpCount
+    };
+
+    // 一次操作的测量值，时间单位均为微秒
+    struct Sample {
+        int result = 0;         // 0为成功，否则为 Cli_GetLastError 的错误码
+        quint64 bytes = 0;      // 用户数据字节数
+        int pdus = 1;
+        qint64 queueWaitUs = 0; // 入队到开始执行
+        qint64 serviceUs = 0;   // 调用 snap7 的总耗时（网络 + PLC + 本地）
+        qint64 plcExecUs = -1;  // Cli_GetExecTime，毫秒精度，小于0为不可用
+    };
+
+    struct OpStats {
+        quint64 count = 0;
+        quint64 errors = 0;
+        quint64 bytes = 0;
+        quint64 pdus = 0;
+        int lastError = 0;
+        S7_Histogram queueWait;
+        S7_Histogram service;
+        S7_Histogram plcExec;
+    };
+
+    struct Snapshot {
+        qint64 timestampMs = 0;
+        int threads = 0;        // 记录过数据的线程数
+        OpStats ops[OpCount];
+
+        // 与较早的快照相减得到区间统计（最大值不可相减，取当前值）
+        Snapshot since(const Snapshot &earlier) const;
+        QByteArray toJson() const;
+    };
+
+    static void record(Op op, const Sample &sample);
+    static Snapshot snapshot();
+    static const char *opName(Op op);
+
+    // 全局开关，关闭后 record 直接返回
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // 单调时钟（纳秒），用于计算排队与服务耗时
+    static qint64 nowNs();
+};
+
+#endif
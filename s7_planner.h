@@ -0,0 +1,49 @@
+﻿#ifndef S7_PLANNER_H
+#define S7_PLANNER_H
+
+#include <QVector>
+#include "s7_tag.h"
+
+// 合并后的单个读请求块
+struct ReadBlock {
+    int area;
+    int dbNumber;
+    int start;          // 块起始字节
+    int size;           // 块长度（字节）
+    int bufferOffset;   // 块在合并缓冲区中的偏移
+};
+
+// 读请求规划器：按区域/DB排序变量地址，将间隙小于阈值的区间合并为一次读取，
+// 单块长度不超过协商后的PDU数据长度，读取后按偏移切出每个变量的数据
+class S7_ReadPlanner
+{
+public:
+    S7_ReadPlanner();
+
+    // 允许合并的最大间隙（字节），间隙内的无用字节也会被读取
+    void setMaxGap(int bytes);
+    int maxGap() const;
+    // 单块最大长度，通常取 S7_BASE::PduPayloadSize()
+    void setMaxBlockSize(int bytes);
+    int maxBlockSize() const;
+
+    // 根据变量地址生成读计划；isolated 非空时，标记为 true 的变量单独成块，不与其他变量合并
+    void plan(const QVector<TagAddress> &tags, const QVector<bool> *isolated = nullptr);
+
+    const QVector<ReadBlock> &blocks() const;
+    int bufferSize() const;
+    // 第 tagIndex 个变量所在的块及其在合并缓冲区中的偏移
+    int tagBlock(int tagIndex) const;
+    int tagOffset(int tagIndex) const;
+
+private:
+    int gapBytes;
+    int blockBytes;
+    int totalBytes;
+    QVector<ReadBlock> blockList;
+    QVector<int> order;         // 排序后的变量下标（复用）
+    QVector<int> blockOfTag;
+    QVector<int> offsetOfTag;
+};
+
+#endif
@@ -0,0 +1,237 @@
+﻿/******************************************************************************
+ * @file    s7_pool.cpp
+ * @brief   S7连接池，对同一PLC建立多个会话并行收发
+ *
+ * @details
+ * 功能描述：
+ *    - 对同一IP/机架/插槽建立N个会话，支持PG/OP/S7基本连接类型
+ *    - 批量请求按字节量拆分到各健康会话，由线程池并行执行
+ *    - 定时健康检查（连接状态 + PLC状态查询），失效会话自动重连；
+ *      检查在单独的线程池中执行，阻塞的重连不会拖住并行读写
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现连接池
+ *   2026-10-16 循环读取以低优先级提交到会话I/O线程
+ *   2026-10-16 按错误码判断会话失效，近期有成功通信的会话跳过健康检查的状态查询
+ *   2026-10-16 健康检查与重连移到独立线程池，不再占用拆分请求的工作线程
+ *****************************************************************************/
+
+#include "s7_pool.h"
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QSemaphore>
+
+S7_ConnectionPool::S7_ConnectionPool(QObject *parent)
+    : QObject(parent)
+{
+    healthTimer = new QTimer(this);
+    healthTimer->setInterval(5000);
+    connect(healthTimer, &QTimer::timeout, this, &S7_ConnectionPool::healthCheck);
+}
+
+S7_ConnectionPool::~S7_ConnectionPool()
+{
+    close();
+}
+
+//————————————————————————————
+// 打开与关闭
+int S7_ConnectionPool::open(const QString &ip, int rack, int slot, int count, quint16 connectionType)
+{
+    close();
+
+    int opened = 0;
+    {
+        QWriteLocker locker(&stateLock);
+        for (int i = 0; i < count; ++i) {
+            Session *session = new Session;
+            session->s7.SetConnectionType(connectionType);
+            session->healthy = session->s7.Connect(ip, rack, slot);
+            if (session->healthy)
+                opened++;
+            sessions.append(session);
+        }
+        workers.setMaxThreadCount(qMax(1, count));
+        checkers.setMaxThreadCount(qMax(1, count));
+    }
+    healthTimer->start();
+    return opened;
+}
+
+void S7_ConnectionPool::close()
+{
+    healthTimer->stop();
+    workers.waitForDone();
+    checkers.waitForDone();
+
+    QWriteLocker locker(&stateLock);
+    for (Session *session : qAsConst(sessions)) {
+        QMutexLocker sessionLocker(&session->mutex);
+        session->s7.Disconnect();
+    }
+    qDeleteAll(sessions);
+    sessions.clear();
+}
+
+int S7_ConnectionPool::sessionCount() const
+{
+    QReadLocker locker(&stateLock);
+    return sessions.size();
+}
+
+int S7_ConnectionPool::healthyCount() const
+{
+    QReadLocker locker(&stateLock);
+    int count = 0;
+    for (Session *session : sessions) {
+        if (session->healthy)
+            count++;
+    }
+    return count;
+}
+
+int S7_ConnectionPool::pduPayloadSize()
+{
+    QReadLocker locker(&stateLock);
+    for (Session *session : qAsConst(sessions)) {
+        if (session->healthy)
+            return session->s7.PduPayloadSize();
+    }
+    return 240 - 18;
+}
+
+quint64 S7_ConnectionPool::sessionTelegrams(int index) const
+{
+    QReadLocker locker(&stateLock);
+    if (index < 0 || index >= sessions.size())
+        return 0;
+    return sessions[index]->telegrams;
+}
+
+void S7_ConnectionPool::setHealthCheckInterval(int ms)
+{
+    healthTimer->setInterval(qMax(100, ms));
+}
+
+//————————————————————————————
+// 批量读写
+int S7_ConnectionPool::readMultiVars(QVector<S7_MultiItem> &items)
+{
+    return transfer(items, false);
+}
+
+int S7_ConnectionPool::writeMultiVars(QVector<S7_MultiItem> &items)
+{
+    return transfer(items, true);
+}
+
+int S7_ConnectionPool::transfer(QVector<S7_MultiItem> &items, bool write)
+{
+    QReadLocker locker(&stateLock);
+
+    QVector<int> ready;
+    for (int i = 0; i < sessions.size(); ++i) {
+        if (sessions[i]->healthy)
+            ready.append(i);
+    }
+    if (ready.isEmpty() || items.isEmpty()) {
+        for (S7_MultiItem &item : items) {
+            item.result = errIsoConnect;
+            item.execTimeMs = -1;
+        }
+        return 0;
+    }
+
+    // 估算所需报文数，只有一个报文能装下时不拆分
+    const int pdu = sessions[ready.first()]->s7.PduLength();
+    int totalBytes = 0;
+    for (const S7_MultiItem &item : qAsConst(items))
+        totalBytes += 4 + item.size + (item.size & 1) + (write ? 12 : 0);
+    int needed = qMax((totalBytes + pdu - 15) / (pdu - 14), (items.size() + MaxVars - 1) / MaxVars);
+    int parts = qMin(qMin(ready.size(), needed), items.size());
+    if (parts <= 1)
+        return runSlice(ready.first(), items, write);
+
+    // 按字节量均分为 parts 段，保持原有顺序
+    QVector<QVector<S7_MultiItem>> slices(parts);
+    QVector<int> sliceBegin(parts + 1, items.size());
+    sliceBegin[0] = 0;
+    int accumulated = 0;
+    int part = 0;
+    for (int i = 0; i < items.size(); ++i) {
+        if (part + 1 < parts && accumulated >= totalBytes * (part + 1) / parts) {
+            part++;
+            sliceBegin[part] = i;
+        }
+        slices[part].append(items[i]);
+        accumulated += 4 + items[i].size + (items[i].size & 1) + (write ? 12 : 0);
+    }
+
+    // 第0段在当前线程执行，其余段交给线程池
+    std::atomic<int> telegrams(0);
+    QSemaphore done;
+    for (int k = 1; k < parts; ++k) {
+        workers.start([this, k, write, &ready, &slices, &telegrams, &done]() {
+            telegrams += runSlice(ready[k], slices[k], write);
+            done.release();
+        });
+    }
+    telegrams += runSlice(ready[0], slices[0], write);
+    done.acquire(parts - 1);
+
+    for (int k = 0; k < parts; ++k) {
+        for (int j = 0; j < slices[k].size(); ++j) {
+            items[sliceBegin[k] + j].result = slices[k][j].result;
+            items[sliceBegin[k] + j].execTimeMs = slices[k][j].execTimeMs;
+        }
+    }
+    return telegrams;
+}
+
+// 在指定会话上执行一段请求，出现链路错误时标记会话失效，等待健康检查重连。
+// 数据项被PLC拒绝不影响会话状态，不再额外发送状态查询确认
+int S7_ConnectionPool::runSlice(int index, QVector<S7_MultiItem> &items, bool write)
+{
+    Session *session = sessions[index];
+    QMutexLocker locker(&session->mutex);
+
+    int telegrams = write ? session->s7.WriteMultiVars(items)
+                          : session->s7.ReadMultiVars(items, S7_BASE::PriorityCyclic);
+    session->telegrams += telegrams;
+
+    if (session->s7.IsLinkLost()) {
+        if (session->healthy.exchange(false))
+            emit sessionStateChanged(index, false);
+    }
+    return telegrams;
+}
+
+//————————————————————————————
+// 健康检查：在检查线程池中逐个检查，正在收发或一个检查周期内成功通信过的会话视为正常。
+// 重连会阻塞到握手结束或超时，不能放进 workers，否则拆分的请求段排在其后，readMultiVars 随之卡住
+void S7_ConnectionPool::healthCheck()
+{
+    QReadLocker locker(&stateLock);
+    const qint64 fresh = healthTimer->interval();
+    for (int i = 0; i < sessions.size(); ++i) {
+        Session *session = sessions[i];
+        checkers.start([this, session, i, fresh]() {
+            if (!session->mutex.tryLock())
+                return;
+            const qint64 idle = session->s7.IdleMs();
+            bool ok = session->s7.isConnected() && idle >= 0 && idle < fresh;
+            if (!ok)
+                ok = session->s7.CheckConnection();
+            if (!ok)
+                ok = session->s7.Reconnect();
+            session->mutex.unlock();
+            if (session->healthy.exchange(ok) != ok)
+                emit sessionStateChanged(i, ok);
+        });
+    }
+}
@@ -0,0 +1,61 @@
+﻿#ifndef S7_POOL_H
+#define S7_POOL_H
+
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include "s7_base.h"
+
+// 连接池：对同一PLC建立多个S7会话，批量请求拆分到各会话并行执行，
+// 定时健康检查，失效会话自动重连；检查与重连在单独的线程池中执行，不占用拆分请求的线程
+class S7_ConnectionPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit S7_ConnectionPool(QObject *parent = nullptr);
+    ~S7_ConnectionPool();
+
+    // 打开 count 个会话，返回成功建立的会话数
+    int open(const QString &ip, int rack, int slot, int count, quint16 connectionType = CONNTYPE_PG);
+    void close();
+
+    int sessionCount() const;
+    int healthyCount() const;
+    int pduPayloadSize();
+    quint64 sessionTelegrams(int index) const;  // 各会话累计发送的报文数
+
+    // 数据项按字节量拆分到各健康会话并行读写，返回发送的报文数
+    int readMultiVars(QVector<S7_MultiItem> &items);
+    int writeMultiVars(QVector<S7_MultiItem> &items);
+
+    void setHealthCheckInterval(int ms);
+
+public slots:
+    void healthCheck();
+
+signals:
+    void sessionStateChanged(int index, bool healthy);
+
+private:
+    struct Session {
+        S7_BASE s7;
+        QMutex mutex;                       // 收发期间持有，健康检查据此跳过忙碌会话
+        std::atomic<bool> healthy{false};
+        std::atomic<quint64> telegrams{0};
+    };
+
+    int transfer(QVector<S7_MultiItem> &items, bool write);
+    int runSlice(int index, QVector<S7_MultiItem> &items, bool write);
+
+    mutable QReadWriteLock stateLock;       // 保护 sessions 的打开/关闭
+    QVector<Session*> sessions;
+    QThreadPool workers;                    // 执行拆分后的请求段
+    QThreadPool checkers;                   // 执行健康检查与重连
+    QTimer *healthTimer;
+};
+
+#endif
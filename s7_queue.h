@@ -0,0 +1,65 @@
+﻿#ifndef S7_QUEUE_H
+#define S7_QUEUE_H
+
+#include <atomic>
+
+// 侵入式无锁多生产者单消费者队列节点，需要入队的结构体继承此节点
+struct S7_QueueNode {
+    std::atomic<S7_QueueNode*> next{nullptr};
+};
+
+// 无锁MPSC队列（Vyukov算法）：任意线程 push，仅一个线程 pop，
+// 入队只有一次原子交换，不分配内存
+class S7_MpscQueue
+{
+public:
+    S7_MpscQueue()
+        : head(&stub),
+        tail(&stub)
+    {
+    }
+
+    S7_MpscQueue(const S7_MpscQueue &) = delete;
+    S7_MpscQueue &operator=(const S7_MpscQueue &) = delete;
+
+    void push(S7_QueueNode *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        S7_QueueNode *prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 仅消费线程调用；返回 nullptr 表示队列为空或生产者尚未完成链接
+    S7_QueueNode *pop()
+    {
+        S7_QueueNode *first = tail;
+        S7_QueueNode *next = first->next.load(std::memory_order_acquire);
+        if (first == &stub) {
+            if (!next)
+                return nullptr;
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return first;
+        }
+        if (first != head.load(std::memory_order_acquire))
+            return nullptr;
+        push(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next) {
+            tail = next;
+            return first;
+        }
+        return nullptr;
+    }
+
+private:
+    std::atomic<S7_QueueNode*> head;
+    S7_QueueNode *tail;
+    S7_QueueNode stub;
+};
+
+#endif
@@ -0,0 +1,413 @@
+﻿/******************************************************************************
+ * @file    s7_recipe.cpp
+ * @brief   配方/参数块的整块传输
+ *
+ * @details
+ * 功能描述：
+ *    - 上传：Cli_DBGet 或按长度读取整个DB到映像
+ *    - 按字段布局（偏移、类型、位、字符串长度）显示与编辑映像中的值
+ *    - 下载：重新读取PLC当前映像，与上次上传的映像三方比较，只写入用户修改过的位，
+ *      不会覆盖PLC在此期间改写的其他数据
+ *    - 修改过的字段整字节写入，只改了部分位的字节逐位以 S7WLBit 写入，
+ *      变化区间经写队列打包，超过PDU的区间由snap7分包
+ *    - 映像可保存为原始字节文件并重新加载
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现配方整块上传、比较与下载
+ *   2026-10-16 默认不再合并间隙，bool 字段按位写入，不回写PLC快照中的其他位
+ *****************************************************************************/
+
+#include "s7_recipe.h"
+#include "s7_writequeue.h"
+#include <QFile>
+#include <QRegularExpression>
+#include <QStringList>
+
+S7_Recipe::S7_Recipe()
+    : db(1),
+    dbSize(0),
+    gapBytes(0)
+{
+
+}
+
+void S7_Recipe::setDb(int dbNumber, int size)
+{
+    db = qMax(1, dbNumber);
+    dbSize = qBound(0, size, 65535);
+}
+
+int S7_Recipe::dbNumber() const
+{
+    return db;
+}
+
+int S7_Recipe::size() const
+{
+    return edited.isEmpty() ? dbSize : edited.size();
+}
+
+void S7_Recipe::setMergeGap(int bytes)
+{
+    gapBytes = qMax(0, bytes);
+}
+
+//————————————————————————————
+// 布局
+bool S7_Recipe::setLayout(const QString &text, QString *errorText)
+{
+    static const QRegularExpression linePattern(
+        "^(\\d+)(?:\\.([0-7]))?\\s+(int|float|bool|char|string(?:\\[(\\d+)\\])?)(?:\\s+(.+))?$",
+        QRegularExpression::CaseInsensitiveOption);
+
+    QVector<RecipeField> parsed;
+    const QStringList lines = text.split('\n');
+    for (int n = 0; n < lines.size(); ++n) {
+        const QString line = lines[n].section('#', 0, 0).trimmed();
+        if (line.isEmpty())
+            continue;
+        const QRegularExpressionMatch match = linePattern.match(line);
+        if (!match.hasMatch()) {
+            if (errorText)
+                *errorText = QString("line %1: expected <offset>[.<bit>] <type> [name]").arg(n + 1);
+            return false;
+        }
+
+        RecipeField field;
+        field.offset = match.captured(1).toInt();
+        field.bitOffset = match.captured(2).toInt();
+        const QString type = match.captured(3).toLower();
+        if (type == "int") field.dataType = DT_Int;
+        else if (type == "float") field.dataType = DT_Float;
+        else if (type == "bool") field.dataType = DT_Bool;
+        else if (type == "char") field.dataType = DT_Char;
+        else field.dataType = DT_String;
+        if (field.dataType == DT_String && !match.captured(4).isEmpty())
+            field.strLength = quint16(qBound(1, match.captured(4).toInt(), 254));
+        field.name = match.captured(5).trimmed();
+        if (field.name.isEmpty())
+            field.name = match.captured(2).isEmpty() ? QString("DBX%1").arg(field.offset)
+                                                     : QString("DBX%1.%2").arg(field.offset).arg(field.bitOffset);
+        parsed.append(field);
+    }
+    fieldList = parsed;
+    return true;
+}
+
+void S7_Recipe::setFields(const QVector<RecipeField> &fields)
+{
+    fieldList = fields;
+}
+
+const QVector<RecipeField> &S7_Recipe::fields() const
+{
+    return fieldList;
+}
+
+int S7_Recipe::fieldSize(const RecipeField &field)
+{
+    TagAddress tag;
+    tag.dataType = field.dataType;
+    tag.strLength = field.strLength;
+    return tagByteSize(tag);
+}
+
+bool S7_Recipe::fieldFits(int field) const
+{
+    if (field < 0 || field >= fieldList.size())
+        return false;
+    const RecipeField &f = fieldList[field];
+    return f.offset + fieldSize(f) <= edited.size();
+}
+
+//————————————————————————————
+// 上传：指定长度时按长度读取（snap7按PDU分包），否则由 Cli_DBGet 查询长度
+int S7_Recipe::upload(S7_BASE *s7)
+{
+    QByteArray image;
+    int error;
+    if (dbSize > 0) {
+        image.resize(dbSize);
+        error = s7->ReadArea(S7AreaDB, db, 0, reinterpret_cast<quint8*>(image.data()), size_t(image.size()));
+    } else {
+        error = s7->DBGet(db, image);
+    }
+    if (error != 0)
+        return error;
+    edited = image;
+    baseline = image;
+    return 0;
+}
+
+// 用户修改过的位（相对上次的PLC映像）。修改过的非bool字段整个字段视为修改（整字节写入），
+// 没有上次的映像（未上传、加载了文件）时全部视为修改
+QByteArray S7_Recipe::modifiedMask() const
+{
+    const bool known = baseline.size() == edited.size();
+    QByteArray mask(edited.size(), known ? char(0) : char(0xFF));
+    if (!known)
+        return mask;
+
+    for (int i = 0; i < edited.size(); ++i)
+        mask[i] = char(edited[i] ^ baseline[i]);
+    for (const RecipeField &f : fieldList) {
+        if (f.dataType == DT_Bool || f.offset + fieldSize(f) > edited.size())
+            continue;
+        const int end = f.offset + fieldSize(f);
+        bool modified = false;
+        for (int i = f.offset; i < end && !modified; ++i)
+            modified = mask[i] != 0;
+        if (modified) {
+            for (int i = f.offset; i < end; ++i)
+                mask[i] = char(0xFF);
+        }
+    }
+    return mask;
+}
+
+// 三方合并：掩码内的位取编辑值，其余位取PLC当前值
+QByteArray S7_Recipe::mergedWith(const QByteArray &plcImage, const QByteArray &mask) const
+{
+    QByteArray merged = plcImage;
+    const int count = qMin(merged.size(), edited.size());
+    for (int i = 0; i < count; ++i) {
+        const quint8 m = quint8(mask[i]);
+        if (m)
+            merged[i] = char((quint8(plcImage[i]) & ~m) | (quint8(edited[i]) & m));
+    }
+    return merged;
+}
+
+// 整字节修改的连续字节合并为区间；只修改了部分位的字节逐位列出，
+// 不整字节写入，避免把PLC快照中的其他位写回
+QVector<RecipeRange> S7_Recipe::diff(const QByteArray &plcImage) const
+{
+    QVector<RecipeRange> ranges;
+    const QByteArray mask = modifiedMask();
+    const QByteArray merged = mergedWith(plcImage, mask);
+    const int count = qMin(merged.size(), plcImage.size());
+    int i = 0;
+    while (i < count) {
+        if (merged[i] == plcImage[i]) {
+            i++;
+            continue;
+        }
+        if (quint8(mask[i]) != 0xFF) {
+            const quint8 changed = quint8(merged[i] ^ plcImage[i]);
+            for (int bit = 0; bit < 8; ++bit) {
+                if (!(changed & (1 << bit)))
+                    continue;
+                RecipeRange range;
+                range.start = i;
+                range.size = 1;
+                range.bit = bit;
+                ranges.append(range);
+            }
+            i++;
+            continue;
+        }
+        int end = i + 1;
+        while (end < count && merged[end] != plcImage[end] && quint8(mask[end]) == 0xFF)
+            end++;
+        // 只有设置了合并间隙时才与上一个字节区间合并，间隙按PLC当前值写回
+        RecipeRange *last = nullptr;
+        for (int k = ranges.size() - 1; k >= 0 && !last; --k) {
+            if (ranges[k].bit < 0)
+                last = &ranges[k];
+        }
+        if (gapBytes > 0 && last && i - (last->start + last->size) <= gapBytes) {
+            last->size = end - last->start;
+            i = end;
+            continue;
+        }
+        RecipeRange range;
+        range.start = i;
+        range.size = end - i;
+        ranges.append(range);
+        i = end;
+    }
+    return ranges;
+}
+
+// 下载：读取PLC当前映像 -> 比较 -> 写入变化区间，成功后编辑映像与PLC映像一致
+RecipeTransfer S7_Recipe::download(S7_BASE *s7)
+{
+    RecipeTransfer transfer;
+    if (edited.isEmpty()) {
+        transfer.error = errCliInvalidParams;
+        return transfer;
+    }
+
+    QByteArray current(edited.size(), 0);
+    transfer.error = s7->ReadArea(S7AreaDB, db, 0, reinterpret_cast<quint8*>(current.data()),
+                                  size_t(current.size()));
+    const int payload = s7->PduPayloadSize();
+    transfer.readTelegrams = (current.size() + payload - 1) / payload;
+    if (transfer.error != 0)
+        return transfer;
+
+    const QByteArray merged = mergedWith(current, modifiedMask());
+    const QVector<RecipeRange> ranges = diff(current);
+    if (!ranges.isEmpty()) {
+        S7_WriteQueue queue(s7);
+        for (const RecipeRange &range : ranges) {
+            if (range.bit >= 0) {
+                queue.writeBool(S7AreaDB, db, range.start, range.bit,
+                                (quint8(merged[range.start]) >> range.bit) & 1);
+                transfer.bitWrites++;
+                continue;
+            }
+            queue.writeBytes(S7AreaDB, db, range.start,
+                             reinterpret_cast<const quint8*>(merged.constData()) + range.start, range.size);
+            transfer.ranges++;
+            transfer.changedBytes += range.size;
+        }
+        const WriteReport report = queue.flush();
+        transfer.writeTelegrams = report.telegrams;
+        if (report.failedWrites > 0) {
+            transfer.error = report.lastError;
+            return transfer;
+        }
+    }
+    edited = merged;
+    baseline = merged;
+    return transfer;
+}
+
+//————————————————————————————
+// 编辑
+QString S7_Recipe::displayValue(int field, bool plc) const
+{
+    const QByteArray &source = plc ? baseline : edited;
+    if (!fieldFits(field) || source.size() != edited.size())
+        return QString();
+
+    const RecipeField &f = fieldList[field];
+    const quint8 *data = reinterpret_cast<const quint8*>(source.constData()) + f.offset;
+    switch (f.dataType) {
+    case DT_Bool:
+        return S7_BASE::GetBool(data, f.bitOffset) ? "TRUE" : "FALSE";
+    case DT_Float:
+        return QString::number(S7_BASE::GetFloat(data));
+    case DT_String:
+        return S7_BASE::GetString(data, f.strLength);
+    case DT_Char:
+        return QString(QChar::fromLatin1(S7_BASE::GetChar(data)));
+    case DT_Int:
+    default:
+        return QString::number(S7_BASE::GetInt(data));
+    }
+}
+
+bool S7_Recipe::setDisplayValue(int field, const QString &text)
+{
+    if (!fieldFits(field))
+        return false;
+
+    const RecipeField &f = fieldList[field];
+    quint8 *data = reinterpret_cast<quint8*>(edited.data()) + f.offset;
+    bool ok = true;
+    switch (f.dataType) {
+    case DT_Bool: {
+        const QString value = text.trimmed().toLower();
+        if (value != "true" && value != "false" && value != "1" && value != "0")
+            return false;
+        // 只改该位，同一字节的其他位仍按PLC当前值写入
+        if (value == "true" || value == "1")
+            data[0] |= quint8(1 << f.bitOffset);
+        else
+            data[0] &= quint8(~(1 << f.bitOffset));
+        break;
+    }
+    case DT_Float: {
+        const float value = text.trimmed().toFloat(&ok);
+        if (!ok)
+            return false;
+        S7_BASE::SetFloat(data, value);
+        break;
+    }
+    case DT_String:
+        if (text.size() > f.strLength)
+            return false;
+        S7_BASE::SetString(data, text, f.strLength);
+        break;
+    case DT_Char:
+        if (text.size() != 1 || text.at(0).unicode() > 0xFF)
+            return false;
+        S7_BASE::SetChar(data, text.at(0).toLatin1());
+        break;
+    case DT_Int:
+    default: {
+        const int value = text.trimmed().toInt(&ok);
+        if (!ok || value < -32768 || value > 32767)
+            return false;
+        S7_BASE::SetInt(data, value);
+        break;
+    }
+    }
+    return true;
+}
+
+// PLC映像未知时所有字段都视为待写入
+bool S7_Recipe::isModified(int field) const
+{
+    if (!fieldFits(field))
+        return false;
+    if (baseline.size() != edited.size())
+        return true;
+    const RecipeField &f = fieldList[field];
+    if (f.dataType == DT_Bool)
+        return (quint8(edited[f.offset] ^ baseline[f.offset]) >> f.bitOffset) & 1;
+    return edited.mid(f.offset, fieldSize(f)) != baseline.mid(f.offset, fieldSize(f));
+}
+
+bool S7_Recipe::isModified() const
+{
+    return edited != baseline;
+}
+
+void S7_Recipe::revert()
+{
+    if (baseline.size() == edited.size())
+        edited = baseline;
+}
+
+const QByteArray &S7_Recipe::image() const
+{
+    return edited;
+}
+
+//————————————————————————————
+// 文件
+bool S7_Recipe::save(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write(edited) == edited.size();
+}
+
+bool S7_Recipe::load(const QString &path, QString *errorText)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorText)
+            *errorText = file.errorString();
+        return false;
+    }
+    const QByteArray image = file.readAll();
+    if (image.isEmpty() || image.size() > 65535 || (!edited.isEmpty() && image.size() != edited.size())) {
+        if (errorText)
+            *errorText = QString("size %1 does not match DB size %2").arg(image.size()).arg(edited.size());
+        return false;
+    }
+    edited = image;
+    // 未上传过时PLC映像未知，下载时与PLC当前值逐字节比较
+    if (baseline.size() != edited.size())
+        baseline.clear();
+    return true;
+}
@@ -0,0 +1,91 @@
+﻿#ifndef S7_RECIPE_H
+#define S7_RECIPE_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include "s7_base.h"
+#include "s7_tag.h"
+
+// 配方字段：DB内偏移 + 数据类型
+struct RecipeField {
+    QString name;
+    int offset = 0;
+    int bitOffset = 0;          // 仅bool有效
+    DataType dataType = DT_Int;
+    quint16 strLength = 20;     // 仅string有效
+};
+
+// 需要写入的区间；bit >= 0 时为单个位（start 为字节地址，size 为1），以 S7WLBit 写入
+struct RecipeRange {
+    int start;
+    int size;
+    int bit = -1;
+};
+
+// 一次下载的统计
+struct RecipeTransfer {
+    int error = 0;              // 0为成功
+    int ranges = 0;             // 写入的字节区间数（合并后）
+    int changedBytes = 0;       // 写入的字节数（含合并的间隙）
+    int bitWrites = 0;          // 以 S7WLBit 单独写入的位数
+    int readTelegrams = 0;      // 读取PLC当前映像的报文数
+    int writeTelegrams = 0;     // 写入的报文数
+};
+
+// 配方：整个DB的映像 + 字段布局。上传时读取整个DB，按字段编辑映像，
+// 下载时重新读取PLC当前映像，只写入用户修改过且与PLC不同的部分：
+// 修改过的非bool字段整字节写入，字节内只改了部分位（bool字段）时逐位以 S7WLBit 写入，
+// 同一字节中未修改的位不随写入回送，区间经写队列打包，超过PDU的区间由snap7分包写入。
+// 非线程安全，上传/下载期间不能编辑
+class S7_Recipe
+{
+public:
+    S7_Recipe();
+
+    // DB号与长度，长度为0时上传使用 Cli_DBGet 自动获取
+    void setDb(int dbNumber, int size = 0);
+    int dbNumber() const;
+    int size() const;
+    // 相距不超过该字节数的变化区间合并为一个写入项，默认0（不合并）。
+    // 间隙按下载前读取的PLC映像写回，PLC在读取与写入之间改写的间隙数据会被还原，只在确知间隙无人写入时使用
+    void setMergeGap(int bytes);
+
+    // 布局文本：每行 "<偏移>[.<位>] <类型> [名称]"，类型为 int/float/bool/char/string[长度]，# 之后为注释
+    bool setLayout(const QString &text, QString *errorText = nullptr);
+    void setFields(const QVector<RecipeField> &fields);
+    const QVector<RecipeField> &fields() const;
+    bool fieldFits(int field) const;    // 字段是否落在映像范围内
+
+    // 与PLC交换，返回错误码
+    int upload(S7_BASE *s7);
+    RecipeTransfer download(S7_BASE *s7);
+    // 相对PLC映像 plcImage 需要写入的字节区间与单独的位（只含用户修改过的部分）
+    QVector<RecipeRange> diff(const QByteArray &plcImage) const;
+
+    // 编辑：plc 为 true 时取上次上传/下载后的PLC值
+    QString displayValue(int field, bool plc = false) const;
+    bool setDisplayValue(int field, const QString &text);
+    bool isModified(int field) const;
+    bool isModified() const;
+    void revert();                      // 放弃所有修改
+    const QByteArray &image() const;
+
+    // 映像保存为原始字节文件；加载后与上次PLC映像不同的位视为修改，未上传过时全部视为修改
+    bool save(const QString &path) const;
+    bool load(const QString &path, QString *errorText = nullptr);
+
+private:
+    QByteArray modifiedMask() const;
+    QByteArray mergedWith(const QByteArray &plcImage, const QByteArray &mask) const;
+    static int fieldSize(const RecipeField &field);
+
+    int db;
+    int dbSize;
+    int gapBytes;
+    QVector<RecipeField> fieldList;
+    QByteArray edited;      // 编辑中的映像
+    QByteArray baseline;    // 上次上传/下载后的PLC映像，为空表示未知
+};
+
+#endif
@@ -0,0 +1,21 @@
+﻿#ifndef S7_RESULT_H
+#define S7_RESULT_H
+
+#include <QtGlobal>
+#include "s7_tag.h"
+
+// 带质量码的读取结果：失败时 value 为默认值，调用方据 quality/error 区分坏值与真实的0，
+// 无需再读一次确认
+template <typename T>
+struct S7_Result {
+    T value{};
+    TagQuality quality = QualityBad;
+    int error = 0;              // snap7 错误码，0为成功
+    qint64 timestamp = 0;       // 完成时刻（毫秒，UTC）
+    int execTimeMs = -1;        // PLC侧执行耗时（Cli_GetExecTime），-1表示未知
+
+    bool isGood() const { return quality == QualityGood; }
+    explicit operator bool() const { return isGood(); }
+};
+
+#endif
@@ -0,0 +1,399 @@
+﻿/******************************************************************************
+ * @file    s7_scheduler.cpp
+ * @brief   循环采集调度器，替代每个任务一个线程的 TaskWorker 模式
+ *
+ * @details
+ * 功能描述：
+ *    - 所有循环任务共用一个采集线程和一个定时器
+ *    - 同一时刻到期的任务合并为一个批次执行，减少线程唤醒次数
+ *    - 批次内相邻地址合并为少量读请求，按偏移切片解析
+ *    - 合并后的分散块通过 ReadMultiVars 打包，一个报文读取多个区域
+ *    - 可选使用连接池，多个会话并行读取；批次读取是同步的 ReadMultiVars，
+ *      不走 S7_AsyncClient 的流水线（snap7 无异步 MultiVars，原因见 s7_async.h），
+ *      报文与报文之间的重叠由连接池的并行会话提供
+ *    - 每个批次输出统计信息（变量数、报文数、耗时、滞后），用于评估采集间隔
+ *    - PLC拒绝的变量按指数退避推迟读取，成功后恢复原周期
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现批量调度
+ *   2026-10-16 批次内使用 S7_ReadPlanner 合并读请求
+ *   2026-10-16 合并块改用 ReadMultiVars 打包读取
+ *   2026-10-16 支持连接池
+ *   2026-10-16 循环读取以低优先级提交
+ *   2026-10-16 批次统计增加失败变量数
+ *   2026-10-16 读取结果写入变量表
+ *   2026-10-16 去掉逐变量格式化与信号，采集路径不再分配内存
+ *   2026-10-16 批次统计增加变化变量数
+ *   2026-10-16 任务按编号哈希定位，增删为 O(1)
+ *   2026-10-16 变化的值写入历史库
+ *   2026-10-16 变化的值送入趋势通道
+ *   2026-10-16 错误码与执行耗时写入变量表，数据项错误的变量单独退避
+ *   2026-10-16 合并块被拒绝时块内变量逐个重读，失败变量此后单独成块，不再连坐
+ *   2026-10-16 去掉每批次的 tickFinished 信号，统计改由 lastStats() 读取
+ *   2026-10-16 历史按变量地址记录，不再使用会被复用的任务编号
+ *****************************************************************************/
+
+#include "s7_scheduler.h"
+#include <QMutexLocker>
+#include <QDateTime>
+
+S7_Scheduler::S7_Scheduler(S7_BASE *s7Ptr, QObject *parent)
+    : QObject(parent),
+    s7(s7Ptr),
+    connectionPool(nullptr),
+    tagTable(nullptr),
+    historian(nullptr),
+    trendBuffer(nullptr),
+    running(false),
+    coalesceWindowMs(5),
+    maxGapBytes(16),
+    tickCount(0),
+    taskTotal(0)
+{
+    clock.start();
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, &QTimer::timeout, this, &S7_Scheduler::onTimeout);
+}
+
+S7_Scheduler::~S7_Scheduler()
+{
+
+}
+
+//————————————————————————————
+// 任务管理：命令先进入队列，由采集线程在批次开始前统一生效
+void S7_Scheduler::addTask(int taskId, const TagAddress &tag, int interval)
+{
+    Command cmd;
+    cmd.kind = Command::Add;
+    cmd.task.taskId = taskId;
+    cmd.task.tag = tag;
+    cmd.task.interval = qMax(1, interval);
+    cmd.task.nextDue = 0;
+    cmd.task.failures = 0;
+    postCommand(cmd);
+}
+
+void S7_Scheduler::removeTask(int taskId)
+{
+    Command cmd;
+    cmd.kind = Command::Remove;
+    cmd.task.taskId = taskId;
+    postCommand(cmd);
+}
+
+void S7_Scheduler::clearTasks()
+{
+    Command cmd;
+    cmd.kind = Command::Clear;
+    postCommand(cmd);
+}
+
+int S7_Scheduler::taskCount() const
+{
+    return taskTotal.load();
+}
+
+void S7_Scheduler::setCoalesceWindow(int ms)
+{
+    QMutexLocker locker(&cmdMutex);
+    coalesceWindowMs = qMax(0, ms);
+}
+
+void S7_Scheduler::setMaxGap(int bytes)
+{
+    QMutexLocker locker(&cmdMutex);
+    maxGapBytes = qMax(0, bytes);
+}
+
+void S7_Scheduler::setConnectionPool(S7_ConnectionPool *pool)
+{
+    connectionPool = pool;
+}
+
+void S7_Scheduler::setTagTable(S7_TagTable *table)
+{
+    tagTable = table;
+}
+
+void S7_Scheduler::setHistorian(S7_Historian *historianPtr)
+{
+    historian = historianPtr;
+}
+
+void S7_Scheduler::setTrendBuffer(S7_TrendBuffer *buffer)
+{
+    trendBuffer = buffer;
+}
+
+qint64 S7_Scheduler::elapsedMs() const
+{
+    return clock.elapsed();
+}
+
+TickStats S7_Scheduler::lastStats() const
+{
+    QMutexLocker locker(&cmdMutex);
+    return stats;
+}
+
+void S7_Scheduler::postCommand(const Command &cmd)
+{
+    {
+        QMutexLocker locker(&cmdMutex);
+        commands.append(cmd);
+    }
+    // 定时器模式下唤醒采集线程，使新任务立即执行
+    if (running)
+        QMetaObject::invokeMethod(this, "wake", Qt::QueuedConnection);
+}
+
+void S7_Scheduler::applyCommands(qint64 nowMs)
+{
+    QVector<Command> pending;
+    {
+        QMutexLocker locker(&cmdMutex);
+        if (commands.isEmpty())
+            return;
+        pending.swap(commands);
+    }
+
+    for (const Command &cmd : pending) {
+        switch (cmd.kind) {
+        case Command::Add: {
+            Task task = cmd.task;
+            task.nextDue = nowMs;   // 新任务立即执行一次
+            const int slot = taskSlot.value(task.taskId, -1);
+            if (slot >= 0) {
+                tasks[slot] = task;
+            } else {
+                taskSlot.insert(task.taskId, tasks.size());
+                tasks.append(task);
+            }
+            break;
+        }
+        case Command::Remove: {
+            // 与末尾任务交换后删除，O(1)
+            const int slot = taskSlot.value(cmd.task.taskId, -1);
+            if (slot < 0)
+                break;
+            const int last = tasks.size() - 1;
+            if (slot != last) {
+                tasks[slot] = tasks[last];
+                taskSlot[tasks[slot].taskId] = slot;
+            }
+            tasks.removeLast();
+            taskSlot.remove(cmd.task.taskId);
+            break;
+        }
+        case Command::Clear:
+            tasks.clear();
+            taskSlot.clear();
+            break;
+        }
+    }
+    taskTotal.store(tasks.size());
+}
+
+qint64 S7_Scheduler::nextDueTime() const
+{
+    if (tasks.isEmpty())
+        return -1;
+    qint64 next = tasks.first().nextDue;
+    for (const Task &task : tasks)
+        next = qMin(next, task.nextDue);
+    return next;
+}
+
+//————————————————————————————
+// 批量采集：收集所有到期任务，在一个批次中依次读取
+qint64 S7_Scheduler::poll(qint64 nowMs)
+{
+    applyCommands(nowMs);
+    if (tasks.isEmpty())
+        return -1;
+
+    int window;
+    int gap;
+    {
+        QMutexLocker locker(&cmdMutex);
+        window = coalesceWindowMs;
+        gap = maxGapBytes;
+    }
+
+    dueIndex.clear();
+    for (int i = 0; i < tasks.size(); ++i) {
+        if (tasks[i].nextDue <= nowMs + window)
+            dueIndex.append(i);
+    }
+    if (dueIndex.isEmpty())
+        return nextDueTime();
+
+    QElapsedTimer passTimer;
+    passTimer.start();
+
+    TickStats tick;
+    tick.tickIndex = ++tickCount;
+
+    // 合并相邻地址，每个块一次读请求
+    // 最近被PLC拒绝的变量单独成块，不再与正常变量合并读取
+    dueTags.clear();
+    dueIsolated.clear();
+    for (int idx : qAsConst(dueIndex)) {
+        dueTags.append(tasks[idx].tag);
+        dueIsolated.append(tasks[idx].failures > 0);
+    }
+    S7_ConnectionPool *pool = connectionPool;
+    planner.setMaxGap(gap);
+    planner.setMaxBlockSize(pool ? pool->pduPayloadSize() : s7->PduPayloadSize());
+    planner.plan(dueTags, &dueIsolated);
+
+    if (readBuffer.size() < planner.bufferSize())
+        readBuffer.resize(planner.bufferSize());
+    quint8 *buffer = reinterpret_cast<quint8*>(readBuffer.data());
+    const QVector<ReadBlock> &blocks = planner.blocks();
+    readItems.resize(blocks.size());
+    for (int b = 0; b < blocks.size(); ++b) {
+        const ReadBlock &block = blocks[b];
+        S7_MultiItem &item = readItems[b];
+        item.area = block.area;
+        item.dbNumber = block.dbNumber;
+        item.start = block.start;
+        item.size = block.size;
+        item.buffer = buffer + block.bufferOffset;
+        item.result = 0;
+        item.execTimeMs = -1;
+    }
+    // 分散的块打包为 MultiVars 请求，多个区域/DB共用一个报文
+    tick.pdusSent += pool ? pool->readMultiVars(readItems)
+                        : s7->ReadMultiVars(readItems, S7_BASE::PriorityCyclic);
+
+    // 合并块被PLC拒绝（非链路错误）时，块内变量在本批次内逐个重读，
+    // 只有真正出错的变量得到坏质量并退避，其余变量不受牵连
+    blockMembers.fill(0, blocks.size());
+    for (int i = 0; i < dueIndex.size(); ++i)
+        blockMembers[planner.tagBlock(i)]++;
+    retryItems.clear();
+    tagRetry.fill(-1, dueIndex.size());
+    for (int i = 0; i < dueIndex.size(); ++i) {
+        const int b = planner.tagBlock(i);
+        const int result = readItems[b].result;
+        if (result == 0 || S7_BASE::IsLinkError(result) || blockMembers[b] < 2)
+            continue;
+        const TagAddress &tag = dueTags[i];
+        S7_MultiItem item;
+        item.area = tag.area;
+        item.dbNumber = tag.dbNumber;
+        item.start = tag.startByte;
+        item.size = tagByteSize(tag);
+        item.buffer = buffer + planner.tagOffset(i);
+        item.result = 0;
+        item.execTimeMs = -1;
+        tagRetry[i] = retryItems.size();
+        retryItems.append(item);
+    }
+    if (!retryItems.isEmpty()) {
+        tick.pdusSent += pool ? pool->readMultiVars(retryItems)
+                            : s7->ReadMultiVars(retryItems, S7_BASE::PriorityCyclic);
+    }
+
+    // 按偏移从合并缓冲区切出各变量的值，直接解码写入变量表，不生成字符串
+    S7_TagTable *table = tagTable;
+    S7_Historian *history = historian;
+    S7_TrendBuffer *trend = trendBuffer;
+    const qint64 stamp = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < dueIndex.size(); ++i) {
+        Task &task = tasks[dueIndex[i]];
+        int late = static_cast<int>(nowMs - task.nextDue);
+        if (late > tick.lateMs)
+            tick.lateMs = late;
+        if (late >= task.interval)
+            tick.overrun = true;
+
+        const S7_MultiItem &item = (tagRetry[i] >= 0) ? retryItems[tagRetry[i]]
+                                                      : readItems[planner.tagBlock(i)];
+        const quint8 *data = (item.result == 0) ? buffer + planner.tagOffset(i) : nullptr;
+        if (table && table->store(task.taskId, data, stamp, item.result, item.execTimeMs)) {
+            tick.tagsChanged++;
+            if ((history || trend) && task.tag.dataType != DT_String) {
+                const TagSample sample = table->sample(task.taskId);
+                if (history)
+                    history->append(task.tag, sample.timestamp, sample.value,
+                                    sample.quality == QualityGood);
+                if (trend && sample.quality == QualityGood)
+                    trend->push(task.taskId, sample.timestamp, sample.value);
+            }
+        }
+        tick.tagsServed++;
+        if (!data) {
+            tick.tagsFailed++;
+            tick.lastError = item.result;
+        }
+
+        // 数据项错误：重读只会得到同样的拒绝，按 周期*2^n 推迟，不超过上限
+        if (data) {
+            task.failures = 0;
+        } else if (!S7_BASE::IsLinkError(item.result)) {
+            task.failures++;
+            const qint64 limit = qMax<qint64>(task.interval, MaxTagBackoffMs);
+            task.nextDue = nowMs + qMin(qint64(task.interval) << qMin(task.failures, 10), limit);
+            tick.tagsBackedOff++;
+            continue;
+        }
+
+        // 按周期对齐计算下次到期时间，落后超过一个周期则丢弃错过的周期
+        task.nextDue += task.interval;
+        if (task.nextDue <= nowMs)
+            task.nextDue = nowMs + task.interval;
+    }
+    tick.elapsedUs = static_cast<int>(passTimer.nsecsElapsed() / 1000);
+
+    {
+        QMutexLocker locker(&cmdMutex);
+        stats = tick;
+    }
+
+    return nextDueTime();
+}
+
+//————————————————————————————
+// 定时器模式：在采集线程中调用 start()
+void S7_Scheduler::start()
+{
+    running = true;
+    wake();
+}
+
+void S7_Scheduler::stop()
+{
+    running = false;
+    timer->stop();
+}
+
+void S7_Scheduler::onTimeout()
+{
+    reschedule(poll(clock.elapsed()));
+}
+
+void S7_Scheduler::wake()
+{
+    if (!running)
+        return;
+    reschedule(poll(clock.elapsed()));
+}
+
+void S7_Scheduler::reschedule(qint64 nextDue)
+{
+    if (!running || nextDue < 0) {
+        timer->stop();
+        return;
+    }
+    qint64 delay = nextDue - clock.elapsed();
+    timer->start(static_cast<int>(qMax<qint64>(0, delay)));
+}
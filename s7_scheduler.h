@@ -0,0 +1,128 @@
+﻿#ifndef S7_SCHEDULER_H
+#define S7_SCHEDULER_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <atomic>
+#include "s7_base.h"
+#include "s7_tag.h"
+#include "s7_planner.h"
+#include "s7_pool.h"
+#include "s7_tagtable.h"
+#include "s7_historian.h"
+#include "s7_trendbuffer.h"
+
+// 单次批量采集的统计信息
+struct TickStats {
+    quint64 tickIndex = 0;  // 批次序号
+    int tagsServed = 0;     // 本批次读取的变量数
+    int tagsFailed = 0;     // 其中读取失败的变量数
+    int tagsChanged = 0;    // 经变化过滤后写入变量表的变量数
+    int tagsBackedOff = 0;  // 因数据项错误推迟下次读取的变量数
+    int lastError = 0;      // 本批次最后一个失败数据项的错误码
+    int pdusSent = 0;       // 本批次发送的报文数
+    int elapsedUs = 0;      // 本批次耗时（微秒）
+    int lateMs = 0;         // 最早到期任务的滞后时间（毫秒）
+    bool overrun = false;   // 是否超限（有任务滞后超过一个周期）
+};
+Q_DECLARE_METATYPE(TickStats)
+
+// 采集调度器：所有循环任务共用一个线程、一个定时器和一个连接，
+// 同一时刻到期的任务合并为一个批次执行。
+// PLC拒绝的数据项（地址越界、DB不存在等）按变量单独退避，链路错误不退避，由重连负责恢复
+class S7_Scheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static const int MaxTagBackoffMs = 30000;   // 单个变量退避的上限（周期更长时以周期为准）
+
+    explicit S7_Scheduler(S7_BASE *s7Ptr, QObject *parent = nullptr);
+    ~S7_Scheduler();
+
+    // 以下接口线程安全，可在界面线程中调用，修改在下一批次开始前生效
+    void addTask(int taskId, const TagAddress &tag, int interval);
+    void removeTask(int taskId);
+    void clearTasks();
+    int taskCount() const;
+
+    // 合并窗口：到期时间落在窗口内的任务提前并入当前批次
+    void setCoalesceWindow(int ms);
+    // 地址合并阈值：同一区域/DB内间隙不超过该字节数的变量合并为一次读取
+    void setMaxGap(int bytes);
+    // 设置连接池后批量读取分散到池中各会话并行执行，传 nullptr 恢复单连接
+    void setConnectionPool(S7_ConnectionPool *pool);
+    // 读取结果按任务编号写入变量表，不设置变量表时结果被丢弃
+    void setTagTable(S7_TagTable *table);
+    // 写入变量表且发生变化的值同时按变量地址记录到历史库，传 nullptr 停止记录
+    void setHistorian(S7_Historian *historian);
+    // 变化的值同时送入趋势通道（采集线程只写入，不等待界面），传 nullptr 停止
+    void setTrendBuffer(S7_TrendBuffer *buffer);
+
+    // 执行一次批量采集，返回下一次到期时间（毫秒，-1表示无任务）
+    qint64 poll(qint64 nowMs);
+    qint64 elapsedMs() const;
+    // 最近一个批次的统计，界面与引擎按帧读取；批次结束不发信号，跨线程信号每次都要分配事件
+    TickStats lastStats() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void onTimeout();
+    void wake();
+
+private:
+    struct Task {
+        int taskId;
+        TagAddress tag;
+        int interval;
+        qint64 nextDue;
+        int failures;           // 连续的数据项错误次数
+    };
+    struct Command {
+        enum Kind { Add, Remove, Clear } kind;
+        Task task;
+    };
+
+    void applyCommands(qint64 nowMs);
+    qint64 nextDueTime() const;
+    void reschedule(qint64 nextDue);
+    void postCommand(const Command &cmd);
+
+    S7_BASE *s7;
+    std::atomic<S7_ConnectionPool*> connectionPool;
+    std::atomic<S7_TagTable*> tagTable;
+    std::atomic<S7_Historian*> historian;
+    std::atomic<S7_TrendBuffer*> trendBuffer;
+    QTimer *timer;
+    QElapsedTimer clock;
+    std::atomic<bool> running;
+    int coalesceWindowMs;
+    int maxGapBytes;
+    quint64 tickCount;
+
+    QVector<Task> tasks;        // 仅在采集线程中访问，顺序无关
+    QHash<int, int> taskSlot;   // 任务编号 -> tasks 下标
+    QVector<int> dueIndex;      // 本批次到期任务下标（复用，避免重复分配）
+    QVector<TagAddress> dueTags;
+    QVector<bool> dueIsolated;  // 本批次需单独成块的变量（最近读取失败）
+    S7_ReadPlanner planner;
+    QByteArray readBuffer;      // 合并读取缓冲区
+    QVector<S7_MultiItem> readItems;
+    QVector<int> blockMembers;  // 每个块包含的变量数
+    QVector<S7_MultiItem> retryItems;   // 被拒绝的合并块拆开后的逐变量重读
+    QVector<int> tagRetry;      // 变量 -> retryItems 下标，-1表示取合并块的结果
+
+    mutable QMutex cmdMutex;    // 保护 commands 与 stats
+    QVector<Command> commands;
+    TickStats stats;
+    std::atomic<int> taskTotal;     // 已生效的任务数
+};
+
+#endif
@@ -0,0 +1,476 @@
+﻿/******************************************************************************
+ * @file    s7_simulator.cpp
+ * @brief   仿真PLC，无硬件时的本地测试与压测目标
+ *
+ * @details
+ * 功能描述：
+ *    - snap7 服务器工作在回调模式，所有读写经 Srv_SetRWAreaCallback 访问进程内映像
+ *    - DB/M/I/Q 映像，支持位访问（S7WLBit）与字节访问
+ *    - 脚本化值发生器（常量、锯齿、正弦、方波、随机、计数）在独立线程中按间隔改写映像
+ *    - 每个报文可附加延迟与抖动；可限制PDU长度和连接数
+ *    - 故障注入：数据项按概率返回错误、报文按概率挂起使客户端超时、断开所有连接
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现仿真PLC
+ *****************************************************************************/
+
+#include "s7_simulator.h"
+#include "s7_base.h"
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QDateTime>
+#include <QStringList>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+
+namespace {
+
+const int DefaultAreaSize = 1024;
+const double TwoPi = 6.283185307179586;
+
+int imageKey(int area, int dbNumber)
+{
+    return (area << 16) | (area == S7AreaDB ? (dbNumber & 0xFFFF) : 0);
+}
+
+// 每个线程独立的随机数发生器，回调在 snap7 的各客户端线程中执行
+std::mt19937 &randomEngine()
+{
+    thread_local std::mt19937 engine(std::random_device{}());
+    return engine;
+}
+
+double uniform()
+{
+    return std::uniform_real_distribution<double>(0.0, 1.0)(randomEngine());
+}
+
+void sleepMs(int ms)
+{
+    if (ms > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+} // namespace
+
+S7_Simulator::S7_Simulator()
+    : running(false),
+    generatorThread(nullptr),
+    stopping(false),
+    generatorMs(10),
+    latencyMs(0),
+    jitterMs(0),
+    errorRate(0),
+    stallRate(0),
+    stallMs(5000),
+    pduSize(480),
+    maxClients(32),
+    requestCount(0),
+    readCount(0),
+    writeCount(0),
+    errorCount(0),
+    stallCount(0),
+    dropCount(0)
+{
+    images.insert(imageKey(S7AreaMK, 0), QByteArray(DefaultAreaSize, 0));
+    images.insert(imageKey(S7AreaPE, 0), QByteArray(DefaultAreaSize, 0));
+    images.insert(imageKey(S7AreaPA, 0), QByteArray(DefaultAreaSize, 0));
+}
+
+S7_Simulator::~S7_Simulator()
+{
+    stop();
+}
+
+//————————————————————————————
+// 存储区与发生器
+void S7_Simulator::addDb(int number, int size)
+{
+    if (running || number < 1 || number > 0xFFFF)
+        return;
+    images.insert(imageKey(S7AreaDB, number), QByteArray(qBound(1, size, 65535), 0));
+}
+
+void S7_Simulator::setAreaSize(int area, int size)
+{
+    if (running || area == S7AreaDB)
+        return;
+    images.insert(imageKey(area, 0), QByteArray(qBound(1, size, 65535), 0));
+}
+
+void S7_Simulator::addGenerator(const SimGenerator &generator)
+{
+    if (!running)
+        generators.append(generator);
+}
+
+void S7_Simulator::clearGenerators()
+{
+    if (!running)
+        generators.clear();
+}
+
+bool S7_Simulator::loadScript(const QString &script, QString *errorText)
+{
+    static const QRegularExpression addressPattern("^(?:DB(\\d+)\\.|([MIQ]))(\\d+)(?:\\.([0-7]))?$",
+                                                   QRegularExpression::CaseInsensitiveOption);
+    QVector<SimGenerator> parsed;
+    const QStringList lines = script.split('\n');
+    for (int n = 0; n < lines.size(); ++n) {
+        const QString line = lines[n].section('#', 0, 0).trimmed();
+        if (line.isEmpty())
+            continue;
+        auto fail = [&](const QString &reason) {
+            if (errorText)
+                *errorText = QString("line %1: %2").arg(n + 1).arg(reason);
+            return false;
+        };
+
+        const QStringList fields = line.split(QRegularExpression("\\s+"));
+        if (fields.size() < 3)
+            return fail("expected <address> <type> <wave>");
+
+        SimGenerator generator;
+        const QRegularExpressionMatch match = addressPattern.match(fields[0]);
+        if (!match.hasMatch())
+            return fail("bad address " + fields[0]);
+        if (!match.captured(1).isEmpty()) {
+            generator.tag.area = S7AreaDB;
+            generator.tag.dbNumber = match.captured(1).toInt();
+        } else {
+            const QChar area = match.captured(2).at(0).toUpper();
+            generator.tag.area = area == 'M' ? S7AreaMK : area == 'I' ? S7AreaPE : S7AreaPA;
+        }
+        generator.tag.startByte = match.captured(3).toInt();
+        generator.tag.bitOffset = match.captured(4).toInt();
+
+        const QString type = fields[1].toLower();
+        if (type == "int") generator.tag.dataType = DT_Int;
+        else if (type == "float") generator.tag.dataType = DT_Float;
+        else if (type == "bool") generator.tag.dataType = DT_Bool;
+        else if (type == "char") generator.tag.dataType = DT_Char;
+        else if (type == "string") generator.tag.dataType = DT_String;
+        else return fail("bad type " + fields[1]);
+
+        const QString wave = fields[2].toLower();
+        if (wave == "const") generator.wave = SimGenerator::Constant;
+        else if (wave == "ramp") generator.wave = SimGenerator::Ramp;
+        else if (wave == "sine") generator.wave = SimGenerator::Sine;
+        else if (wave == "square") generator.wave = SimGenerator::Square;
+        else if (wave == "random") generator.wave = SimGenerator::Random;
+        else if (wave == "counter") generator.wave = SimGenerator::Counter;
+        else return fail("bad wave " + fields[2]);
+
+        for (int k = 3; k < fields.size(); ++k) {
+            const QString key = fields[k].section('=', 0, 0).toLower();
+            bool ok = false;
+            const double value = fields[k].section('=', 1).toDouble(&ok);
+            if (!ok)
+                return fail("bad parameter " + fields[k]);
+            if (key == "min") generator.min = value;
+            else if (key == "max") generator.max = value;
+            else if (key == "amp") generator.amplitude = value;
+            else if (key == "offset") generator.offset = value;
+            else if (key == "step") generator.step = value;
+            else if (key == "period") generator.periodMs = qMax(1, int(value));
+            else if (key == "len") generator.tag.strLength = quint16(qBound(1, int(value), 254));
+            else return fail("unknown parameter " + key);
+        }
+        parsed.append(generator);
+    }
+
+    if (running) {
+        if (errorText)
+            *errorText = "simulator is running";
+        return false;
+    }
+    generators += parsed;
+    return true;
+}
+
+void S7_Simulator::setGeneratorInterval(int ms)
+{
+    generatorMs = qMax(1, ms);
+}
+
+//————————————————————————————
+// 通信约束与故障注入
+void S7_Simulator::setLatency(int ms, int jitter)
+{
+    latencyMs = qMax(0, ms);
+    jitterMs = qMax(0, jitter);
+}
+
+void S7_Simulator::setPduSize(int bytes)
+{
+    pduSize = qBound(240, bytes, 960);
+}
+
+void S7_Simulator::setMaxClients(int count)
+{
+    maxClients = qMax(1, count);
+}
+
+void S7_Simulator::setErrorRate(double probability)
+{
+    errorRate = qBound(0.0, probability, 1.0);
+}
+
+void S7_Simulator::setStallRate(double probability, int ms)
+{
+    stallRate = qBound(0.0, probability, 1.0);
+    stallMs = qMax(0, ms);
+}
+
+void S7_Simulator::setCpuRunning(bool run)
+{
+    server.SetCpuStatus(run ? S7CpuStatusRun : S7CpuStatusStop);
+}
+
+//————————————————————————————
+// 启动与停止
+bool S7_Simulator::start(const QString &address)
+{
+    stop();
+
+    int pdu = pduSize;
+    int clients = maxClients;
+    server.SetParam(p_i32_PDURequest, &pdu);
+    server.SetParam(p_i32_MaxClients, &clients);
+    server.SetRWAreaCallback(&S7_Simulator::rwAreaCallback, this);
+    server.SetEventsMask(evcPDUincoming);
+    server.SetEventsCallback(&S7_Simulator::eventCallback, this);
+
+    // 发生器先写一次初值，客户端连接后即可读到有效数据
+    applyGenerators(QDateTime::currentMSecsSinceEpoch());
+
+    const int result = server.StartTo(address.toLatin1().constData());
+    if (result != 0) {
+        error = S7_BASE::ErrorText(result);
+        return false;
+    }
+    listenAddress = address;
+    running = true;
+
+    stopping = false;
+    if (!generators.isEmpty()) {
+        generatorThread = QThread::create([this]() { generatorLoop(); });
+        generatorThread->start();
+    }
+    return true;
+}
+
+void S7_Simulator::stop()
+{
+    if (!running)
+        return;
+    stopping = true;
+    if (generatorThread) {
+        generatorThread->wait();
+        delete generatorThread;
+        generatorThread = nullptr;
+    }
+    server.Stop();
+    running = false;
+}
+
+bool S7_Simulator::isRunning() const
+{
+    return running;
+}
+
+// 重启监听，所有已建立的连接被服务器关闭
+void S7_Simulator::dropConnections()
+{
+    if (!running)
+        return;
+    server.Stop();
+    server.StartTo(listenAddress.toLatin1().constData());
+    dropCount++;
+}
+
+int S7_Simulator::clientCount()
+{
+    return running ? server.ClientsCount() : 0;
+}
+
+S7_Simulator::Stats S7_Simulator::stats() const
+{
+    Stats s;
+    s.requests = requestCount;
+    s.itemsRead = readCount;
+    s.itemsWritten = writeCount;
+    s.errorsInjected = errorCount;
+    s.stallsInjected = stallCount;
+    s.drops = dropCount;
+    return s;
+}
+
+QString S7_Simulator::errorString() const
+{
+    return error;
+}
+
+//————————————————————————————
+// 映像直接访问
+// 需持有 imageMutex
+QByteArray *S7_Simulator::image(int area, int dbNumber)
+{
+    auto it = images.find(imageKey(area, dbNumber));
+    return it == images.end() ? nullptr : &it.value();
+}
+
+QByteArray S7_Simulator::readImage(int area, int dbNumber, int start, int size) const
+{
+    QMutexLocker locker(&imageMutex);
+    auto it = images.constFind(imageKey(area, dbNumber));
+    if (it == images.constEnd() || start < 0 || size < 0 || start + size > it.value().size())
+        return QByteArray();
+    return it.value().mid(start, size);
+}
+
+bool S7_Simulator::writeImage(int area, int dbNumber, int start, const QByteArray &data)
+{
+    QMutexLocker locker(&imageMutex);
+    QByteArray *target = image(area, dbNumber);
+    if (!target || start < 0 || start + data.size() > target->size())
+        return false;
+    memcpy(target->data() + start, data.constData(), size_t(data.size()));
+    return true;
+}
+
+//————————————————————————————
+// snap7 回调（在服务器的客户端线程中执行）
+int S7API S7_Simulator::rwAreaCallback(void *usrPtr, int sender, int operation, PS7Tag tag, void *data)
+{
+    Q_UNUSED(sender);
+    return static_cast<S7_Simulator*>(usrPtr)->handleArea(operation, *tag, static_cast<quint8*>(data));
+}
+
+void S7API S7_Simulator::eventCallback(void *usrPtr, PSrvEvent event, int size)
+{
+    Q_UNUSED(size);
+    if (event->EvtCode == evcPDUincoming)
+        static_cast<S7_Simulator*>(usrPtr)->handlePdu();
+}
+
+// 报文到达：附加延迟，按概率挂起（超过客户端接收超时即模拟丢包）
+void S7_Simulator::handlePdu()
+{
+    requestCount++;
+    const double stall = stallRate;
+    if (stall > 0 && chance(stall)) {
+        stallCount++;
+        sleepMs(stallMs);
+        return;
+    }
+    const int jitter = jitterMs;
+    const int delay = latencyMs + (jitter > 0 ? int(uniform() * (2 * jitter + 1)) - jitter : 0);
+    sleepMs(delay);
+}
+
+// 返回0表示成功，非0时服务器对该数据项回复错误。
+// S7_BASE 只发出字节（S7WLByte）和位（S7WLBit，起始地址为 字节*8+位）访问，Size 为字节数
+int S7_Simulator::handleArea(int operation, const TS7Tag &tag, quint8 *data)
+{
+    const double errors = errorRate;
+    if (errors > 0 && chance(errors)) {
+        errorCount++;
+        return int(errSrvInvalidParams);
+    }
+
+    QMutexLocker locker(&imageMutex);
+    QByteArray *target = image(tag.Area, tag.DBNumber);
+    if (!target)
+        return int(errSrvUnknownArea);
+
+    quint8 *bytes = reinterpret_cast<quint8*>(target->data());
+    if (tag.WordLen == S7WLBit) {
+        const int byteIndex = tag.Start / 8;
+        const int bit = tag.Start % 8;
+        if (byteIndex < 0 || byteIndex >= target->size())
+            return int(errSrvInvalidParams);
+        if (operation == OperationWrite) {
+            if (data[0] & 1)
+                bytes[byteIndex] |= quint8(1 << bit);
+            else
+                bytes[byteIndex] &= quint8(~(1 << bit));
+        } else {
+            data[0] = (bytes[byteIndex] >> bit) & 1;
+        }
+    } else {
+        if (tag.Start < 0 || tag.Size < 0 || tag.Start + tag.Size > target->size())
+            return int(errSrvInvalidParams);
+        if (operation == OperationWrite)
+            memcpy(bytes + tag.Start, data, size_t(tag.Size));
+        else
+            memcpy(data, bytes + tag.Start, size_t(tag.Size));
+    }
+
+    if (operation == OperationWrite)
+        writeCount++;
+    else
+        readCount++;
+    return 0;
+}
+
+bool S7_Simulator::chance(double probability)
+{
+    return uniform() < probability;
+}
+
+//————————————————————————————
+// 值发生器
+void S7_Simulator::generatorLoop()
+{
+    while (!stopping) {
+        sleepMs(generatorMs);
+        applyGenerators(QDateTime::currentMSecsSinceEpoch());
+    }
+}
+
+void S7_Simulator::applyGenerators(qint64 nowMs)
+{
+    QMutexLocker locker(&imageMutex);
+    for (const SimGenerator &g : qAsConst(generators)) {
+        QByteArray *target = image(g.tag.area, g.tag.dbNumber);
+        if (!target || g.tag.startByte + tagByteSize(g.tag) > target->size())
+            continue;
+
+        const double phase = double(nowMs % g.periodMs) / g.periodMs;
+        double value = g.offset;
+        switch (g.wave) {
+        case SimGenerator::Constant: value = g.offset; break;
+        case SimGenerator::Ramp:     value = g.min + (g.max - g.min) * phase; break;
+        case SimGenerator::Sine:     value = g.offset + g.amplitude * std::sin(TwoPi * phase); break;
+        case SimGenerator::Square:   value = phase < 0.5 ? g.max : g.min; break;
+        case SimGenerator::Random:   value = g.min + (g.max - g.min) * uniform(); break;
+        case SimGenerator::Counter: {
+            value = g.offset + g.step * double(nowMs / g.periodMs);
+            if (g.max > g.min)
+                value = g.min + std::fmod(value - g.min, g.max - g.min);
+            break;
+        }
+        }
+
+        quint8 *data = reinterpret_cast<quint8*>(target->data()) + g.tag.startByte;
+        switch (g.tag.dataType) {
+        case DT_Int:    S7_BASE::SetInt(data, int(std::lround(value))); break;
+        case DT_Float:  S7_BASE::SetFloat(data, float(value)); break;
+        case DT_Char:   S7_BASE::SetChar(data, char(int(std::lround(value)))); break;
+        case DT_String: S7_BASE::SetString(data, QString::number(value, 'g', 6), g.tag.strLength); break;
+        case DT_Bool:
+            if (value != 0)
+                data[0] |= quint8(1 << g.tag.bitOffset);
+            else
+                data[0] &= quint8(~(1 << g.tag.bitOffset));
+            break;
+        }
+    }
+}
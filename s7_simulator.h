@@ -0,0 +1,126 @@
+﻿#ifndef S7_SIMULATOR_H
+#define S7_SIMULATOR_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QByteArray>
+#include <QMutex>
+#include <QThread>
+#include <atomic>
+#include <Lib/snap7.h>
+#include "s7_tag.h"
+
+// 仿真值发生器：按波形周期性改写映像中的一个变量
+struct SimGenerator {
+    enum Wave { Constant, Ramp, Sine, Square, Random, Counter };
+
+    TagAddress tag;
+    Wave wave = Constant;
+    double min = 0;         // Ramp/Square/Random/Counter 的范围
+    double max = 100;
+    double amplitude = 1;   // Sine
+    double offset = 0;      // Constant/Sine 的中心值，Counter 的起始值
+    double step = 1;        // Counter 每周期增量
+    int periodMs = 1000;
+};
+
+// 仿真PLC：基于 snap7 服务器的读写回调（Srv_SetRWAreaCallback），在进程内托管 DB/M/I/Q 映像，
+// 支持脚本化值发生器、每个请求的附加延迟与抖动、PDU长度与连接数限制，以及故障注入
+// （数据项返回错误、请求挂起导致客户端超时、断开所有连接）。
+// 所有配置可在运行中修改，存储区与发生器需在 start 之前设置
+class S7_Simulator
+{
+public:
+    struct Stats {
+        quint64 requests = 0;           // 收到的报文数
+        quint64 itemsRead = 0;
+        quint64 itemsWritten = 0;
+        quint64 errorsInjected = 0;
+        quint64 stallsInjected = 0;
+        quint64 drops = 0;
+    };
+
+    S7_Simulator();
+    ~S7_Simulator();
+
+    S7_Simulator(const S7_Simulator &) = delete;
+    S7_Simulator &operator=(const S7_Simulator &) = delete;
+
+    // 存储区映像：DB按需添加；M/I/Q 默认各 1024 字节
+    void addDb(int number, int size);
+    void setAreaSize(int area, int size);
+
+    // 发生器脚本，每行一个变量：<地址> <类型> <波形> [参数=值 ...]，# 开头为注释，例如
+    //   DB1.0 float sine amp=10 offset=50 period=5000
+    //   DB1.4 int ramp min=0 max=1000 period=10000
+    //   M10.3 bool square period=1000
+    //   DB2.0 string random min=0 max=99 len=20
+    // 地址形如 DBn.字节[.位] 或 M/I/Q字节[.位]；波形 const/ramp/sine/square/random/counter；
+    // 参数 min max amp offset step period len
+    bool loadScript(const QString &script, QString *error = nullptr);
+    void addGenerator(const SimGenerator &generator);
+    void clearGenerators();
+    void setGeneratorInterval(int ms);  // 发生器刷新间隔，默认10ms
+
+    // 通信约束与故障注入
+    // 每个报文的附加延迟；snap7 服务器串行调用事件回调，延迟对各连接依次生效，与PLC通信处理器逐个处理作业相同
+    void setLatency(int ms, int jitterMs = 0);
+    void setPduSize(int bytes);                 // 协商PDU上限（240~960），需在 start 之前
+    void setMaxClients(int count);              // 最大连接数，需在 start 之前
+    void setErrorRate(double probability);      // 数据项返回错误的概率
+    void setStallRate(double probability, int stallMs = 5000);  // 报文挂起（客户端超时）的概率
+    void setCpuRunning(bool running);
+
+    bool start(const QString &address = "127.0.0.1");
+    void stop();
+    bool isRunning() const;
+    void dropConnections();             // 断开所有客户端（重启监听）
+    int clientCount();
+
+    // 直接访问映像（不经网络）
+    QByteArray readImage(int area, int dbNumber, int start, int size) const;
+    bool writeImage(int area, int dbNumber, int start, const QByteArray &data);
+
+    Stats stats() const;
+    QString errorString() const;
+
+private:
+    static int S7API rwAreaCallback(void *usrPtr, int sender, int operation, PS7Tag tag, void *data);
+    static void S7API eventCallback(void *usrPtr, PSrvEvent event, int size);
+    int handleArea(int operation, const TS7Tag &tag, quint8 *data);
+    void handlePdu();
+    void generatorLoop();
+    void applyGenerators(qint64 nowMs);
+    QByteArray *image(int area, int dbNumber);
+    static bool chance(double probability);
+
+    TS7Server server;
+    QString listenAddress;
+    bool running;
+
+    QHash<int, QByteArray> images;      // (区域<<16)|DB号 -> 映像，启动后结构不变
+    mutable QMutex imageMutex;          // 保护映像内容
+    QVector<SimGenerator> generators;   // 启动后只读
+
+    QThread *generatorThread;
+    std::atomic<bool> stopping;
+    std::atomic<int> generatorMs;
+    std::atomic<int> latencyMs;
+    std::atomic<int> jitterMs;
+    std::atomic<double> errorRate;
+    std::atomic<double> stallRate;
+    std::atomic<int> stallMs;
+    int pduSize;
+    int maxClients;
+
+    std::atomic<quint64> requestCount;
+    std::atomic<quint64> readCount;
+    std::atomic<quint64> writeCount;
+    std::atomic<quint64> errorCount;
+    std::atomic<quint64> stallCount;
+    std::atomic<quint64> dropCount;
+    QString error;
+};
+
+#endif
@@ -0,0 +1,139 @@
+﻿/******************************************************************************
+ * @file    s7_supervisor.cpp
+ * @brief   连接监督器，链路中断后自动重连
+ *
+ * @details
+ * 功能描述：
+ *    - 定时读取 S7_BASE 的链路中断标志（由链路错误码置位），空闲时主动健康检查
+ *    - 中断后按带抖动的指数退避调用 RestoreLink，用户主动断开后不再重连
+ *    - 重连期间采集请求直接失败、不发报文，任务与读计划保持不变
+ *    - 通过信号报告中断、重连失败与恢复（含尝试次数与中断时长）
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现连接监督
+ *****************************************************************************/
+
+#include "s7_supervisor.h"
+
+S7_Supervisor::S7_Supervisor(S7_BASE *s7Ptr, QObject *parent)
+    : QObject(parent),
+    s7(s7Ptr),
+    recovering(false),
+    backoffInitialMs(500),
+    backoffMaximumMs(30000),
+    backoffFactor(2.0),
+    backoffJitter(0.2),
+    watchMs(200),
+    probeMs(2000),
+    recoveringFlag(false),
+    outages(0)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &S7_Supervisor::onCheck);
+}
+
+S7_Supervisor::~S7_Supervisor()
+{
+
+}
+
+//————————————————————————————
+// 设置
+void S7_Supervisor::setBackoff(int initialMs, int maximumMs, double factor, double jitter)
+{
+    backoffInitialMs = qMax(1, initialMs);
+    backoffMaximumMs = qMax(backoffInitialMs.load(), maximumMs);
+    backoffFactor = qMax(1.0, factor);
+    backoffJitter = qBound(0.0, jitter, 1.0);
+}
+
+void S7_Supervisor::setWatchInterval(int ms)
+{
+    watchMs = qMax(10, ms);
+}
+
+void S7_Supervisor::setProbeInterval(int ms)
+{
+    probeMs = qMax(0, ms);
+}
+
+bool S7_Supervisor::isRecovering() const
+{
+    return recoveringFlag;
+}
+
+quint64 S7_Supervisor::outageCount() const
+{
+    return outages;
+}
+
+//————————————————————————————
+// 启动与停止（在监督器所在线程中调用）
+void S7_Supervisor::start()
+{
+    timer->start(0);
+}
+
+void S7_Supervisor::stop()
+{
+    timer->stop();
+}
+
+// 链路正常时按检查间隔观察；中断后每次按退避时间重试
+void S7_Supervisor::onCheck()
+{
+    if (!s7->IsLinkLost()) {
+        if (recovering) {
+            // 用户已主动断开或在别处重连成功
+            recovering = false;
+            recoveringFlag = false;
+        }
+        // 有连接但长时间无通信时做一次健康检查，套接字已被对端关闭时由此发现
+        const int probe = probeMs;
+        if (probe > 0 && s7->isConnected() && s7->IdleMs() >= probe)
+            s7->CheckConnection();
+        if (!s7->IsLinkLost()) {
+            timer->start(watchMs);
+            return;
+        }
+    }
+
+    if (!recovering) {
+        recovering = true;
+        recoveringFlag = true;
+        outages++;
+        downtime.start();
+        backoff.initialMs = backoffInitialMs;
+        backoff.maximumMs = backoffMaximumMs;
+        backoff.factor = backoffFactor;
+        backoff.jitter = backoffJitter;
+        backoff.reset();
+        emit linkLost(s7->LinkError());
+        // 第一次重连立即进行，短暂中断可在一个采集周期内恢复
+    }
+
+    if (s7->RestoreLink()) {
+        const int attempts = backoff.failures + 1;
+        recovering = false;
+        recoveringFlag = false;
+        emit linkRestored(attempts, downtime.elapsed());
+        timer->start(watchMs);
+        return;
+    }
+    if (!s7->IsLinkLost()) {
+        // 重连期间用户主动断开
+        recovering = false;
+        recoveringFlag = false;
+        timer->start(watchMs);
+        return;
+    }
+
+    const int delay = backoff.next();
+    emit reconnectFailed(backoff.failures, delay);
+    timer->start(delay);
+}
@@ -0,0 +1,58 @@
+﻿#ifndef S7_SUPERVISOR_H
+#define S7_SUPERVISOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <atomic>
+#include "s7_base.h"
+#include "s7_backoff.h"
+
+// 连接监督器：监视 S7_BASE 的链路状态（操作返回的链路错误、空闲时的 Cli_GetConnected/状态查询），
+// 链路中断后按带抖动的指数退避重连。重连只恢复连接，调度器的任务、读计划与变量表保持不变，
+// 恢复后下一个到期的批次即正常采集。重连在监督器所在线程中阻塞执行，通常与调度器同一线程
+class S7_Supervisor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit S7_Supervisor(S7_BASE *s7Ptr, QObject *parent = nullptr);
+    ~S7_Supervisor();
+
+    // 以下设置在下一次检查时生效
+    void setBackoff(int initialMs, int maximumMs, double factor = 2.0, double jitter = 0.2);
+    void setWatchInterval(int ms);  // 链路状态检查间隔，默认200ms
+    void setProbeInterval(int ms);  // 空闲超过该时间时主动做健康检查，0为关闭，默认2000ms
+
+    bool isRecovering() const;
+    quint64 outageCount() const;    // 累计中断次数
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void linkLost(int errorCode);
+    void reconnectFailed(int attempt, int nextDelayMs);
+    void linkRestored(int attempts, qint64 downtimeMs);
+
+private slots:
+    void onCheck();
+
+private:
+    S7_BASE *s7;
+    QTimer *timer;
+    QElapsedTimer downtime;
+    S7_Backoff backoff;
+    bool recovering;
+
+    std::atomic<int> backoffInitialMs;
+    std::atomic<int> backoffMaximumMs;
+    std::atomic<double> backoffFactor;
+    std::atomic<double> backoffJitter;
+    std::atomic<int> watchMs;
+    std::atomic<int> probeMs;
+    std::atomic<bool> recoveringFlag;
+    std::atomic<quint64> outages;
+};
+
+#endif
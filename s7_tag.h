@@ -0,0 +1,56 @@
+﻿#ifndef S7_TAG_H
+#define S7_TAG_H
+
+#include <QtGlobal>
+
+// 支持的数据类型枚举
+enum DataType {
+    DT_Int,
+    DT_Bool,
+    DT_Float,
+    DT_String,
+    DT_Char
+};
+
+// 数据质量
+enum TagQuality {
+    QualityUndefined,   // 未定义的变量编号
+    QualityUncertain,   // 已定义，尚未读取
+    QualityGood,        // 最近一次读取成功
+    QualityBad          // 最近一次读取失败，值为最后一次成功读取的值
+};
+
+// 变量地址描述：区域 + DB号 + 偏移量 + 数据类型
+struct TagAddress {
+    int area = 0;           // 区域代码（0x81 I、0x82 Q、0x83 M、0x84 DB）
+    int dbNumber = 0;       // DB号（仅DB区域有效）
+    int startByte = 0;      // 起始字节
+    int bitOffset = 0;      // 位偏移（仅bool有效）
+    DataType dataType = DT_Int;
+    quint16 strLength = 20; // string最大长度（仅string有效）
+};
+
+// 地址键：区域、DB号、起始字节、位偏移、数据类型组合为64位，同一地址的键不变
+inline quint64 tagAddressKey(const TagAddress &tag)
+{
+    return (quint64(tag.area & 0xFF) << 56)
+           | (quint64(tag.dataType & 0x0F) << 52)
+           | (quint64(tag.bitOffset & 0x0F) << 48)
+           | (quint64(tag.dbNumber & 0xFFFF) << 32)
+           | quint64(quint32(tag.startByte));
+}
+
+// 变量在PLC中占用的字节数
+inline int tagByteSize(const TagAddress &tag)
+{
+    switch (tag.dataType) {
+    case DT_Int:    return 2;
+    case DT_Float:  return 4;
+    case DT_String: return tag.strLength + 2;  // 前两个字节为最大长度与当前长度
+    case DT_Bool:
+    case DT_Char:
+    default:        return 1;
+    }
+}
+
+#endif
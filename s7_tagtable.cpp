@@ -0,0 +1,407 @@
+﻿/******************************************************************************
+ * @file    s7_tagtable.cpp
+ * @brief   变量表，按编号索引的当前值存储
+ *
+ * @details
+ * 功能描述：
+ *    - 变量定义（名称、区域、DB号、偏移量、位、数据类型）
+ *    - 当前值、时间戳、质量按列连续存放，按页分配，页不释放、不搬移
+ *    - 采集线程直接从PLC原始字节解码写入，不分配内存
+ *    - 读取方通过序号锁获取一致的快照，O(1)
+ *    - 变化检测：bool/int/char/string 精确比较，float 支持绝对/百分比死区，可选心跳
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现变量表
+ *   2026-10-16 增加变化检测、死区与心跳
+ *   2026-10-16 增加两级脏标记位图，供界面按帧批量刷新
+ *   2026-10-16 记录失败的错误码与PLC执行耗时，错误码变化时发布
+ *   2026-10-16 float 变化检测处理 NaN，不再卡在 NaN 或每次重复发布
+ *****************************************************************************/
+
+#include "s7_tagtable.h"
+#include "s7_base.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <QtAlgorithms>
+#include <cstring>
+#include <cmath>
+
+S7_TagTable::S7_TagTable()
+{
+    for (int i = 0; i < MaxPages; ++i)
+        pages[i].store(nullptr, std::memory_order_relaxed);
+    for (int i = 0; i < MaxPages / 64; ++i)
+        dirtyPages[i].store(0, std::memory_order_relaxed);
+}
+
+S7_TagTable::~S7_TagTable()
+{
+    for (int i = 0; i < MaxPages; ++i)
+        delete pages[i].load();
+}
+
+//————————————————————————————
+// 页管理：页一经分配直到变量表销毁才释放，读取方无需加锁
+S7_TagTable::Page *S7_TagTable::page(int id) const
+{
+    if (id < 0 || id >= MaxTags)
+        return nullptr;
+    return pages[id / PageSize].load(std::memory_order_acquire);
+}
+
+S7_TagTable::Page *S7_TagTable::pageForWrite(int id)
+{
+    Page *p = pages[id / PageSize].load(std::memory_order_acquire);
+    if (!p) {
+        p = new Page;
+        std::memset(p->value, 0, sizeof(p->value));
+        std::memset(p->timestamp, 0, sizeof(p->timestamp));
+        std::memset(p->quality, QualityUndefined, sizeof(p->quality));
+        std::memset(p->dataType, 0, sizeof(p->dataType));
+        std::memset(p->bitOffset, 0, sizeof(p->bitOffset));
+        std::memset(p->textLength, 0, sizeof(p->textLength));
+        std::memset(p->strLength, 0, sizeof(p->strLength));
+        std::memset(p->deadbandMode, DeadbandNone, sizeof(p->deadbandMode));
+        std::memset(p->deadband, 0, sizeof(p->deadband));
+        std::memset(p->heartbeat, 0, sizeof(p->heartbeat));
+        for (int i = 0; i < PageSize; ++i) {
+            p->error[i] = 0;
+            p->execTime[i] = -1;
+            p->sequence[i].store(0, std::memory_order_relaxed);
+            p->readCount[i].store(0, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < PageSize / 64; ++i)
+            p->dirty[i].store(0, std::memory_order_relaxed);
+        pages[id / PageSize].store(p, std::memory_order_release);
+    }
+    return p;
+}
+
+// 序号锁：偶数 -> 奇数 获得写权限，允许多个写入方
+quint32 S7_TagTable::beginWrite(Page *p, int slot)
+{
+    quint32 seq = p->sequence[slot].load(std::memory_order_relaxed);
+    for (;;) {
+        if (!(seq & 1) && p->sequence[slot].compare_exchange_weak(seq, seq + 1, std::memory_order_acquire))
+            break;
+        QThread::yieldCurrentThread();
+        seq = p->sequence[slot].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return seq;
+}
+
+void S7_TagTable::endWrite(Page *p, int slot, quint32 seq)
+{
+    p->sequence[slot].store(seq + 2, std::memory_order_release);
+}
+
+// 未修改任何字段时恢复原序号，读取方不会感知到这次写入
+void S7_TagTable::abortWrite(Page *p, int slot, quint32 seq)
+{
+    p->sequence[slot].store(seq, std::memory_order_release);
+}
+
+//————————————————————————————
+// 变量定义
+bool S7_TagTable::defineTag(int id, const QString &name, const TagAddress &address,
+                            const TagFilter &filter)
+{
+    if (id < 0 || id >= MaxTags)
+        return false;
+
+    QMutexLocker locker(&infoMutex);
+    TagInfo &tagInfo = infos[id];
+    tagInfo.id = id;
+    tagInfo.name = name;
+    tagInfo.address = address;
+    tagInfo.filter = filter;
+
+    Page *p = pageForWrite(id);
+    const int slot = id % PageSize;
+    quint32 seq = beginWrite(p, slot);
+    p->value[slot] = 0;
+    p->timestamp[slot] = 0;
+    p->quality[slot] = QualityUncertain;
+    p->error[slot] = 0;
+    p->execTime[slot] = -1;
+    p->dataType[slot] = static_cast<quint8>(address.dataType);
+    p->bitOffset[slot] = static_cast<quint8>(address.bitOffset & 7);
+    p->strLength[slot] = qMin<quint16>(address.strLength, TextCapacity - 2);
+    p->textLength[slot] = 0;
+    p->deadbandMode[slot] = static_cast<quint8>(filter.mode);
+    p->deadband[slot] = qAbs(filter.deadband);
+    p->heartbeat[slot] = qMax(0, filter.heartbeatMs);
+    p->readCount[slot].store(0, std::memory_order_relaxed);
+    endWrite(p, slot, seq);
+    return true;
+}
+
+void S7_TagTable::removeTag(int id)
+{
+    QMutexLocker locker(&infoMutex);
+    if (!infos.remove(id))
+        return;
+
+    Page *p = page(id);
+    const int slot = id % PageSize;
+    quint32 seq = beginWrite(p, slot);
+    p->quality[slot] = QualityUndefined;
+    endWrite(p, slot, seq);
+}
+
+void S7_TagTable::clear()
+{
+    const QList<int> all = ids();
+    for (int id : all)
+        removeTag(id);
+}
+
+bool S7_TagTable::contains(int id) const
+{
+    return quality(id) != QualityUndefined;
+}
+
+TagInfo S7_TagTable::info(int id) const
+{
+    QMutexLocker locker(&infoMutex);
+    return infos.value(id);
+}
+
+QList<int> S7_TagTable::ids() const
+{
+    QMutexLocker locker(&infoMutex);
+    return infos.keys();
+}
+
+//————————————————————————————
+// 采集写入：按变量类型解码并与上次发布的值比较，未变化且未到心跳时间则放弃写入。
+// 读取失败时保留最后一次的值，仅更新质量、错误码与时间
+bool S7_TagTable::store(int id, const quint8 *data, qint64 timestampMs, int error, int execTimeMs)
+{
+    Page *p = page(id);
+    if (!p)
+        return false;
+
+    const int slot = id % PageSize;
+    quint32 seq = beginWrite(p, slot);
+    const quint8 oldQuality = p->quality[slot];
+    if (oldQuality == QualityUndefined) {
+        abortWrite(p, slot, seq);
+        return false;
+    }
+    p->readCount[slot].fetch_add(1, std::memory_order_relaxed);
+    markDirty(p, id);
+
+    const bool heartbeatDue = p->heartbeat[slot] > 0
+                              && timestampMs - p->timestamp[slot] >= p->heartbeat[slot];
+    if (!data) {
+        if (oldQuality == QualityBad && p->error[slot] == error && !heartbeatDue) {
+            abortWrite(p, slot, seq);
+            return false;
+        }
+        p->quality[slot] = QualityBad;
+        p->error[slot] = error;
+        p->timestamp[slot] = timestampMs;
+        endWrite(p, slot, seq);
+        return true;
+    }
+
+    // 质量变化（首次读取、从失败中恢复）一定发布
+    bool changed = oldQuality != QualityGood;
+    double decoded = 0;
+    int length = 0;
+    switch (p->dataType[slot]) {
+    case DT_Int:
+        decoded = S7_BASE::GetInt(data);
+        break;
+    case DT_Bool:
+        decoded = S7_BASE::GetBool(data, p->bitOffset[slot]) ? 1 : 0;
+        break;
+    case DT_Char:
+        decoded = S7_BASE::GetChar(data);
+        break;
+    case DT_Float: {
+        decoded = S7_BASE::GetFloat(data);
+        const double last = p->value[slot];
+        // 与 NaN 的比较恒为假：进入或离开 NaN 算变化，NaN 到 NaN 不算
+        if (std::isnan(last) || std::isnan(decoded)) {
+            changed = changed || std::isnan(last) != std::isnan(decoded);
+            break;
+        }
+        const double delta = std::fabs(decoded - last);
+        switch (p->deadbandMode[slot]) {
+        case DeadbandAbsolute:
+            changed = changed || delta > p->deadband[slot];
+            break;
+        case DeadbandPercent:
+            changed = changed || delta > std::fabs(last) * p->deadband[slot] / 100.0
+                      || (last == 0 && decoded != 0);
+            break;
+        default:
+            changed = changed || decoded != last;
+            break;
+        }
+        break;
+    }
+    case DT_String:
+        length = qMin<int>(data[1], p->strLength[slot]);
+        decoded = length;
+        changed = changed || length != p->textLength[slot]
+                  || std::memcmp(p->text[slot], data + 2, length) != 0;
+        break;
+    default:
+        break;
+    }
+    if (p->dataType[slot] != DT_Float && p->dataType[slot] != DT_String)
+        changed = changed || decoded != p->value[slot];
+
+    if (!changed && !heartbeatDue) {
+        abortWrite(p, slot, seq);
+        return false;
+    }
+
+    p->quality[slot] = QualityGood;
+    p->error[slot] = 0;
+    p->execTime[slot] = execTimeMs;
+    p->timestamp[slot] = timestampMs;
+    p->value[slot] = decoded;
+    if (p->dataType[slot] == DT_String) {
+        std::memcpy(p->text[slot], data + 2, length);
+        p->textLength[slot] = static_cast<quint8>(length);
+    }
+    endWrite(p, slot, seq);
+    return true;
+}
+
+//————————————————————————————
+// 脏标记：先置变量位再置页位；取出时先清页位再清变量位，不会漏掉并发写入
+void S7_TagTable::markDirty(Page *p, int id)
+{
+    const int slot = id % PageSize;
+    const int pageIndex = id / PageSize;
+    p->dirty[slot / 64].fetch_or(quint64(1) << (slot % 64), std::memory_order_release);
+    dirtyPages[pageIndex / 64].fetch_or(quint64(1) << (pageIndex % 64), std::memory_order_release);
+}
+
+void S7_TagTable::takeDirty(QVector<int> &ids)
+{
+    ids.clear();
+    for (int w = 0; w < MaxPages / 64; ++w) {
+        quint64 pageBits = dirtyPages[w].exchange(0, std::memory_order_acquire);
+        while (pageBits) {
+            const int bit = qCountTrailingZeroBits(pageBits);
+            pageBits &= pageBits - 1;
+            const int pageIndex = w * 64 + bit;
+            Page *p = pages[pageIndex].load(std::memory_order_acquire);
+            if (!p)
+                continue;
+            for (int k = 0; k < PageSize / 64; ++k) {
+                quint64 slotBits = p->dirty[k].exchange(0, std::memory_order_acquire);
+                while (slotBits) {
+                    const int slotBit = qCountTrailingZeroBits(slotBits);
+                    slotBits &= slotBits - 1;
+                    ids.append(pageIndex * PageSize + k * 64 + slotBit);
+                }
+            }
+        }
+    }
+}
+
+//————————————————————————————
+// 读取：序号为奇数或前后不一致时重读
+TagSample S7_TagTable::sample(int id) const
+{
+    TagSample result;
+    Page *p = page(id);
+    if (!p)
+        return result;
+
+    const int slot = id % PageSize;
+    for (;;) {
+        quint32 before = p->sequence[slot].load(std::memory_order_acquire);
+        if (before & 1) {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        result.value = p->value[slot];
+        result.timestamp = p->timestamp[slot];
+        result.quality = static_cast<TagQuality>(p->quality[slot]);
+        result.error = p->error[slot];
+        result.execTimeMs = p->execTime[slot];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (p->sequence[slot].load(std::memory_order_relaxed) == before) {
+            result.updates = before / 2;
+            result.reads = p->readCount[slot].load(std::memory_order_relaxed);
+            return result;
+        }
+    }
+}
+
+double S7_TagTable::value(int id) const
+{
+    return sample(id).value;
+}
+
+TagQuality S7_TagTable::quality(int id) const
+{
+    return sample(id).quality;
+}
+
+qint64 S7_TagTable::timestamp(int id) const
+{
+    return sample(id).timestamp;
+}
+
+QString S7_TagTable::text(int id) const
+{
+    Page *p = page(id);
+    if (!p)
+        return QString();
+
+    const int slot = id % PageSize;
+    char buffer[TextCapacity];
+    int length;
+    for (;;) {
+        quint32 before = p->sequence[slot].load(std::memory_order_acquire);
+        if (before & 1) {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        length = p->textLength[slot];
+        std::memcpy(buffer, p->text[slot], length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (p->sequence[slot].load(std::memory_order_relaxed) == before)
+            break;
+    }
+    return QString::fromLatin1(buffer, length);
+}
+
+QString S7_TagTable::displayValue(int id) const
+{
+    Page *p = page(id);
+    if (!p)
+        return QString();
+
+    const TagSample s = sample(id);
+    if (s.quality == QualityUndefined || s.quality == QualityUncertain)
+        return QString();
+
+    switch (p->dataType[id % PageSize]) {
+    case DT_Bool:
+        return s.value != 0 ? "TRUE" : "FALSE";
+    case DT_Float:
+        return QString::number(static_cast<float>(s.value));
+    case DT_String:
+        return text(id);
+    case DT_Char:
+        return QString(QChar::fromLatin1(static_cast<char>(s.value)));
+    case DT_Int:
+    default:
+        return QString::number(static_cast<qint64>(s.value));
+    }
+}
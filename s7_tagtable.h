@@ -0,0 +1,120 @@
+﻿#ifndef S7_TAGTABLE_H
+#define S7_TAGTABLE_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <atomic>
+#include "s7_tag.h"
+
+// 死区类型（仅float有效，其余类型始终按值精确比较）
+enum DeadbandMode {
+    DeadbandNone,       // 值不同即视为变化
+    DeadbandAbsolute,   // |新值 - 上次发布值| > 死区
+    DeadbandPercent     // |新值 - 上次发布值| > |上次发布值| * 死区%
+};
+
+// 变化过滤：未变化的读取结果不写入变量表，心跳间隔到达时强制发布一次
+struct TagFilter {
+    DeadbandMode mode = DeadbandNone;
+    double deadband = 0;
+    int heartbeatMs = 0;        // 0 表示不发送心跳
+};
+
+// 变量定义：名称 + 地址 + 变化过滤
+struct TagInfo {
+    int id = -1;
+    QString name;
+    TagAddress address;
+    TagFilter filter;
+};
+
+// 变量的一次取值快照
+struct TagSample {
+    double value = 0;           // 数值（int/bool/float/char 统一为 double）
+    qint64 timestamp = 0;       // 最近一次发布时间（毫秒，UTC）
+    TagQuality quality = QualityUndefined;
+    int error = 0;              // 质量为 QualityBad 时的 snap7 错误码
+    int execTimeMs = -1;        // 发布该值的报文的PLC执行耗时（毫秒），-1表示未知
+    quint32 updates = 0;        // 累计发布次数（值或质量变化、心跳）
+    quint32 reads = 0;          // 累计读取次数（含未变化的读取）
+};
+
+// 变量表：按整数编号索引，当前值、时间戳和质量按列连续存放（SoA），
+// 采集线程写入时不分配内存，任意线程以 O(1) 读取最新值，无需解析字符串。
+// 每个变量一个序号锁：写入期间序号为奇数，读取方发现序号变化时重读
+class S7_TagTable
+{
+public:
+    static const int PageSize = 256;            // 每页变量数
+    static const int MaxPages = 1024;
+    static const int MaxTags = PageSize * MaxPages;
+    static const int TextCapacity = 256;        // string 值缓存字节数
+
+    S7_TagTable();
+    ~S7_TagTable();
+
+    S7_TagTable(const S7_TagTable &) = delete;
+    S7_TagTable &operator=(const S7_TagTable &) = delete;
+
+    // 定义/删除变量（任意线程），重新定义会清空当前值
+    bool defineTag(int id, const QString &name, const TagAddress &address,
+                   const TagFilter &filter = TagFilter());
+    void removeTag(int id);
+    void clear();
+    bool contains(int id) const;
+    TagInfo info(int id) const;
+    QList<int> ids() const;
+
+    // 采集线程：按变量类型从PLC原始字节解码，经变化过滤后写入，data 为空表示读取失败，
+    // error 为失败的错误码，错误码变化时即使仍为 QualityBad 也会发布。返回是否发布了新值
+    bool store(int id, const quint8 *data, qint64 timestampMs, int error = 0, int execTimeMs = -1);
+
+    // 读取（任意线程）
+    TagSample sample(int id) const;
+    double value(int id) const;
+    TagQuality quality(int id) const;
+    qint64 timestamp(int id) const;
+    QString text(int id) const;                 // string 变量的当前值
+    QString displayValue(int id) const;         // 按类型格式化的当前值
+
+    // 取出自上次调用以来被读取过的变量编号并清除标记（通常由界面按帧调用）。
+    // 采集线程只置位，不分配内存；ids 先清空再追加，容量复用
+    void takeDirty(QVector<int> &ids);
+
+private:
+    struct Page {
+        double value[PageSize];
+        qint64 timestamp[PageSize];
+        quint8 quality[PageSize];
+        qint32 error[PageSize];
+        qint32 execTime[PageSize];
+        quint8 dataType[PageSize];
+        quint8 bitOffset[PageSize];
+        quint8 textLength[PageSize];
+        quint16 strLength[PageSize];
+        quint8 deadbandMode[PageSize];
+        double deadband[PageSize];
+        qint32 heartbeat[PageSize];
+        std::atomic<quint32> sequence[PageSize];
+        std::atomic<quint32> readCount[PageSize];
+        std::atomic<quint64> dirty[PageSize / 64];
+        char text[PageSize][TextCapacity];
+    };
+
+    Page *page(int id) const;
+    Page *pageForWrite(int id);
+    static quint32 beginWrite(Page *p, int slot);
+    static void endWrite(Page *p, int slot, quint32 seq);
+    static void abortWrite(Page *p, int slot, quint32 seq);
+    void markDirty(Page *p, int id);
+
+    std::atomic<Page*> pages[MaxPages];
+    std::atomic<quint64> dirtyPages[MaxPages / 64];    // 含有脏变量的页
+    mutable QMutex infoMutex;                   // 保护 infos 与页分配
+    QHash<int, TagInfo> infos;
+};
+
+#endif
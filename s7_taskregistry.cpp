@@ -0,0 +1,102 @@
+﻿/******************************************************************************
+ * @file    s7_taskregistry.cpp
+ * @brief   循环任务登记表
+ *
+ * @details
+ * 功能描述：
+ *    - 任务按编号哈希存放，查找、删除均为 O(1)
+ *    - 按地址建立哈希索引，重复任务检查为 O(1)
+ *    - 删除的编号进入最小堆空闲表，新任务优先复用最小编号
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现任务登记表，取消10个任务的上限
+ *   2026-10-16 地址键移到 s7_tag.h，与历史库共用
+ *****************************************************************************/
+
+#include "s7_taskregistry.h"
+#include <algorithm>
+#include <functional>
+
+S7_TaskRegistry::S7_TaskRegistry()
+    : nextId(1)
+{
+
+}
+
+//————————————————————————————
+// 登记与删除
+int S7_TaskRegistry::add(const TaskItem &item)
+{
+    const quint64 key = tagAddressKey(item.tag);
+    if (byAddress.contains(key))
+        return -1;
+
+    int taskId;
+    if (!freeIds.empty()) {
+        std::pop_heap(freeIds.begin(), freeIds.end(), std::greater<int>());
+        taskId = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        taskId = nextId++;
+    }
+
+    TaskItem &stored = items[taskId];
+    stored = item;
+    stored.taskId = taskId;
+    byAddress.insert(key, taskId);
+    return taskId;
+}
+
+bool S7_TaskRegistry::remove(int taskId)
+{
+    auto it = items.find(taskId);
+    if (it == items.end())
+        return false;
+
+    byAddress.remove(tagAddressKey(it->tag));
+    items.erase(it);
+    freeIds.push_back(taskId);
+    std::push_heap(freeIds.begin(), freeIds.end(), std::greater<int>());
+    return true;
+}
+
+void S7_TaskRegistry::clear()
+{
+    items.clear();
+    byAddress.clear();
+    freeIds.clear();
+    nextId = 1;
+}
+
+//————————————————————————————
+// 查找
+TaskItem *S7_TaskRegistry::find(int taskId)
+{
+    auto it = items.find(taskId);
+    return it == items.end() ? nullptr : &it.value();
+}
+
+const TaskItem *S7_TaskRegistry::find(int taskId) const
+{
+    auto it = items.constFind(taskId);
+    return it == items.constEnd() ? nullptr : &it.value();
+}
+
+int S7_TaskRegistry::findByAddress(const TagAddress &tag) const
+{
+    return byAddress.value(tagAddressKey(tag), -1);
+}
+
+int S7_TaskRegistry::size() const
+{
+    return items.size();
+}
+
+QList<int> S7_TaskRegistry::ids() const
+{
+    return items.keys();
+}
@@ -0,0 +1,49 @@
+﻿#ifndef S7_TASKREGISTRY_H
+#define S7_TASKREGISTRY_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <vector>
+#include "s7_tag.h"
+
+// 存储任务信息
+struct TaskItem {
+    int taskId;
+    TagAddress tag;       // 解析后的变量地址，用于任务重复判断
+    QString areaStr;      // 区域字符串，如"DB"
+    int dbNumber;         // DB号（仅DB区域有效）
+    QString startByteStr; // 起始地址字符串，如"18.5"
+    QString typeStr;      // 数据类型字符串，如"int"
+    int interval;         // 间隔时间（毫秒）
+    int executionCount;   // 执行次数
+    quint32 lastUpdates;  // 上次刷新时变量表中的发布次数
+    quint32 lastReads;    // 上次刷新时变量表中的读取次数
+};
+
+// 任务登记表：按编号和按地址哈希查找，任务数量不设上限。
+// 删除的编号进入空闲表，新任务优先复用最小的空闲编号
+class S7_TaskRegistry
+{
+public:
+    S7_TaskRegistry();
+
+    // 分配编号并登记，地址与已有任务重复时返回 -1
+    int add(const TaskItem &item);
+    bool remove(int taskId);
+    void clear();                       // 清空后编号从1开始
+
+    TaskItem *find(int taskId);
+    const TaskItem *find(int taskId) const;
+    int findByAddress(const TagAddress &tag) const;    // 未找到返回 -1
+    int size() const;
+    QList<int> ids() const;
+
+private:
+    QHash<int, TaskItem> items;
+    QHash<quint64, int> byAddress;      // 地址键（tagAddressKey）-> 编号
+    std::vector<int> freeIds;           // 最小堆
+    int nextId;
+};
+
+#endif
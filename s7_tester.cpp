@@ -18,6 +18,26 @@
  * - 修改记录：
  *   2025-4-10 实现基础功能 V1.0
  *   2025-4-12 增加停止plc后自动清除所有任务 V1.0.1
+ *   2026-10-16 循环任务改为统一调度器批量执行
+ *   2026-10-16 手动读写改为异步请求，界面线程不再阻塞
+ *   2026-10-16 增加连接类型与多会话连接池
+ *   2026-10-16 循环任务结果写入变量表
+ *   2026-10-16 任务结果改为按批次从变量表读取，显示时才格式化
+ *   2026-10-16 循环任务支持死区与心跳，仅变化的值写入任务日志
+ *   2026-10-16 任务日志改为有界环形缓冲模型 + 列表视图，限频刷新
+ *   2026-10-16 任务结果按帧（约30Hz）批量刷新，按任务编号哈希定位
+ *   2026-10-16 增加变量监视表，只重绘变化的单元格
+ *   2026-10-16 任务改由登记表管理，取消10个任务的上限
+ *   2026-10-16 循环任务可记录历史数据
+ *   2026-10-16 增加历史数据导出
+ *   2026-10-16 增加实时趋势图
+ *   2026-10-16 增加本机仿真PLC
+ *   2026-10-16 增加通信统计面板与JSON导出
+ *   2026-10-16 掉线后自动重连，任务保持不变
+ *   2026-10-16 批次统计显示退避的变量数与错误码
+ *   2026-10-16 增加配方页：整个DB上传、按布局编辑、比较后只下载变化的区间
+ *   2026-10-16 手动写入改经主连接以手动优先级排队，排在循环读取之前；手动读取仍走异步会话
+ *   2026-10-16 导出历史按任务地址查找序列编号，不再按任务编号
  *
  *         .--,       .--,
  *       ( (  \.---./  ) )
@@ -45,76 +65,19 @@
 #include <QRegularExpression>
 #include <QRegularExpressionValidator>
 #include <QLabel>
+#include <QScrollBar>
+#include <QTabWidget>
+#include <QHeaderView>
+#include <QCoreApplication>
+#include <QFileDialog>
+#include <QFile>
+#include <QElapsedTimer>
+#include <memory>
+#include "s7_histquery.h"
 
 // 设置中文编码，防止乱码
 #pragma execution_character_set("utf-8")
 
-//==========================================================
-// TaskWorker子线程循环读实现
-//==========================================================
-TaskWorker::TaskWorker(int taskId, S7_BASE *s7Ptr, int areaCode, int dbNumber, int startByte, int bitOffset,
-                       DataType dt, int interval, QObject *parent)
-    : QObject(parent),
-    m_taskId(taskId),
-    s7(s7Ptr),
-    area(areaCode),
-    dbNum(dbNumber),
-    startAddr(startByte),
-    bitOffset(bitOffset),
-    dataType(dt),
-    intervalMs(interval)
-{
-    timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &TaskWorker::doRead);
-}
-
-TaskWorker::~TaskWorker()
-{
-
-}
-//启动线程
-void TaskWorker::start()
-{
-    timer->start(intervalMs);
-}
-//停止线程
-void TaskWorker::stop()
-{
-    timer->stop();
-    emit finished();
-}
-
-//线程工作
-void TaskWorker::doRead()
-{
-    QString result;
-    switch (dataType) {
-    case DT_Int:
-        result = QString("Int类型-偏移量:%1  获取值：%2").arg(startAddr).arg(s7->ReadInt(area, dbNum, startAddr));
-        break;
-    case DT_Bool: {
-        bool b = s7->ReadBool(area, dbNum, startAddr, bitOffset);
-        result = QString("Bool类型-偏移量:%1.%2  获取值：%3").arg(startAddr).arg(bitOffset).arg(b ? "TRUE" : "FALSE");
-        break;
-    }
-    case DT_Float:
-        result = QString("Float类型-偏移量:%1  获取值：%2").arg(startAddr).arg(s7->ReadFloat(area, dbNum, startAddr));
-        break;
-    case DT_String:
-        result = QString("String类型-偏移量:%1  获取值：%2").arg(startAddr).arg(s7->ReadString(area, dbNum, startAddr, 20));
-        break;
-    case DT_Char: {
-        char ch = s7->ReadChar(area, dbNum, startAddr);
-        result = QString("Char类型-偏移量:%1  获取值：%2").arg(startAddr).arg(ch);
-        break;
-    }
-    default:
-        result = "未知数据类型";
-        break;
-    }
-    emit newData(m_taskId, result);
-}
-
 //==========================================================
 // S7_Tester 实现
 //==========================================================
@@ -122,32 +85,94 @@ S7_Tester::S7_Tester(QWidget *parent)
     : QMainWindow(parent),
     s7(new S7_BASE),
     infoLogCount(0),
-    taskLogCount(0)
+    taskLogFollow(true),
+    lastTickIndex(0),
+    recipeTableUpdating(false)
 {
     createUI();
     setWindowTitle(tr("S7助手_V1.0_by_Magic"));
 
-    // 初始化可用任务编号为1到10
-    for (int i = 1; i <= 10; ++i) {
-        availableTaskIds.append(i);
-    }
+    // 所有循环任务共用一个调度器线程
+    tagTable = new S7_TagTable;
+    scheduler = new S7_Scheduler(s7);
+    scheduler->setTagTable(tagTable);
+    historian = new S7_Historian;
+    simulator = new S7_Simulator;
+    recipe = new S7_Recipe;
+    recipeWorker = nullptr;
+    onRecipeLayoutChanged();
+    watchModel = new S7_WatchModel(tagTable, this);
+    watchView->setModel(watchModel);
+    trendBuffer = new S7_TrendBuffer;
+    scheduler->setTrendBuffer(trendBuffer);
+    trendView->setSource(trendBuffer);
+    schedulerThread = new QThread;
+    scheduler->moveToThread(schedulerThread);
+    connect(schedulerThread, &QThread::started, scheduler, &S7_Scheduler::start);
+
+    // 连接监督器与调度器同一线程：重连期间没有可执行的采集，恢复后下一批次即正常读取
+    supervisor = new S7_Supervisor(s7);
+    supervisor->moveToThread(schedulerThread);
+    connect(schedulerThread, &QThread::started, supervisor, &S7_Supervisor::start);
+    connect(supervisor, &S7_Supervisor::linkLost, this, &S7_Tester::onLinkLost);
+    connect(supervisor, &S7_Supervisor::reconnectFailed, this, &S7_Tester::onReconnectFailed);
+    connect(supervisor, &S7_Supervisor::linkRestored, this, &S7_Tester::onLinkRestored);
+    schedulerThread->start();
+
+    // 采集结果在变量表中累积，界面按帧批量刷新，开销与采集频率无关
+    frameTimer = new QTimer(this);
+    frameTimer->setInterval(33);
+    connect(frameTimer, &QTimer::timeout, this, &S7_Tester::onFrame);
+    frameTimer->start();
+
+    // 通信统计按秒刷新
+    metricsBase = S7_Metrics::snapshot();
+    metricsLast = metricsBase;
+    metricsTimer = new QTimer(this);
+    metricsTimer->setInterval(1000);
+    connect(metricsTimer, &QTimer::timeout, this, &S7_Tester::onMetricsTimer);
+    metricsTimer->start();
+
+    // 手动读写使用独立的异步会话
+    asyncClient = new S7_AsyncClient(this);
+    connect(asyncClient, &S7_AsyncClient::queueDepthChanged, this, &S7_Tester::onAsyncStatsChanged);
+    connect(asyncClient, &S7_AsyncClient::finished, this, &S7_Tester::onAsyncStatsChanged);
+
+    pool = new S7_ConnectionPool(this);
+    connect(pool, &S7_ConnectionPool::sessionStateChanged, this, &S7_Tester::onPoolSessionChanged);
 }
 
 S7_Tester::~S7_Tester()
 {
-    // 停止并清理所有循环读任务
-    for (auto &item : taskList) {
-        if (item.worker)
-            item.worker->stop();
-        if (item.thread) {
-            item.thread->quit();
-            item.thread->wait();
-            delete item.thread;
-        }
-    }
+    // 等待进行中的配方传输结束，它使用主连接
+    if (recipeWorker)
+        recipeWorker->wait();
+    // 停止调度器线程
+    QMetaObject::invokeMethod(supervisor, "stop", Qt::BlockingQueuedConnection);
+    QMetaObject::invokeMethod(scheduler, "stop", Qt::BlockingQueuedConnection);
+    schedulerThread->quit();
+    schedulerThread->wait();
+    delete supervisor;
+    delete scheduler;
+    delete schedulerThread;
+    delete historian;
+    delete simulator;
+    delete recipe;
+    delete trendBuffer;
+    delete tagTable;
     delete s7;
 }
 
+// 配方布局示例：仿真PLC的 DB1.DBB100 之后未被值发生器占用
+static const char *const RecipeLayout =
+    "# <偏移>[.<位>] <类型> [名称]，类型为 int/float/bool/char/string[长度]\n"
+    "100 int 速度设定\n"
+    "102 float 温度设定\n"
+    "106.0 bool 启用加热\n"
+    "106.1 bool 启用搅拌\n"
+    "107 char 等级\n"
+    "108 string[20] 批次号\n";
+
 void S7_Tester::createUI()
 {
     QWidget *centralWidget = new QWidget(this);
@@ -171,6 +196,14 @@ void S7_Tester::createUI()
     editSlot->setPlaceholderText(tr("插槽"));
     editSlot->setText("1");
     editSlot->setValidator(new QIntValidator(0, 100, this));
+    comboConnType = new QComboBox;
+    comboConnType->addItem("PG", CONNTYPE_PG);
+    comboConnType->addItem("OP", CONNTYPE_OP);
+    comboConnType->addItem(tr("S7基本"), CONNTYPE_BASIC);
+    editSessions = new QLineEdit;
+    editSessions->setPlaceholderText(tr("会话数"));
+    editSessions->setText("1");
+    editSessions->setValidator(new QIntValidator(1, 16, this));
     btnConnect = new QPushButton(tr("连接"));
     btnDisconnect = new QPushButton(tr("断开"));
     layoutConn->addWidget(new QLabel(tr("IP:")));
@@ -179,10 +212,41 @@ void S7_Tester::createUI()
     layoutConn->addWidget(editRack);
     layoutConn->addWidget(new QLabel(tr("Slot:")));
     layoutConn->addWidget(editSlot);
+    layoutConn->addWidget(comboConnType);
+    layoutConn->addWidget(new QLabel(tr("会话:")));
+    layoutConn->addWidget(editSessions);
     layoutConn->addWidget(btnConnect);
     layoutConn->addWidget(btnDisconnect);
     grpConnection->setLayout(layoutConn);
 
+    // =========仿真PLC=========
+    QGroupBox *grpSimulator = new QGroupBox(tr("仿真PLC"));
+    QHBoxLayout *layoutSim = new QHBoxLayout;
+    checkSimulator = new QCheckBox(tr("本机仿真PLC"));
+    checkSimulator->setToolTip(tr("在127.0.0.1启动仿真PLC（DB1、M/I/Q区，带值发生器）"));
+    spinSimLatency = new QSpinBox;
+    spinSimLatency->setRange(0, 5000);
+    spinSimLatency->setPrefix(tr("延迟: "));
+    spinSimLatency->setSuffix(" ms");
+    spinSimJitter = new QSpinBox;
+    spinSimJitter->setRange(0, 5000);
+    spinSimJitter->setPrefix(tr("抖动: "));
+    spinSimJitter->setSuffix(" ms");
+    spinSimErrorRate = new QSpinBox;
+    spinSimErrorRate->setRange(0, 100);
+    spinSimErrorRate->setPrefix(tr("错误率: "));
+    spinSimErrorRate->setSuffix("%");
+    btnSimDrop = new QPushButton(tr("断开所有连接"));
+    btnSimDrop->setEnabled(false);
+    labelSimStats = new QLabel;
+    layoutSim->addWidget(checkSimulator);
+    layoutSim->addWidget(spinSimLatency);
+    layoutSim->addWidget(spinSimJitter);
+    layoutSim->addWidget(spinSimErrorRate);
+    layoutSim->addWidget(btnSimDrop);
+    layoutSim->addWidget(labelSimStats, 1);
+    grpSimulator->setLayout(layoutSim);
+
     // =========区域参数设置=========
     QGroupBox *grpArea = new QGroupBox(tr("区域参数设置"));
     QHBoxLayout *layoutArea = new QHBoxLayout;
@@ -273,6 +337,7 @@ void S7_Tester::createUI()
 
     // 将原有各组控件依次加入左侧布局
     leftLayout->addWidget(grpConnection);
+    leftLayout->addWidget(grpSimulator);
     leftLayout->addWidget(grpArea);
     leftLayout->addWidget(grpString);
     leftLayout->addWidget(grpInt);
@@ -280,6 +345,9 @@ void S7_Tester::createUI()
     leftLayout->addWidget(grpChar);
     leftLayout->addWidget(grpFloat);
 
+    labelAsyncStats = new QLabel(tr("异步队列:0"));
+    leftLayout->addWidget(labelAsyncStats);
+
     // =========循环读任务控件=========
     QGroupBox *grpTask = new QGroupBox(tr("循环任务设定"));
     QVBoxLayout *layoutTask = new QVBoxLayout;
@@ -311,6 +379,14 @@ void S7_Tester::createUI()
     editTaskInterval = new QLineEdit;
     editTaskInterval->setPlaceholderText(tr("间隔(ms)"));
     editTaskInterval->setValidator(new QIntValidator(1, 100000, this));
+    editTaskDeadband = new QLineEdit;
+    editTaskDeadband->setPlaceholderText(tr("死区（如0.5或2%）"));
+    editTaskDeadband->setToolTip(tr("仅float有效，其余类型值变化即输出"));
+    editTaskDeadband->setValidator(new QRegularExpressionValidator(QRegularExpression("^\\d*\\.?\\d*%?$"), this));
+    editTaskHeartbeat = new QLineEdit;
+    editTaskHeartbeat->setPlaceholderText(tr("心跳(ms)"));
+    editTaskHeartbeat->setToolTip(tr("值未变化时也按此间隔输出，空或0为关闭"));
+    editTaskHeartbeat->setValidator(new QIntValidator(0, 3600000, this));
     layoutTaskConfig->addWidget(new QLabel(tr("区域:")));
     layoutTaskConfig->addWidget(comboTaskArea);
     layoutTaskConfig->addWidget(new QLabel(tr("DB号:")));
@@ -319,6 +395,8 @@ void S7_Tester::createUI()
     layoutTaskConfig->addWidget(new QLabel(tr("数据类型:")));
     layoutTaskConfig->addWidget(comboTaskDataType);
     layoutTaskConfig->addWidget(editTaskInterval);
+    layoutTaskConfig->addWidget(editTaskDeadband);
+    layoutTaskConfig->addWidget(editTaskHeartbeat);
 
     // 下排操作按钮和任务列表
     QHBoxLayout *layoutTaskOp = new QHBoxLayout;
@@ -330,9 +408,107 @@ void S7_Tester::createUI()
     listTask = new QListWidget;
     listTask->setSelectionMode(QAbstractItemView::SingleSelection);
 
+    // 变量监视表：直接显示变量表中的当前值，模型在构造函数中创建后设置
+    watchView = new QTableView;
+    watchView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    watchView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    watchView->verticalHeader()->setVisible(false);
+    watchView->verticalHeader()->setDefaultSectionSize(20);
+    watchView->horizontalHeader()->setStretchLastSection(true);
+
+    // 趋势图：数据通道在构造函数中创建后设置
+    trendView = new S7_TrendWidget;
+
+    // 通信统计：排队/本地耗时与PLC执行耗时分开统计，区分延迟来源
+    QWidget *metricsPage = new QWidget;
+    QVBoxLayout *layoutMetrics = new QVBoxLayout;
+    tableMetrics = new QTableWidget(S7_Metrics::OpCount, 10);
+    tableMetrics->setHorizontalHeaderLabels({tr("操作"), tr("次数"), tr("次/s"), tr("错误"), tr("最近错误"),
+                                             tr("字节"), tr("报文"), tr("排队 p50/p99(us)"),
+                                             tr("耗时 p50/p99(us)"), tr("PLC p50/p99(ms)")});
+    tableMetrics->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    tableMetrics->verticalHeader()->setVisible(false);
+    tableMetrics->verticalHeader()->setDefaultSectionSize(20);
+    tableMetrics->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    for (int row = 0; row < S7_Metrics::OpCount; ++row) {
+        tableMetrics->setItem(row, 0, new QTableWidgetItem(S7_Metrics::opName(S7_Metrics::Op(row))));
+        for (int col = 1; col < tableMetrics->columnCount(); ++col) {
+            QTableWidgetItem *cell = new QTableWidgetItem;
+            cell->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            tableMetrics->setItem(row, col, cell);
+        }
+    }
+    btnMetricsReset = new QPushButton(tr("清零"));
+    btnMetricsExport = new QPushButton(tr("导出JSON"));
+    QHBoxLayout *layoutMetricsOp = new QHBoxLayout;
+    layoutMetricsOp->addStretch();
+    layoutMetricsOp->addWidget(btnMetricsReset);
+    layoutMetricsOp->addWidget(btnMetricsExport);
+    layoutMetrics->addWidget(tableMetrics);
+    layoutMetrics->addLayout(layoutMetricsOp);
+    metricsPage->setLayout(layoutMetrics);
+
+    // 配方：整个DB一次上传，按布局编辑后与PLC当前映像比较，只下载变化的区间
+    QWidget *recipePage = new QWidget;
+    QVBoxLayout *layoutRecipe = new QVBoxLayout;
+    spinRecipeDb = new QSpinBox;
+    spinRecipeDb->setRange(1, 65535);
+    spinRecipeDb->setValue(1);
+    spinRecipeSize = new QSpinBox;
+    spinRecipeSize->setRange(0, 65535);
+    spinRecipeSize->setValue(1000);
+    spinRecipeSize->setSpecialValueText(tr("自动"));
+    spinRecipeSize->setToolTip(tr("DB长度（字节），自动时使用块信息查询，优化访问的DB需手动指定"));
+    btnRecipeUpload = new QPushButton(tr("上传"));
+    btnRecipeDownload = new QPushButton(tr("下载"));
+    btnRecipeLoad = new QPushButton(tr("打开"));
+    btnRecipeSave = new QPushButton(tr("保存"));
+    QHBoxLayout *layoutRecipeOp = new QHBoxLayout;
+    layoutRecipeOp->addWidget(new QLabel(tr("DB")));
+    layoutRecipeOp->addWidget(spinRecipeDb);
+    layoutRecipeOp->addWidget(new QLabel(tr("长度")));
+    layoutRecipeOp->addWidget(spinRecipeSize);
+    layoutRecipeOp->addStretch();
+    layoutRecipeOp->addWidget(btnRecipeUpload);
+    layoutRecipeOp->addWidget(btnRecipeDownload);
+    layoutRecipeOp->addWidget(btnRecipeLoad);
+    layoutRecipeOp->addWidget(btnRecipeSave);
+    editRecipeLayout = new QTextEdit;
+    editRecipeLayout->setAcceptRichText(false);
+    editRecipeLayout->setPlainText(RecipeLayout);
+    editRecipeLayout->setMaximumHeight(90);
+    tableRecipe = new QTableWidget(0, 5);
+    tableRecipe->setHorizontalHeaderLabels({tr("名称"), tr("地址"), tr("类型"), tr("PLC值"), tr("设定值")});
+    tableRecipe->verticalHeader()->setVisible(false);
+    tableRecipe->verticalHeader()->setDefaultSectionSize(20);
+    tableRecipe->horizontalHeader()->setStretchLastSection(true);
+    labelRecipeStats = new QLabel(tr("配方：未上传"));
+    layoutRecipe->addLayout(layoutRecipeOp);
+    layoutRecipe->addWidget(editRecipeLayout);
+    layoutRecipe->addWidget(tableRecipe);
+    layoutRecipe->addWidget(labelRecipeStats);
+    recipePage->setLayout(layoutRecipe);
+
+    QTabWidget *tabTask = new QTabWidget;
+    tabTask->addTab(listTask, tr("任务列表"));
+    tabTask->addTab(watchView, tr("变量监视"));
+    tabTask->addTab(trendView, tr("趋势"));
+    tabTask->addTab(metricsPage, tr("通信统计"));
+    tabTask->addTab(recipePage, tr("配方"));
+
+    labelTickStats = new QLabel(tr("批次统计：无"));
+    checkHistory = new QCheckBox(tr("记录历史数据"));
+    btnExportHistory = new QPushButton(tr("导出历史"));
+
+    QHBoxLayout *layoutTaskStats = new QHBoxLayout;
+    layoutTaskStats->addWidget(labelTickStats, 1);
+    layoutTaskStats->addWidget(checkHistory);
+    layoutTaskStats->addWidget(btnExportHistory);
+
     layoutTask->addLayout(layoutTaskConfig);
     layoutTask->addLayout(layoutTaskOp);
-    layoutTask->addWidget(listTask);
+    layoutTask->addWidget(tabTask);
+    layoutTask->addLayout(layoutTaskStats);
     grpTask->setLayout(layoutTask);
 
     leftLayout->addWidget(grpTask);
@@ -369,12 +545,23 @@ void S7_Tester::createUI()
     taskHeaderLayout->addStretch();
     grpTaskLog->setContentsMargins(10, -100, 10, 10);
     taskCountLabel = new QLabel(tr("总数: 0"));
+    spinTaskLogCapacity = new QSpinBox;
+    spinTaskLogCapacity->setRange(100, 100000);
+    spinTaskLogCapacity->setSingleStep(1000);
+    spinTaskLogCapacity->setValue(5000);
+    spinTaskLogCapacity->setPrefix(tr("保留: "));
     btnClearTaskLog = new QPushButton(tr("清空"));
     taskHeaderLayout->addWidget(taskCountLabel);
+    taskHeaderLayout->addWidget(spinTaskLogCapacity);
     taskHeaderLayout->addWidget(btnClearTaskLog);
 
-    taskLog = new QTextEdit;
-    taskLog->setReadOnly(true);
+    // 任务日志使用环形缓冲模型，内存固定，只绘制可见行
+    taskLogModel = new S7_LogModel(spinTaskLogCapacity->value(), this);
+    taskLog = new QListView;
+    taskLog->setModel(taskLogModel);
+    taskLog->setUniformItemSizes(true);
+    taskLog->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    taskLog->setSelectionMode(QAbstractItemView::ExtendedSelection);
     layoutTaskLog->addLayout(taskHeaderLayout);
     layoutTaskLog->addWidget(taskLog);
     grpTaskLog->setLayout(layoutTaskLog);
@@ -409,14 +596,51 @@ void S7_Tester::createUI()
     connect(btnWriteFloat, &QPushButton::clicked, this, &S7_Tester::onWriteFloatClicked);
     connect(comboArea, &QComboBox::currentTextChanged, this, &S7_Tester::onAreaChanged);
 
+    // 仿真PLC
+    connect(checkSimulator, &QCheckBox::toggled, this, &S7_Tester::onSimulatorToggled);
+    connect(spinSimLatency, QOverload<int>::of(&QSpinBox::valueChanged), this, &S7_Tester::onSimulatorSettingsChanged);
+    connect(spinSimJitter, QOverload<int>::of(&QSpinBox::valueChanged), this, &S7_Tester::onSimulatorSettingsChanged);
+    connect(spinSimErrorRate, QOverload<int>::of(&QSpinBox::valueChanged), this, &S7_Tester::onSimulatorSettingsChanged);
+    connect(btnSimDrop, &QPushButton::clicked, this, &S7_Tester::onSimulatorDropClicked);
+
     // 任务相关信号连接
     connect(btnAddTask, &QPushButton::clicked, this, &S7_Tester::onAddTaskClicked);
     connect(btnStopTask, &QPushButton::clicked, this, &S7_Tester::onStopTaskClicked);
     connect(comboTaskArea, &QComboBox::currentTextChanged, this, &S7_Tester::onTaskAreaChanged);
+    connect(checkHistory, &QCheckBox::toggled, this, &S7_Tester::onHistoryToggled);
+    connect(btnExportHistory, &QPushButton::clicked, this, &S7_Tester::onExportHistoryClicked);
+    connect(btnMetricsReset, &QPushButton::clicked, this, &S7_Tester::onMetricsResetClicked);
+    connect(btnMetricsExport, &QPushButton::clicked, this, &S7_Tester::onMetricsExportClicked);
+    connect(btnRecipeUpload, &QPushButton::clicked, this, &S7_Tester::onRecipeUploadClicked);
+    connect(btnRecipeDownload, &QPushButton::clicked, this, &S7_Tester::onRecipeDownloadClicked);
+    connect(btnRecipeLoad, &QPushButton::clicked, this, &S7_Tester::onRecipeLoadClicked);
+    connect(btnRecipeSave, &QPushButton::clicked, this, &S7_Tester::onRecipeSaveClicked);
+    connect(editRecipeLayout, &QTextEdit::textChanged, this, &S7_Tester::onRecipeLayoutChanged);
+    connect(tableRecipe, &QTableWidget::cellChanged, this, &S7_Tester::onRecipeCellChanged);
 
     // 连接清空按钮信号槽
     connect(btnClearInfoLog, &QPushButton::clicked, this, &S7_Tester::onClearInfoLogClicked);
     connect(btnClearTaskLog, &QPushButton::clicked, this, &S7_Tester::onClearTaskLogClicked);
+
+    // 任务日志：计数、保留条数、滚动条在底部时跟随最新日志
+    connect(taskLogModel, &S7_LogModel::totalCountChanged, this, &S7_Tester::onTaskLogCountChanged);
+    connect(spinTaskLogCapacity, QOverload<int>::of(&QSpinBox::valueChanged),
+            taskLogModel, &S7_LogModel::setCapacity);
+    connect(taskLogModel, &QAbstractItemModel::rowsAboutToBeInserted, this, [this]() {
+        QScrollBar *bar = taskLog->verticalScrollBar();
+        taskLogFollow = bar->value() >= bar->maximum();
+    });
+    connect(taskLogModel, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if (taskLogFollow)
+            taskLog->scrollToBottom();
+    });
+}
+
+//————————————————————————————
+// 异步结果缓冲区转为字节指针
+static const quint8 *rawData(const QByteArray &data)
+{
+    return reinterpret_cast<const quint8*>(data.constData());
 }
 
 //————————————————————————————
@@ -454,18 +678,364 @@ void S7_Tester::logMessage(const QString &msg, LogType type) {
 
 //————————————————————————————
 // 任务日志输出函数：追加日志并加时间前缀
+// 日志先进入模型的待提交队列，按固定间隔批量刷新到视图
 void S7_Tester::TaskMessage(const QString &msg, LogType type) {
-    taskLogCount++; // 增加计数
-    taskCountLabel->setText(tr("总数: %1").arg(taskLogCount));
-    QString color;
+    QColor color;
     switch(type) {
-    case Success: color = "#009900"; break;  // 绿色
-    default: color = "#666666";              // 灰色
+    case Success: color = QColor("#009900"); break;  // 绿色
+    default: color = QColor("#666666");              // 灰色
     }
+    taskLogModel->append(msg, color);
+}
 
-    QString timeStr = QDateTime::currentDateTime().toString("HH:mm:ss");
-    taskLog->append(QString("<span style='color:%1'>[%2]%3</span> ")
-                        .arg(color).arg(timeStr).arg(msg));
+void S7_Tester::onTaskLogCountChanged(quint64 total)
+{
+    taskCountLabel->setText(tr("总数: %1").arg(total));
+}
+
+//————————————————————————————
+// 历史数据目录（程序目录下 history）
+static QString historyPath()
+{
+    return QCoreApplication::applicationDirPath() + "/history";
+}
+
+// 历史记录：先停止写入再关闭，关闭时未满的块会写盘
+void S7_Tester::onHistoryToggled(bool checked)
+{
+    if (!checked) {
+        scheduler->setHistorian(nullptr);
+        historian->close();
+        logMessage(tr("【提示】已停止记录历史数据"), Info);
+        return;
+    }
+
+    const QString dir = historyPath();
+    if (!historian->open(dir)) {
+        logMessage(tr("【错误】无法创建历史数据目录：%1").arg(dir), Error);
+        checkHistory->setChecked(false);
+        return;
+    }
+    scheduler->setHistorian(historian);
+    logMessage(tr("【提示】开始记录历史数据：%1").arg(dir), Info);
+}
+
+// 导出只包含已写盘的数据；文件后缀为 .s7col 时导出列式文件
+void S7_Tester::onExportHistoryClicked()
+{
+    const QList<int> ids = tasks.ids();
+    if (ids.isEmpty()) {
+        logMessage(tr("【提示】没有循环任务，无历史数据可导出"), Warning);
+        return;
+    }
+    const QString path = QFileDialog::getSaveFileName(this, tr("导出历史数据"), historyPath(),
+                                                      tr("CSV 文件 (*.csv);;列式文件 (*.s7col)"));
+    if (path.isEmpty())
+        return;
+
+    const qint64 to = QDateTime::currentMSecsSinceEpoch();
+    const qint64 from = to - 24LL * 3600 * 1000;
+    QElapsedTimer timer;
+    timer.start();
+    // 历史按变量地址记录：按当前任务的地址查找序列编号，任务编号被复用过也不会混入其他地址的数据
+    S7_HistQuery query(historyPath());
+    QVector<int> tagIds;
+    for (int id : ids) {
+        const TaskItem *task = tasks.find(id);
+        const int series = task ? query.seriesOf(task->tag) : -1;
+        if (series > 0)
+            tagIds.append(series);
+    }
+    if (tagIds.isEmpty()) {
+        logMessage(tr("【提示】当前循环任务的地址没有历史数据"), Warning);
+        return;
+    }
+    const bool ok = path.endsWith(".s7col", Qt::CaseInsensitive)
+                        ? query.exportColumnar(path, tagIds, from, to)
+                        : query.exportCsv(path, tagIds, from, to);
+    if (!ok) {
+        logMessage(tr("【错误】导出历史数据失败：%1").arg(query.errorString()), Error);
+        return;
+    }
+    logMessage(tr("【成功】已导出 %1 个变量（tag 列为历史序列编号）、%2 个数据点，耗时 %3 ms：%4")
+                   .arg(tagIds.size()).arg(query.pointsDecoded()).arg(timer.elapsed()).arg(path), Success);
+}
+
+//————————————————————————————
+// 仿真PLC：DB1（1000字节）与 M/I/Q 区，发生器覆盖各数据类型，便于无硬件时测试循环任务
+static const char *const SimulatorScript =
+    "DB1.0 int ramp min=0 max=1000 period=10000\n"
+    "DB1.2 float sine amp=50 offset=50 period=5000\n"
+    "DB1.6.0 bool square period=1000\n"
+    "DB1.6.1 bool square period=3000\n"
+    "DB1.7 char random min=65 max=90 period=1000\n"
+    "DB1.8 float random min=20 max=25 period=1000\n"
+    "DB1.12 int counter step=1 period=100\n"
+    "DB1.14 string counter step=1 period=1000 len=20\n"
+    "M0.0 bool square period=500\n"
+    "I0 int sine amp=100 offset=0 period=2000\n";
+
+void S7_Tester::onSimulatorToggled(bool checked)
+{
+    btnSimDrop->setEnabled(checked);
+    if (!checked) {
+        simulator->stop();
+        labelSimStats->clear();
+        logMessage(tr("【提示】仿真PLC已停止"), Info);
+        return;
+    }
+
+    if (!simulator->isRunning()) {
+        QString error;
+        simulator->clearGenerators();
+        simulator->addDb(1, 1000);
+        if (!simulator->loadScript(SimulatorScript, &error))
+            logMessage(tr("【错误】仿真脚本错误：%1").arg(error), Error);
+    }
+    onSimulatorSettingsChanged();
+    if (!simulator->start("127.0.0.1")) {
+        logMessage(tr("【错误】仿真PLC启动失败：%1（102端口被占用或无权限）").arg(simulator->errorString()), Error);
+        checkSimulator->setChecked(false);
+        return;
+    }
+    editIp->setText("127.0.0.1");
+    editRack->setText("0");
+    editSlot->setText("1");
+    logMessage(tr("【成功】仿真PLC已启动：127.0.0.1，DB1.DBB0~35、M0.0、IW0 为变化的数据"), Success);
+}
+
+void S7_Tester::onSimulatorSettingsChanged()
+{
+    simulator->setLatency(spinSimLatency->value(), spinSimJitter->value());
+    simulator->setErrorRate(spinSimErrorRate->value() / 100.0);
+}
+
+void S7_Tester::onSimulatorDropClicked()
+{
+    simulator->dropConnections();
+    logMessage(tr("【提示】仿真PLC已断开所有连接"), Warning);
+}
+
+//————————————————————————————
+// 通信统计
+void S7_Tester::onMetricsTimer()
+{
+    const S7_Metrics::Snapshot now = S7_Metrics::snapshot();
+    const S7_Metrics::Snapshot shown = now.since(metricsBase);
+    const double seconds = qMax<qint64>(1, now.timestampMs - metricsLast.timestampMs) / 1000.0;
+    auto pair = [](const S7_Histogram &h, double scale) {
+        const int decimals = scale > 1 ? 1 : 0;
+        return h.total ? QString("%1 / %2").arg(h.percentile(0.5) / scale, 0, 'f', decimals)
+                                           .arg(h.percentile(0.99) / scale, 0, 'f', decimals)
+                       : QString("-");
+    };
+
+    for (int row = 0; row < S7_Metrics::OpCount; ++row) {
+        const S7_Metrics::OpStats &stats = shown.ops[row];
+        const quint64 recent = now.ops[row].count - metricsLast.ops[row].count;
+        tableMetrics->item(row, 1)->setText(QString::number(stats.count));
+        tableMetrics->item(row, 2)->setText(QString::number(recent / seconds, 'f', 1));
+        tableMetrics->item(row, 3)->setText(QString::number(stats.errors));
+        tableMetrics->item(row, 4)->setText(stats.lastError ? QString("0x%1").arg(stats.lastError, 0, 16) : QString());
+        tableMetrics->item(row, 4)->setToolTip(stats.lastError ? S7_BASE::ErrorText(stats.lastError) : QString());
+        tableMetrics->item(row, 5)->setText(QString::number(stats.bytes));
+        tableMetrics->item(row, 6)->setText(QString::number(stats.pdus));
+        tableMetrics->item(row, 7)->setText(pair(stats.queueWait, 1));
+        tableMetrics->item(row, 8)->setText(pair(stats.service, 1));
+        tableMetrics->item(row, 9)->setText(pair(stats.plcExec, 1000));
+    }
+    metricsLast = now;
+}
+
+void S7_Tester::onMetricsResetClicked()
+{
+    metricsBase = S7_Metrics::snapshot();
+    metricsLast = metricsBase;
+    onMetricsTimer();
+}
+
+void S7_Tester::onMetricsExportClicked()
+{
+    const QString path = QFileDialog::getSaveFileName(this, tr("导出通信统计"), QString(),
+                                                      tr("JSON 文件 (*.json)"));
+    if (path.isEmpty())
+        return;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        logMessage(tr("【错误】无法写入文件：%1").arg(file.errorString()), Error);
+        return;
+    }
+    file.write(S7_Metrics::snapshot().since(metricsBase).toJson());
+    logMessage(tr("【成功】通信统计已导出：%1").arg(path), Success);
+}
+
+//————————————————————————————
+// 配方
+void S7_Tester::onRecipeLayoutChanged()
+{
+    QString error;
+    if (!recipe->setLayout(editRecipeLayout->toPlainText(), &error)) {
+        labelRecipeStats->setText(tr("布局错误：%1").arg(error));
+        return;
+    }
+    refreshRecipeTable();
+}
+
+void S7_Tester::refreshRecipeTable()
+{
+    static const char *const typeNames[] = { "int", "bool", "float", "string", "char" };
+    recipeTableUpdating = true;
+    const QVector<RecipeField> &fields = recipe->fields();
+    tableRecipe->setRowCount(fields.size());
+    // 复用已有单元格，编辑回调中刷新时不替换正在编辑的项
+    auto cell = [this](int row, int column) {
+        QTableWidgetItem *item = tableRecipe->item(row, column);
+        if (!item) {
+            item = new QTableWidgetItem;
+            tableRecipe->setItem(row, column, item);
+        }
+        return item;
+    };
+    for (int row = 0; row < fields.size(); ++row) {
+        const RecipeField &field = fields[row];
+        const bool fits = recipe->fieldFits(row);
+        QString type = typeNames[field.dataType];
+        if (field.dataType == DT_String)
+            type += QString("[%1]").arg(field.strLength);
+
+        cell(row, 0)->setText(field.name);
+        cell(row, 1)->setText(field.dataType == DT_Bool ? QString("DBX%1.%2").arg(field.offset).arg(field.bitOffset)
+                                                        : QString("DBB%1").arg(field.offset));
+        cell(row, 2)->setText(type);
+        cell(row, 3)->setText(recipe->displayValue(row, true));
+        cell(row, 4)->setText(recipe->displayValue(row));
+        for (int column = 0; column < 4; ++column)
+            cell(row, column)->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
+        cell(row, 4)->setFlags(fits ? Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsEditable
+                                    : Qt::ItemIsSelectable);
+        // 待下载的字段高亮
+        cell(row, 4)->setBackground(recipe->isModified(row) ? QColor("#FFF2CC") : QColor(Qt::transparent));
+    }
+    recipeTableUpdating = false;
+}
+
+void S7_Tester::onRecipeCellChanged(int row, int column)
+{
+    if (recipeTableUpdating || column != 4)
+        return;
+    const QString text = tableRecipe->item(row, column)->text();
+    if (!recipe->setDisplayValue(row, text))
+        logMessage(tr("【错误】配方字段 %1 的值无效：%2").arg(recipe->fields()[row].name, text), Error);
+    refreshRecipeTable();
+}
+
+void S7_Tester::runRecipeJob(const std::function<void()> &job, const std::function<void()> &done)
+{
+    const QList<QWidget*> widgets = { btnRecipeUpload, btnRecipeDownload, btnRecipeLoad, btnRecipeSave,
+                                      editRecipeLayout, tableRecipe };
+    for (QWidget *widget : widgets)
+        widget->setEnabled(false);
+
+    recipeWorker = QThread::create(job);
+    connect(recipeWorker, &QThread::finished, this, [this, widgets, done]() {
+        recipeWorker->deleteLater();
+        recipeWorker = nullptr;
+        for (QWidget *widget : widgets)
+            widget->setEnabled(true);
+        done();
+    });
+    recipeWorker->start();
+}
+
+void S7_Tester::onRecipeUploadClicked()
+{
+    if (isConnectClicked()) {
+        logMessage(tr("【提示】请先连接PLC！！！"), Warning);
+        return;
+    }
+    recipe->setDb(spinRecipeDb->value(), spinRecipeSize->value());
+    auto error = std::make_shared<int>(0);
+    QElapsedTimer timer;
+    timer.start();
+    runRecipeJob([this, error]() {
+        *error = recipe->upload(s7);
+    }, [this, error, timer]() {
+        if (*error != 0) {
+            labelRecipeStats->setText(tr("上传失败：%1").arg(S7_BASE::ErrorText(*error)));
+            logMessage(tr("【错误】配方上传失败：%1").arg(S7_BASE::ErrorText(*error)), Error);
+            return;
+        }
+        refreshRecipeTable();
+        labelRecipeStats->setText(tr("DB%1 已上传 %2 字节，耗时 %3 ms")
+                                      .arg(recipe->dbNumber()).arg(recipe->size()).arg(timer.elapsed()));
+        logMessage(tr("【成功】配方 DB%1 上传完成（%2 字节）").arg(recipe->dbNumber()).arg(recipe->size()), Success);
+    });
+}
+
+void S7_Tester::onRecipeDownloadClicked()
+{
+    if (isConnectClicked()) {
+        logMessage(tr("【提示】请先连接PLC！！！"), Warning);
+        return;
+    }
+    if (recipe->image().isEmpty()) {
+        logMessage(tr("【提示】请先上传或打开配方"), Warning);
+        return;
+    }
+    if (!recipe->isModified()) {
+        logMessage(tr("【提示】配方没有修改"), Info);
+        return;
+    }
+    auto transfer = std::make_shared<RecipeTransfer>();
+    QElapsedTimer timer;
+    timer.start();
+    runRecipeJob([this, transfer]() {
+        *transfer = recipe->download(s7);
+    }, [this, transfer, timer]() {
+        refreshRecipeTable();
+        const QString summary = tr("变化区间 %1 个共 %2 字节、位 %3 个，读 %4 个报文、写 %5 个报文，耗时 %6 ms")
+                                    .arg(transfer->ranges).arg(transfer->changedBytes).arg(transfer->bitWrites)
+                                    .arg(transfer->readTelegrams).arg(transfer->writeTelegrams)
+                                    .arg(timer.elapsed());
+        labelRecipeStats->setText(summary);
+        if (transfer->error != 0)
+            logMessage(tr("【错误】配方下载失败：%1（%2）").arg(S7_BASE::ErrorText(transfer->error), summary), Error);
+        else
+            logMessage(tr("【成功】配方 DB%1 下载完成：%2").arg(recipe->dbNumber()).arg(summary), Success);
+    });
+}
+
+void S7_Tester::onRecipeLoadClicked()
+{
+    const QString path = QFileDialog::getOpenFileName(this, tr("打开配方"), QString(),
+                                                      tr("配方映像 (*.bin);;所有文件 (*)"));
+    if (path.isEmpty())
+        return;
+    if (recipe->image().isEmpty())
+        recipe->setDb(spinRecipeDb->value());
+    QString error;
+    if (!recipe->load(path, &error)) {
+        logMessage(tr("【错误】打开配方失败：%1").arg(error), Error);
+        return;
+    }
+    refreshRecipeTable();
+    logMessage(tr("【提示】已打开配方 %1，下载时只写入与PLC不同的数据").arg(path), Info);
+}
+
+void S7_Tester::onRecipeSaveClicked()
+{
+    if (recipe->image().isEmpty()) {
+        logMessage(tr("【提示】请先上传配方"), Warning);
+        return;
+    }
+    const QString path = QFileDialog::getSaveFileName(this, tr("保存配方"), QString(),
+                                                      tr("配方映像 (*.bin)"));
+    if (path.isEmpty())
+        return;
+    if (recipe->save(path))
+        logMessage(tr("【成功】配方已保存：%1").arg(path), Success);
+    else
+        logMessage(tr("【错误】配方保存失败：%1").arg(path), Error);
 }
 
 //————————————————————————————
@@ -479,9 +1049,7 @@ void S7_Tester::onClearInfoLogClicked()
 
 void S7_Tester::onClearTaskLogClicked()
 {
-    taskLog->clear();
-    taskLogCount = 0;
-    taskCountLabel->setText(tr("总数: %1").arg(taskLogCount));
+    taskLogModel->clear();
 }
 
 //————————————————————————————
@@ -533,10 +1101,24 @@ void S7_Tester::onConnectClicked()
     QString ip = editIp->text().trimmed();
     int rack = editRack->text().toInt();
     int slot = editSlot->text().toInt();
-    if(s7->Connect(ip, rack, slot))
+    quint16 connType = static_cast<quint16>(comboConnType->currentData().toInt());
+    int sessionCount = qMax(1, editSessions->text().toInt());
+    s7->SetConnectionType(connType);
+    asyncClient->setConnectionType(connType);
+    if(s7->Connect(ip, rack, slot) && asyncClient->connectTo(ip, rack, slot)) {
         logMessage(tr("【提示】PLC连接成功！"),Success);
-    else
+        // 多会话时启用连接池，循环任务分散到各会话并行读取
+        if(sessionCount > 1) {
+            int opened = pool->open(ip, rack, slot, sessionCount, connType);
+            scheduler->setConnectionPool(opened > 0 ? pool : nullptr);
+            logMessage(tr("【提示】连接池已建立 %1/%2 个会话").arg(opened).arg(sessionCount),
+                       opened == sessionCount ? Success : Warning);
+        }
+    }
+    else {
+        s7->Disconnect();
         logMessage(tr("【提示】PLC连接失败！"),Warning);
+    }
 }
 
 void S7_Tester::onDisconnectClicked()
@@ -547,34 +1129,72 @@ void S7_Tester::onDisconnectClicked()
     }
 
     // 停止并清理所有循环读任务
-    for (auto &item : taskList) {
-        if (item.worker) {
-            item.worker->stop();
-        }
-        if (item.thread) {
-            item.thread->quit();
-            item.thread->wait();
-            delete item.thread;
-            item.thread = nullptr;
-        }
-    }
+    scheduler->clearTasks();
+    tagTable->clear();
     // 清空任务列表和界面列表
-    taskList.clear();
+    tasks.clear();
     listTask->clear();
-
-    // 重置可用任务ID为1-10
-    availableTaskIds.clear();
-    for (int i = 1; i <= 10; ++i) {
-        availableTaskIds.append(i);
-    }
+    taskItems.clear();
+    watchModel->clear();
+    trendView->clearPens();
 
     // 断开PLC连接
+    scheduler->setConnectionPool(nullptr);
+    pool->close();
+    asyncClient->disconnectFromPlc();
     s7->Disconnect();
     logMessage(tr("【提示】PLC已断开连接，所有任务已停止并清除！"), Warning);
 }
 
+// 返回 true 表示PLC未连接；掉线重连期间视为已连接，断开按钮仍可用
 bool S7_Tester::isConnectClicked(){
-    return s7->isConnected();
+    return !s7->isConnected() && !s7->IsLinkLost();
+}
+
+//————————————————————————————
+// 链路中断与自动重连：任务、变量表和趋势保持不变，中断期间变量质量为坏值
+void S7_Tester::onLinkLost(int errorCode)
+{
+    logMessage(tr("【警告】PLC连接中断：%1，正在自动重连…").arg(S7_BASE::ErrorText(errorCode)), Warning);
+}
+
+void S7_Tester::onReconnectFailed(int attempt, int nextDelayMs)
+{
+    logMessage(tr("【警告】第 %1 次重连失败，%2 ms 后重试").arg(attempt).arg(nextDelayMs), Warning);
+}
+
+void S7_Tester::onLinkRestored(int attempts, qint64 downtimeMs)
+{
+    // 手动读写会话与连接池会话随主连接一起恢复
+    if (asyncClient->isLinked())
+        asyncClient->reconnect();
+    if (pool->sessionCount() > 0)
+        pool->healthCheck();
+    logMessage(tr("【成功】PLC连接已恢复（重连 %1 次，中断 %2 ms），循环任务继续采集")
+                   .arg(attempts).arg(downtimeMs), Success);
+}
+
+//————————————————————————————
+// 手动写入经主连接的I/O线程以手动优先级执行，排在已排队的循环读取之前；
+// 提交后立即返回，结果在界面线程中回调。bit 写入时 start 为 字节*8+位、wordLen 为 S7WLBit
+void S7_Tester::postManualWrite(int area, int dbNumber, int start, int wordLen, const QByteArray &data,
+                                const std::function<void(int result)> &done)
+{
+    S7_BASE *base = s7;
+    base->Post(S7_BASE::PriorityManual, [this, base, area, dbNumber, start, wordLen, data, done]() {
+        QByteArray buffer = data;
+        QVector<S7_MultiItem> items(1);
+        S7_MultiItem &item = items[0];
+        item.area = area;
+        item.dbNumber = dbNumber;
+        item.start = start;
+        item.size = buffer.size();
+        item.wordLen = wordLen;
+        item.buffer = reinterpret_cast<quint8*>(buffer.data());
+        base->WriteMultiVars(items, S7_BASE::PriorityManual);
+        const int result = items[0].result;
+        QMetaObject::invokeMethod(this, [done, result]() { done(result); }, Qt::QueuedConnection);
+    });
 }
 
 //————————————————————————————
@@ -593,8 +1213,12 @@ void S7_Tester::onReadStringClicked()
     int byteAddr = 0, bitOffset = 0;
     if (!parseAddress(editStartByte->text(), byteAddr, bitOffset, false)) return;
 
-    QString result = s7->ReadString(areaCode, dbNumber, byteAddr, 20);
-    logMessage(tr("【提示】读 string：%1").arg(result),Info);
+    asyncClient->readArea(areaCode, dbNumber, byteAddr, 20 + 2, [this](int result, const QByteArray &data) {
+        if (result == 0)
+            logMessage(tr("【提示】读 string：%1").arg(S7_BASE::GetString(rawData(data), 20)),Info);
+        else
+            logMessage(tr("【提示】读 string 失败：%1").arg(S7_BASE::ErrorText(result)),Warning);
+    });
 }
 
 void S7_Tester::onWriteStringClicked()
@@ -612,10 +1236,14 @@ void S7_Tester::onWriteStringClicked()
     if (!parseAddress(editStartByte->text(), byteAddr, bitOffset, false)) return;
 
     QString value = editStringValue->text();
-    if(s7->WriteString(areaCode, dbNumber, byteAddr, value, 20))
-        logMessage(tr("【提示】写 string 成功，值：%1").arg(value),Info);
-    else
-        logMessage(tr("【提示】写 string 失败，值：%1").arg(value),Warning);
+    QByteArray buffer(20 + 2, 0);
+    S7_BASE::SetString(reinterpret_cast<quint8*>(buffer.data()), value, 20);
+    postManualWrite(areaCode, dbNumber, byteAddr, S7WLByte, buffer, [this, value](int result) {
+        if (result == 0)
+            logMessage(tr("【提示】写 string 成功，值：%1").arg(value),Info);
+        else
+            logMessage(tr("【提示】写 string 失败，值：%1").arg(value),Warning);
+    });
 }
 
 //————————————————————————————
@@ -634,8 +1262,12 @@ void S7_Tester::onReadIntClicked()
     int byteAddr = 0, bitOffset = 0;
     if (!parseAddress(editStartByte->text(), byteAddr, bitOffset, false)) return;
 
-    int value = s7->ReadInt(areaCode, dbNumber, byteAddr);
-    logMessage(tr("【提示】读 int：%1").arg(value),Info);
+    asyncClient->readArea(areaCode, dbNumber, byteAddr, 2, [this](int result, const QByteArray &data) {
+        if (result == 0)
+            logMessage(tr("【提示】读 int：%1").arg(S7_BASE::GetInt(rawData(data))),Info);
+        else
+            logMessage(tr("【提示】读 int 失败：%1").arg(S7_BASE::ErrorText(result)),Warning);
+    });
 }
 
 void S7_Tester::onWriteIntClicked()
@@ -653,10 +1285,14 @@ void S7_Tester::onWriteIntClicked()
     if (!parseAddress(editStartByte->text(), byteAddr, bitOffset, false)) return;
 
     int value = editIntValue->text().toInt();
-    if(s7->WriteInt(areaCode, dbNumber, byteAddr, value))
-        logMessage(tr("【提示】写 int 成功，值：%1").arg(value),Info);
-    else
-        logMessage(tr("【提示】写 int 失败，值：%1").arg(value),Warning);
+    QByteArray buffer(2, 0);
+    S7_BASE::SetInt(reinterpret_cast<quint8*>(buffer.data()), value);
+    postManualWrite(areaCode, dbNumber, byteAddr, S7WLByte, buffer, [this, value](int result) {
+        if (result == 0)
+            logMessage(tr("【提示】写 int 成功，值：%1").arg(value),Info);
+        else
+            logMessage(tr("【提示】写 int 失败，值：%1").arg(value),Warning);
+    });
 }
 
 //————————————————————————————
@@ -675,8 +1311,12 @@ void S7_Tester::onReadBoolClicked()
 
     if (!parseAddress(editStartByte->text(), startByte, bitPos, true)) return;
 
-    bool value = s7->ReadBool(areaCode, dbNumber, startByte, bitPos);
-    logMessage(tr("【提示】读 bool：%1").arg(value ? "TRUE" : "FALSE"),Info);
+    asyncClient->readArea(areaCode, dbNumber, startByte, 1, [this, bitPos](int result, const QByteArray &data) {
+        if (result == 0)
+            logMessage(tr("【提示】读 bool：%1").arg(S7_BASE::GetBool(rawData(data), bitPos) ? "TRUE" : "FALSE"),Info);
+        else
+            logMessage(tr("【提示】读 bool 失败：%1").arg(S7_BASE::ErrorText(result)),Warning);
+    });
 }
 
 void S7_Tester::onWriteBoolClicked()
@@ -693,10 +1333,13 @@ void S7_Tester::onWriteBoolClicked()
     if (!parseAddress(editStartByte->text(), startByte, bitPos, true)) return;
 
     bool value = checkBoolValue->isChecked();
-    if(s7->WriteBool(areaCode, dbNumber, startByte, bitPos, value))
-        logMessage(tr("【提示】写 bool 成功，值：%1").arg(value ? "TRUE" : "FALSE"),Info);
-    else
-        logMessage(tr("【提示】写 bool 失败"),Warning);
+    postManualWrite(areaCode, dbNumber, startByte * 8 + bitPos, S7WLBit, QByteArray(1, value ? 1 : 0),
+                    [this, value](int result) {
+        if (result == 0)
+            logMessage(tr("【提示】写 bool 成功，值：%1").arg(value ? "TRUE" : "FALSE"),Info);
+        else
+            logMessage(tr("【提示】写 bool 失败"),Warning);
+    });
 }
 
 //————————————————————————————
@@ -715,8 +1358,12 @@ void S7_Tester::onReadCharClicked()
     int byteAddr = 0, bitOffset = 0;
     if (!parseAddress(editStartByte->text(), byteAddr, bitOffset, false)) return;
 
-    char ch = s7->ReadChar(areaCode, dbNumber, byteAddr);
-    logMessage(tr("【提示】读 char：%1").arg(ch),Info);
+    asyncClient->readArea(areaCode, dbNumber, byteAddr, 1, [this](int result, const QByteArray &data) {
+        if (result == 0)
+            logMessage(tr("【提示】读 char：%1").arg(S7_BASE::GetChar(rawData(data))),Info);
+        else
+            logMessage(tr("【提示】读 char 失败：%1").arg(S7_BASE::ErrorText(result)),Warning);
+    });
 }
 
 void S7_Tester::onWriteCharClicked()
@@ -739,10 +1386,13 @@ void S7_Tester::onWriteCharClicked()
         return;
     }
     char ch = str.at(0).toLatin1();
-    if(s7->WriteChar(areaCode, dbNumber, byteAddr, ch))
-        logMessage(tr("【提示】写 char 成功，值：%1").arg(ch),Info);
-    else
-        logMessage(tr("【提示】写 char 失败，值：%1").arg(ch),Warning);
+    QByteArray buffer(1, ch);
+    postManualWrite(areaCode, dbNumber, byteAddr, S7WLByte, buffer, [this, ch](int result) {
+        if (result == 0)
+            logMessage(tr("【提示】写 char 成功，值：%1").arg(ch),Info);
+        else
+            logMessage(tr("【提示】写 char 失败，值：%1").arg(ch),Warning);
+    });
 }
 
 //————————————————————————————
@@ -761,8 +1411,12 @@ void S7_Tester::onReadFloatClicked()
     int byteAddr = 0, bitOffset = 0;
     if (!parseAddress(editStartByte->text(), byteAddr, bitOffset, false)) return;
 
-    float value = s7->ReadFloat(areaCode, dbNumber, byteAddr);
-    logMessage(tr("【提示】读 float：%1").arg(value),Info);
+    asyncClient->readArea(areaCode, dbNumber, byteAddr, 4, [this](int result, const QByteArray &data) {
+        if (result == 0)
+            logMessage(tr("【提示】读 float：%1").arg(S7_BASE::GetFloat(rawData(data))),Info);
+        else
+            logMessage(tr("【提示】读 float 失败：%1").arg(S7_BASE::ErrorText(result)),Warning);
+    });
 }
 
 void S7_Tester::onWriteFloatClicked()
@@ -780,10 +1434,34 @@ void S7_Tester::onWriteFloatClicked()
     if (!parseAddress(editStartByte->text(), byteAddr, bitOffset, false)) return;
 
     float value = editFloatValue->text().toFloat();
-    if(s7->WriteFloat(areaCode, dbNumber, byteAddr, value))
-        logMessage(tr("【提示】写 float 成功，值：%1").arg(value),Info);
+    QByteArray buffer(4, 0);
+    S7_BASE::SetFloat(reinterpret_cast<quint8*>(buffer.data()), value);
+    postManualWrite(areaCode, dbNumber, byteAddr, S7WLByte, buffer, [this, value](int result) {
+        if (result == 0)
+            logMessage(tr("【提示】写 float 成功，值：%1").arg(value),Info);
+        else
+            logMessage(tr("【提示】写 float 失败，值：%1").arg(value),Warning);
+    });
+}
+
+//————————————————————————————
+// 连接池会话状态变化
+void S7_Tester::onPoolSessionChanged(int index, bool healthy)
+{
+    if(healthy)
+        logMessage(tr("【提示】连接池会话%1 已恢复").arg(index + 1),Success);
     else
-        logMessage(tr("【提示】写 float 失败，值：%1").arg(value),Warning);
+        logMessage(tr("【提示】连接池会话%1 已断开，等待重连").arg(index + 1),Warning);
+}
+
+//————————————————————————————
+// 异步读写统计：排队深度与延迟
+void S7_Tester::onAsyncStatsChanged()
+{
+    labelAsyncStats->setText(tr("异步队列:%1  最近延迟:%2us  平均延迟:%3us")
+                                 .arg(asyncClient->queueDepth())
+                                 .arg(asyncClient->lastLatencyUs())
+                                 .arg(asyncClient->averageLatencyUs()));
 }
 
 //————————————————————————————
@@ -821,11 +1499,6 @@ void S7_Tester::onAddTaskClicked()
         return;
     }
 
-    if(taskList.size() >= 10) {
-        QMessageBox::warning(this, tr("警告"), tr("最多允许添加10个循环读任务"));
-        return;
-    }
-
     // 获取任务区域
     QString areaStr = comboTaskArea->currentText();
     int areaCode = mapArea(areaStr);
@@ -858,57 +1531,65 @@ void S7_Tester::onAddTaskClicked()
         return;
     }
 
-    // 检查是否已存在相同任务（区域、数据类型、起始字节、位偏移；对于 DB 区还要 DB 号相同）
-    for(const TaskItem &item : taskList) {
-        TaskWorker *worker = item.worker;
-        if(worker) {
-            if(worker->dataType == dt &&
-                worker->area == areaCode &&
-                worker->startAddr == byteAddr &&
-                worker->bitOffset == bitOffset)
-            {
-                if(areaStr != "DB" || worker->dbNum == dbNumber) {
-                    QMessageBox::warning(this, tr("警告"), tr("不能添加相同的任务"));
-                    return;
-                }
-            }
+    // 变化过滤：float 可设绝对死区或百分比死区（以%结尾），心跳为空或0时关闭
+    TagFilter filter;
+    QString deadbandStr = editTaskDeadband->text().trimmed();
+    if (dt == DT_Float && !deadbandStr.isEmpty()) {
+        bool percent = deadbandStr.endsWith('%');
+        if (percent)
+            deadbandStr.chop(1);
+        bool ok = false;
+        double deadband = deadbandStr.toDouble(&ok);
+        if (!ok || deadband < 0) {
+            logMessage(tr("【警告】死区格式错误，如 0.5 或 2%"), Error);
+            return;
         }
+        filter.mode = percent ? DeadbandPercent : DeadbandAbsolute;
+        filter.deadband = deadband;
     }
+    filter.heartbeatMs = editTaskHeartbeat->text().toInt();
 
-    // 检查是否还有可用编号
-    if (availableTaskIds.isEmpty()) {
-        QMessageBox::warning(this, tr("警告"), tr("最多允许添加10个循环读任务"));
-        return;
-    }
-
-    // 取出最小可用编号
-    int taskId = availableTaskIds.takeFirst();
-
-    // 创建新的任务对象，并传入解析后的起始地址和位偏移
-    TaskWorker *worker = new TaskWorker(taskId, s7, areaCode, dbNumber, byteAddr, bitOffset, dt, interval);
-    QThread *thread = new QThread;
-    worker->moveToThread(thread);
-    connect(thread, &QThread::started, worker, &TaskWorker::start);
-    connect(worker, &TaskWorker::newData, this,
-            [this](int taskId, const QString &msg) {
-                onTaskNewData(taskId, msg);
-            });
-    connect(worker, &TaskWorker::finished, this, &S7_Tester::onTaskFinished);
-    connect(worker, &TaskWorker::finished, worker, &TaskWorker::deleteLater);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    TagAddress tag;
+    tag.area = areaCode;
+    tag.dbNumber = dbNumber;
+    tag.startByte = byteAddr;
+    tag.bitOffset = bitOffset;
+    tag.dataType = dt;
 
+    // 登记任务：地址重复（区域、DB号、数据类型、起始字节、位偏移均相同）时拒绝，
+    // 编号优先复用已停止任务的最小编号
     TaskItem item;
-    item.thread = thread;
-    item.worker = worker;
-    item.taskId = taskId;
+    item.taskId = 0;
+    item.tag = tag;
     item.areaStr = areaStr;
     item.dbNumber = dbNumber;
     item.startByteStr = editTaskStartByte->text();
     item.typeStr = typeStr;
     item.interval = interval;
     item.executionCount = 0; // 初始次数为0
-    taskList.append(item);
+    item.lastUpdates = 0;
+    item.lastReads = 0;
+    int taskId = tasks.add(item);
+    if (taskId < 0) {
+        QMessageBox::warning(this, tr("警告"), tr("不能添加相同的任务"));
+        return;
+    }
+    if (taskId >= S7_TagTable::MaxTags) {
+        tasks.remove(taskId);
+        QMessageBox::warning(this, tr("警告"), tr("任务数量超出上限"));
+        return;
+    }
+
+    // 交给调度器，传入解析后的起始地址和位偏移
+    tagTable->defineTag(taskId, tr("任务%1").arg(taskId), tag, filter);
+    const TagSample initial = tagTable->sample(taskId);
+    TaskItem *stored = tasks.find(taskId);
+    stored->lastUpdates = initial.updates;
+    stored->lastReads = initial.reads;
+    scheduler->addTask(taskId, tag, interval);
+    watchModel->addTag(taskId);
+    if (tag.dataType != DT_String)
+        trendView->addPen(taskId, tr("任务%1").arg(taskId), QColor::fromHsv(taskId * 67 % 360, 220, 200));
 
     // 生成带次数的任务描述并添加到列表
     QString taskDesc = QString("【任务%1】区域:%2").arg(taskId).arg(areaStr);
@@ -921,6 +1602,7 @@ void S7_Tester::onAddTaskClicked()
     QListWidgetItem *listItem = new QListWidgetItem(taskDesc);
     listItem->setData(Qt::UserRole, taskId); // 存储taskId到项的data中
     listTask->addItem(listItem);
+    taskItems.insert(taskId, listItem);
 
     logMessage(tr("【提示】添加任务成功：%1").arg(taskDesc),Info);
 }
@@ -929,60 +1611,105 @@ void S7_Tester::onAddTaskClicked()
 // 循环读任务：停止任务槽函数
 void S7_Tester::onStopTaskClicked()
 {
-    int currentRow = listTask->currentRow();
-    if(currentRow < 0 || currentRow >= taskList.size()){
+    QListWidgetItem *listItem = listTask->currentItem();
+    if(!listItem){
         QMessageBox::warning(this, tr("提示"), tr("请选择要停止的任务"));
         return;
     }
-    TaskItem item = taskList.takeAt(currentRow);
-    availableTaskIds.append(item.taskId);
-    std::sort(availableTaskIds.begin(), availableTaskIds.end()); // 保持编号有序
-    if(item.worker)
-        item.worker->stop();
-    if(item.thread) {
-        item.thread->quit();
-        item.thread->wait();
-    }
-    delete listTask->takeItem(currentRow);
-    logMessage(tr("【提示】任务%1 已停止").arg(item.taskId),Info);
+    int taskId = listItem->data(Qt::UserRole).toInt();
+    tasks.remove(taskId);
+    scheduler->removeTask(taskId);
+    watchModel->removeTag(taskId);
+    trendView->removePen(taskId);
+    tagTable->removeTag(taskId);
+    taskItems.remove(taskId);
+    delete listItem;
+    logMessage(tr("【提示】任务%1 已停止").arg(taskId),Info);
 }
 
 //————————————————————————————
-// 循环读任务：任务新数据槽函数
-void S7_Tester::onTaskNewData(int taskId, const QString &msg)
-{
-    // 查找对应的TaskItem
-    for (int i = 0; i < taskList.size(); ++i) {
-        TaskItem &item = taskList[i];
-        if (item.taskId == taskId) {
-            item.executionCount++; // 递增次数
-
-            // 更新列表项的文本
-            for (int j = 0; j < listTask->count(); ++j) {
-                QListWidgetItem *listItem = listTask->item(j);
-                if (listItem->data(Qt::UserRole).toInt() == taskId) {
-                    // 重新生成带次数的描述
-                    QString newDesc = QString("【任务%1】区域:%2").arg(taskId).arg(item.areaStr);
-                    if (item.areaStr == "DB")
-                        newDesc.append(QString("  DB地址:%1").arg(item.dbNumber));
-                    newDesc.append(QString("  偏移量:%1").arg(item.startByteStr));
-                    newDesc.append(QString("  类型:%1 间隔:%2ms").arg(item.typeStr).arg(item.interval));
-                    newDesc.append(QString("  执行次数：%1").arg(item.executionCount));
-                    listItem->setText(newDesc);
-                    break;
-                }
-            }
-
-            TaskMessage(tr("任务%1: %2").arg(taskId).arg(msg), Info);
-            break;
-        }
+// 循环读任务：从变量表刷新任务列表与任务日志
+void S7_Tester::refreshTasks()
+{
+    for (int taskId : qAsConst(dirtyTaskIds)) {
+        TaskItem *task = tasks.find(taskId);
+        QListWidgetItem *listItem = taskItems.value(taskId);
+        if (!task || !listItem)
+            continue;
+        TaskItem &item = *task;
+        const TagSample sample = tagTable->sample(taskId);
+        if (sample.reads == item.lastReads)
+            continue;
+        item.executionCount += static_cast<int>(sample.reads - item.lastReads);
+        item.lastReads = sample.reads;
+
+        // 重新生成带次数的描述
+        QString newDesc = QString("【任务%1】区域:%2").arg(taskId).arg(item.areaStr);
+        if (item.areaStr == "DB")
+            newDesc.append(QString("  DB地址:%1").arg(item.dbNumber));
+        newDesc.append(QString("  偏移量:%1").arg(item.startByteStr));
+        newDesc.append(QString("  类型:%1 间隔:%2ms").arg(item.typeStr).arg(item.interval));
+        newDesc.append(QString("  执行次数：%1").arg(item.executionCount));
+        listItem->setText(newDesc);
+
+        // 值未变化（死区内）且未到心跳时不输出日志
+        if (sample.updates == item.lastUpdates)
+            continue;
+        item.lastUpdates = sample.updates;
+        TaskMessage(tr("任务%1: %2").arg(taskId).arg(formatTaskValue(item, sample)), Info);
+    }
+}
+
+// 按数据类型格式化变量表中的值
+QString S7_Tester::formatTaskValue(const TaskItem &item, const TagSample &sample) const
+{
+    const TagAddress &tag = item.tag;
+    QString prefix;
+    switch (tag.dataType) {
+    case DT_Int:    prefix = QString("Int类型-偏移量:%1").arg(tag.startByte); break;
+    case DT_Bool:   prefix = QString("Bool类型-偏移量:%1.%2").arg(tag.startByte).arg(tag.bitOffset); break;
+    case DT_Float:  prefix = QString("Float类型-偏移量:%1").arg(tag.startByte); break;
+    case DT_String: prefix = QString("String类型-偏移量:%1").arg(tag.startByte); break;
+    case DT_Char:   prefix = QString("Char类型-偏移量:%1").arg(tag.startByte); break;
+    default:        return "未知数据类型";
     }
+    if (sample.quality != QualityGood)
+        return prefix + "  读取失败";
+    return prefix + QString("  获取值：%1").arg(tagTable->displayValue(item.taskId));
 }
 
 //————————————————————————————
-// 循环读任务：任务结束槽函数
-void S7_Tester::onTaskFinished()
+// 界面刷新帧
+void S7_Tester::onFrame()
+{
+    const TickStats stats = scheduler->lastStats();
+    if (stats.tickIndex != lastTickIndex) {
+        lastTickIndex = stats.tickIndex;
+        showTickStats(stats);
+    }
+    tagTable->takeDirty(dirtyTaskIds);
+    refreshTasks();
+    watchModel->refresh(dirtyTaskIds);
+    trendView->advance();
+
+    if (simulator->isRunning()) {
+        const S7_Simulator::Stats sim = simulator->stats();
+        labelSimStats->setText(tr("连接:%1  报文:%2  读:%3  写:%4  错误:%5")
+                                   .arg(simulator->clientCount()).arg(sim.requests).arg(sim.itemsRead)
+                                   .arg(sim.itemsWritten).arg(sim.errorsInjected));
+    }
+}
+
+// 批次统计
+void S7_Tester::showTickStats(const TickStats &stats)
 {
-    logMessage(tr("【提示】任务结束"),Info);
+    labelTickStats->setText(tr("批次:%1  变量:%2  报文:%3  耗时:%4us  滞后:%5ms")
+                                .arg(stats.tickIndex).arg(stats.tagsServed).arg(stats.pdusSent)
+                                .arg(stats.elapsedUs).arg(stats.lateMs));
+    if (stats.tagsBackedOff > 0)
+        labelTickStats->setText(labelTickStats->text()
+                                + tr("  退避:%1 (%2)").arg(stats.tagsBackedOff).arg(S7_BASE::ErrorText(stats.lastError)));
+    // 超限时标红，提示需要加大采集间隔
+    labelTickStats->setStyleSheet(stats.overrun ? "color:#FF0000" : QString());
 }
 
@@ -11,66 +11,29 @@
 #include <QThread>
 #include <QTimer>
 #include <QListWidget>
+#include <QListView>
+#include <QHash>
+#include <QTableView>
+#include <QTableWidget>
+#include <QSpinBox>
 #include "s7_base.h"
+#include "s7_scheduler.h"
+#include "s7_async.h"
+#include "s7_pool.h"
+#include "s7_tagtable.h"
+#include "s7_logmodel.h"
+#include "s7_watchmodel.h"
+#include "s7_taskregistry.h"
+#include "s7_historian.h"
+#include "s7_trendwidget.h"
+#include "s7_simulator.h"
+#include "s7_metrics.h"
+#include "s7_supervisor.h"
+#include "s7_recipe.h"
+#include <functional>
 
 
 
-// 支持的数据类型枚举
-enum DataType {
-    DT_Int,
-    DT_Bool,
-    DT_Float,
-    DT_String,
-    DT_Char
-};
-
-// 任务工作类，用于在独立线程中循环读取数据
-class TaskWorker : public QObject
-{
-    Q_OBJECT
-public:
-    // 构造函数用于 bool 类型任务
-    TaskWorker(int taskId, S7_BASE *s7Ptr, int areaCode, int dbNumber, int startByte, int bitOffset,
-               DataType dt, int interval, QObject *parent = nullptr);
-    ~TaskWorker();
-    void start();
-    void stop();
-    static int mapArea(const QString &areaStr);
-
-    // 用于任务重复判断
-    int area;
-    int dbNum;
-    int startAddr;
-    int bitOffset;
-    DataType dataType;
-
-signals:
-    void newData(int taskId, const QString &msg);
-    void finished();
-
-private slots:
-    void doRead();
-
-private:
-    int m_taskId;
-    S7_BASE *s7;
-    int intervalMs;
-    QTimer *timer;
-};
-
-// 存储任务对象及对应线程信息
-struct TaskItem {
-    QThread *thread;
-    TaskWorker *worker;
-    int taskId;
-    QString areaStr;      // 区域字符串，如"DB"
-    int dbNumber;         // DB号（仅DB区域有效）
-    QString startByteStr; // 起始地址字符串，如"18.5"
-    QString typeStr;      // 数据类型字符串，如"int"
-    int interval;         // 间隔时间（毫秒）
-    int executionCount;   // 执行次数
-};
-
 class S7_Tester : public QMainWindow
 {
     Q_OBJECT
@@ -115,8 +78,34 @@ private slots:
     // 循环读任务相关槽
     void onAddTaskClicked();
     void onStopTaskClicked();
-    void onTaskNewData(int taskId, const QString &msg);
-    void onTaskFinished();
+    // 界面刷新帧：批量取出变化的任务并刷新列表、日志和批次统计
+    void onFrame();
+    void onAsyncStatsChanged();
+    void onPoolSessionChanged(int index, bool healthy);
+    void onTaskLogCountChanged(quint64 total);
+    // 开启/关闭循环任务的历史记录
+    void onHistoryToggled(bool checked);
+    // 导出当前任务最近24小时的历史数据（CSV/列式文件）
+    void onExportHistoryClicked();
+    // 本机仿真PLC：启停、通信约束与故障注入
+    void onSimulatorToggled(bool checked);
+    void onSimulatorSettingsChanged();
+    void onSimulatorDropClicked();
+    // 通信统计：每秒刷新，可清零与导出JSON
+    void onMetricsTimer();
+    void onMetricsResetClicked();
+    void onMetricsExportClicked();
+    // 链路中断与自动重连
+    void onLinkLost(int errorCode);
+    void onReconnectFailed(int attempt, int nextDelayMs);
+    void onLinkRestored(int attempts, qint64 downtimeMs);
+    // 配方：整个DB上传、按布局编辑、比较后只下载变化的区间
+    void onRecipeUploadClicked();
+    void onRecipeDownloadClicked();
+    void onRecipeLoadClicked();
+    void onRecipeSaveClicked();
+    void onRecipeLayoutChanged();
+    void onRecipeCellChanged(int row, int column);
 
     // 当任务区域选择变化时，调整任务专用 DB 号输入框（仅 DB 区启用）
     void onTaskAreaChanged(const QString &text);
@@ -127,18 +116,57 @@ private:
     void S7_Tester::TaskMessage(const QString &msg, LogType type);
     // 地址解析：允许小数点时返回字节地址和位偏移
     bool parseAddress(const QString &address, int &byteAddr, int &bitOffset, bool allowBit = false);
+    // 从变量表刷新任务的执行次数与最新值，仅在显示时格式化
+    void refreshTasks();
+    void showTickStats(const TickStats &stats);
+    QString formatTaskValue(const TaskItem &item, const TagSample &sample) const;
+    void refreshRecipeTable();
+    // 手动写入：经主连接以手动优先级排队，不阻塞界面线程，完成后在界面线程中调用 done
+    void postManualWrite(int area, int dbNumber, int start, int wordLen, const QByteArray &data,
+                         const std::function<void(int result)> &done);
+    // 在后台线程中执行配方传输，完成后在界面线程中调用 done
+    void runRecipeJob(const std::function<void()> &job, const std::function<void()> &done);
 
     S7_BASE *s7;
-
-    QList<int> availableTaskIds; // 可用任务编号池（1-10）
+    S7_Scheduler *scheduler;     // 循环任务调度器（独立采集线程）
+    S7_TagTable *tagTable;       // 循环任务变量表，变量编号即任务编号
+    QThread *schedulerThread;
+    S7_Supervisor *supervisor;   // 连接监督器（与调度器同一线程），掉线后自动重连
+    S7_AsyncClient *asyncClient; // 手动读取的异步会话（写入经主连接按手动优先级排队）
+    S7_ConnectionPool *pool;     // 循环任务的多会话连接池
+    S7_Historian *historian;     // 循环任务历史库（程序目录下 history）
+    S7_Simulator *simulator;     // 本机仿真PLC（127.0.0.1）
+    S7_Recipe *recipe;           // 配方映像与布局，传输期间只由后台线程访问
+    QThread *recipeWorker;       // 正在执行的配方传输，空闲时为空
+
+    S7_TaskRegistry tasks;       // 循环任务登记表（按编号/地址哈希查找，编号复用）
+    QHash<int, QListWidgetItem*> taskItems;  // 任务编号 -> 任务列表项
+    QTimer *frameTimer;          // 界面刷新帧定时器（约30Hz）
+    S7_WatchModel *watchModel;   // 变量监视表
+    S7_TrendBuffer *trendBuffer; // 采集线程 -> 趋势图的数据通道
+    QVector<int> dirtyTaskIds;   // 本帧需要刷新的任务编号（复用）
+    quint64 lastTickIndex;       // 已显示的批次序号
+    QTimer *metricsTimer;        // 通信统计刷新定时器（1s）
+    S7_Metrics::Snapshot metricsBase;  // 清零时的快照，显示值为相对此快照的增量
+    S7_Metrics::Snapshot metricsLast;  // 上次刷新的快照，用于计算速率
 
     // 连接相关控件
     QLineEdit   *editIp;
     QLineEdit   *editRack;
     QLineEdit   *editSlot;
+    QComboBox   *comboConnType;  // 连接类型 PG/OP/S7基本
+    QLineEdit   *editSessions;   // 会话数（大于1时启用连接池）
     QPushButton *btnConnect;
     QPushButton *btnDisconnect;
 
+    // 仿真PLC控件
+    QCheckBox   *checkSimulator;
+    QSpinBox    *spinSimLatency;   // 报文附加延迟(ms)
+    QSpinBox    *spinSimJitter;    // 延迟抖动(ms)
+    QSpinBox    *spinSimErrorRate; // 数据项错误率(%)
+    QPushButton *btnSimDrop;
+    QLabel      *labelSimStats;
+
     // 主界面区域设置参数
     QComboBox   *comboArea;
     QLineEdit   *editDbNumber;
@@ -174,9 +202,14 @@ private:
     QPushButton *btnWriteFloat;
     QLabel      *labelFloatResult;
 
+    QLabel      *labelAsyncStats; // 异步读写统计
+
     // 日志信息输出控件
     QTextEdit   *textLog;
-    QTextEdit   *taskLog;    //任务日志
+    QListView   *taskLog;    //任务日志（有界日志模型，只绘制可见行）
+    S7_LogModel *taskLogModel;
+    QSpinBox    *spinTaskLogCapacity;  // 任务日志保留条数
+    bool taskLogFollow;          // 滚动条在底部时新日志自动滚动
 
     // 循环读任务控件
     QComboBox   *comboTaskArea;
@@ -184,16 +217,32 @@ private:
     QLineEdit   *editTaskStartByte;
     QComboBox   *comboTaskDataType;
     QLineEdit   *editTaskInterval;
+    QLineEdit   *editTaskDeadband;   // float死区，如 0.5 或 2%
+    QLineEdit   *editTaskHeartbeat;  // 心跳间隔(ms)，空或0为关闭
     QPushButton *btnAddTask;
     QPushButton *btnStopTask;
     QListWidget *listTask;
-
-    // 存储任务对象（最多允许10个任务）
-    QList<TaskItem> taskList;
+    QTableView  *watchView;
+    S7_TrendWidget *trendView;   // 趋势图（每个数值任务一支笔）
+    QTableWidget *tableMetrics;  // 通信统计（每种操作一行）
+    QPushButton *btnMetricsReset;
+    QPushButton *btnMetricsExport;
+    QSpinBox    *spinRecipeDb;
+    QSpinBox    *spinRecipeSize;   // 0 表示由 Cli_DBGet 获取长度
+    QTextEdit   *editRecipeLayout;
+    QTableWidget *tableRecipe;     // 字段、PLC值、设定值
+    QPushButton *btnRecipeUpload;
+    QPushButton *btnRecipeDownload;
+    QPushButton *btnRecipeLoad;
+    QPushButton *btnRecipeSave;
+    QLabel      *labelRecipeStats;
+    bool recipeTableUpdating;      // 刷新表格时忽略 cellChanged
+    QLabel      *labelTickStats; // 批次统计信息
+    QCheckBox   *checkHistory;   // 记录历史数据
+    QPushButton *btnExportHistory;
 
     //
     int infoLogCount;
-    int taskLogCount;
     QLabel *infoCountLabel;
     QLabel *taskCountLabel;
     QPushButton *btnClearInfoLog;
@@ -0,0 +1,74 @@
+﻿#ifndef S7_TRENDBUFFER_H
+#define S7_TRENDBUFFER_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <atomic>
+
+// 趋势数据通道：采集线程写入、界面线程按帧取出的单生产者单消费者无锁环形缓冲区。
+// 写满时丢弃新数据并计数，采集线程不会被界面阻塞
+class S7_TrendBuffer
+{
+public:
+    struct Record {
+        int tagId;
+        qint64 timestamp;
+        double value;
+    };
+
+    explicit S7_TrendBuffer(int capacityPow2 = 1 << 16)
+        : mask(capacityPow2 - 1),
+        records(capacityPow2),
+        head(0),
+        tail(0),
+        dropped(0)
+    {
+        Q_ASSERT((capacityPow2 & mask) == 0);
+    }
+
+    S7_TrendBuffer(const S7_TrendBuffer &) = delete;
+    S7_TrendBuffer &operator=(const S7_TrendBuffer &) = delete;
+
+    // 仅采集线程调用
+    bool push(int tagId, qint64 timestamp, double value)
+    {
+        const quint64 h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Record &record = records[int(h & mask)];
+        record.tagId = tagId;
+        record.timestamp = timestamp;
+        record.value = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 仅界面线程调用：依次取出已写入的记录交给 sink(const Record&)，返回条数
+    template <typename Sink>
+    int drain(Sink &&sink)
+    {
+        const quint64 h = head.load(std::memory_order_acquire);
+        quint64 t = tail.load(std::memory_order_relaxed);
+        const int count = int(h - t);
+        for (; t != h; ++t)
+            sink(records[int(t & mask)]);
+        tail.store(t, std::memory_order_release);
+        return count;
+    }
+
+    quint64 droppedCount() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    const quint64 mask;
+    QVector<Record> records;
+    alignas(64) std::atomic<quint64> head;  // 生产者与消费者的位置分处不同缓存行
+    alignas(64) std::atomic<quint64> tail;
+    std::atomic<quint64> dropped;
+};
+
+#endif
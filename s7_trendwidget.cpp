@@ -0,0 +1,421 @@
+﻿/******************************************************************************
+ * @file    s7_trendwidget.cpp
+ * @brief   实时趋势图控件
+ *
+ * @details
+ * 功能描述：
+ *    - 多支笔，数据由采集线程经无锁趋势通道送入，界面帧中批量取出
+ *    - 可见采样不超过两倍像素宽度时直接连线，否则按像素列 min/max 抽稀或 LTTB 选点
+ *    - 像素列缓存随滚动只聚合新采样、丢弃移出左侧的列，每帧开销与宽度成正比
+ *    - 滚轮缩放、拖动平移、双击恢复实时跟随；每支笔按保留时长裁剪内存
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现趋势图
+ *****************************************************************************/
+
+#include "s7_trendwidget.h"
+#include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const qint64 MinSpanMs = 200;
+const int CompactThreshold = 4096;      // 前端无效采样超过该数且超过一半时压缩数组
+
+// 时间刻度候选（毫秒），选取像素间距不小于 80 的最小刻度
+const qint64 TimeSteps[] = {
+    10, 20, 50, 100, 200, 500,
+    1000, 2000, 5000, 10000, 15000, 30000,
+    60000, 120000, 300000, 600000, 1800000, 3600000
+};
+
+} // namespace
+
+S7_TrendWidget::S7_TrendWidget(QWidget *parent)
+    : QWidget(parent),
+    source(nullptr),
+    spanMs(60 * 1000),
+    retentionMs(10 * 60 * 1000),
+    viewEnd(QDateTime::currentMSecsSinceEpoch()),
+    live(true),
+    decimation(DecimateMinMax),
+    dragViewEnd(0),
+    paintUs(0)
+{
+    setMinimumHeight(160);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+//————————————————————————————
+// 数据源与笔
+void S7_TrendWidget::setSource(S7_TrendBuffer *buffer)
+{
+    source = buffer;
+}
+
+void S7_TrendWidget::addPen(int tagId, const QString &name, const QColor &color)
+{
+    if (penIndex.contains(tagId))
+        return;
+    Pen pen;
+    pen.tagId = tagId;
+    pen.name = name;
+    pen.color = color;
+    penIndex.insert(tagId, pens.size());
+    pens.append(pen);
+    update();
+}
+
+void S7_TrendWidget::removePen(int tagId)
+{
+    const int index = penIndex.value(tagId, -1);
+    if (index < 0)
+        return;
+    const int last = pens.size() - 1;
+    if (index != last) {
+        pens[index] = std::move(pens[last]);
+        penIndex[pens[index].tagId] = index;
+    }
+    pens.removeLast();
+    penIndex.remove(tagId);
+    update();
+}
+
+void S7_TrendWidget::clearPens()
+{
+    pens.clear();
+    penIndex.clear();
+    update();
+}
+
+bool S7_TrendWidget::hasPen(int tagId) const
+{
+    return penIndex.contains(tagId);
+}
+
+//————————————————————————————
+// 视图设置
+void S7_TrendWidget::setSpan(qint64 ms)
+{
+    spanMs = qBound(MinSpanMs, ms, retentionMs);
+    update();
+}
+
+qint64 S7_TrendWidget::span() const
+{
+    return spanMs;
+}
+
+void S7_TrendWidget::setRetention(qint64 ms)
+{
+    retentionMs = qMax(MinSpanMs, ms);
+    spanMs = qMin(spanMs, retentionMs);
+    for (Pen &pen : pens)
+        trim(pen);
+    update();
+}
+
+void S7_TrendWidget::setDecimation(Decimation mode)
+{
+    decimation = mode;
+    update();
+}
+
+void S7_TrendWidget::setLive(bool follow)
+{
+    live = follow;
+    if (live)
+        viewEnd = QDateTime::currentMSecsSinceEpoch();
+    update();
+}
+
+bool S7_TrendWidget::isLive() const
+{
+    return live;
+}
+
+quint64 S7_TrendWidget::droppedSamples() const
+{
+    return source ? source->droppedCount() : 0;
+}
+
+int S7_TrendWidget::lastPaintUs() const
+{
+    return paintUs;
+}
+
+//————————————————————————————
+// 帧更新：取出新采样追加到对应的笔，实时模式下右端跟随当前时间
+void S7_TrendWidget::advance()
+{
+    if (source) {
+        source->drain([this](const S7_TrendBuffer::Record &record) {
+            const int index = penIndex.value(record.tagId, -1);
+            if (index >= 0)
+                appendSample(pens[index], record.timestamp, record.value);
+        });
+    }
+    if (live)
+        viewEnd = QDateTime::currentMSecsSinceEpoch();
+    if (isVisible())
+        update();
+}
+
+void S7_TrendWidget::appendSample(Pen &pen, qint64 timestamp, double value)
+{
+    if (pen.head < pen.times.size() && timestamp <= pen.times.last())
+        return;     // 时间必须递增
+    pen.times.append(timestamp);
+    pen.values.append(value);
+    if (pen.times[pen.head] < timestamp - retentionMs)
+        trim(pen);
+}
+
+// 丢弃超出保留时长的采样；前端无效部分过多时整体前移一次
+void S7_TrendWidget::trim(Pen &pen)
+{
+    if (pen.head >= pen.times.size())
+        return;
+    pen.head = lowerBound(pen, pen.times.last() - retentionMs);
+    if (pen.head > CompactThreshold && pen.head > pen.times.size() / 2) {
+        pen.times.remove(0, pen.head);
+        pen.values.remove(0, pen.head);
+        pen.dropped += pen.head;
+        pen.head = 0;
+    }
+}
+
+int S7_TrendWidget::lowerBound(const Pen &pen, qint64 timestamp) const
+{
+    return int(std::lower_bound(pen.times.constBegin() + pen.head, pen.times.constEnd(), timestamp)
+               - pen.times.constBegin());
+}
+
+//————————————————————————————
+// 像素列缓存：视图右移时丢弃左侧的列，只聚合尚未聚合且不超出右端的采样；
+// 缩放或左移时重建
+void S7_TrendWidget::updateColumns(Pen &pen, qint64 firstColumn, qint64 lastColumn, double msPerPx)
+{
+    if (pen.cacheMsPerPx != msPerPx || firstColumn < pen.cacheFirstColumn) {
+        pen.cacheMsPerPx = msPerPx;
+        pen.cacheFirstColumn = firstColumn;
+        pen.columns.resize(0);
+        pen.folded = pen.dropped + lowerBound(pen, qint64(std::floor(firstColumn * msPerPx)));
+    } else if (firstColumn > pen.cacheFirstColumn) {
+        const int shift = int(qMin<qint64>(firstColumn - pen.cacheFirstColumn, pen.columns.size()));
+        pen.columns.remove(0, shift);
+        pen.cacheFirstColumn = firstColumn;
+    }
+
+    int i = int(qMax<qint64>(pen.folded - pen.dropped, pen.head));
+    for (; i < pen.times.size(); ++i) {
+        const qint64 column = qint64(std::floor(pen.times[i] / msPerPx));
+        if (column > lastColumn)
+            break;
+        if (column < firstColumn)
+            continue;
+        const int slot = int(column - firstColumn);
+        if (slot >= pen.columns.size())
+            pen.columns.resize(slot + 1);
+        pen.columns[slot].add(pen.values[i]);
+    }
+    pen.folded = pen.dropped + i;
+}
+
+QRect S7_TrendWidget::plotRect() const
+{
+    return rect().adjusted(56, 8, -10, -22);
+}
+
+//————————————————————————————
+// 绘制：先生成各笔折线（x 为像素、y 为数值）并统计纵轴范围，再映射到像素绘制
+void S7_TrendWidget::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QElapsedTimer timer;
+    timer.start();
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+    const QRect plot = plotRect();
+    if (plot.width() < 10 || plot.height() < 10)
+        return;
+
+    const int width = plot.width();
+    const double msPerPx = double(spanMs) / width;
+    const qint64 viewStart = viewEnd - spanMs;
+    const qint64 firstColumn = qint64(std::floor(viewStart / msPerPx));
+    const qint64 lastColumn = qint64(std::floor(viewEnd / msPerPx));
+
+    double yMin = 0;
+    double yMax = 0;
+    bool hasData = false;
+    auto extend = [&](double v) {
+        if (!hasData) {
+            yMin = yMax = v;
+            hasData = true;
+        } else {
+            if (v < yMin) yMin = v;
+            if (v > yMax) yMax = v;
+        }
+    };
+
+    penLines.resize(pens.size());
+    for (int p = 0; p < pens.size(); ++p) {
+        Pen &pen = pens[p];
+        QPolygonF &line = penLines[p];
+        line.resize(0);
+
+        // 可见范围两侧各多取一点，折线延伸到边界
+        const int begin = qMax(pen.head, lowerBound(pen, viewStart) - 1);
+        const int end = qMin(pen.times.size(), lowerBound(pen, viewEnd + 1) + 1);
+        const int count = end - begin;
+        if (count <= 0)
+            continue;
+
+        if (count <= 2 * width) {
+            for (int i = begin; i < end; ++i) {
+                line.append(QPointF((pen.times[i] - viewStart) / msPerPx, pen.values[i]));
+                extend(pen.values[i]);
+            }
+        } else if (decimation == DecimateLttb) {
+            lttbSelect(pen.times.constData() + begin, pen.values.constData() + begin, count, width, lttbIndex);
+            for (int k : qAsConst(lttbIndex)) {
+                const int i = begin + k;
+                line.append(QPointF((pen.times[i] - viewStart) / msPerPx, pen.values[i]));
+                extend(pen.values[i]);
+            }
+        } else {
+            updateColumns(pen, firstColumn, lastColumn, msPerPx);
+            const double offset = firstColumn * msPerPx - viewStart;
+            for (int c = 0; c < pen.columns.size(); ++c) {
+                const TrendColumn &column = pen.columns[c];
+                if (column.count == 0)
+                    continue;
+                const double x = (c * msPerPx + offset) / msPerPx;
+                line.append(QPointF(x, column.first));
+                if (column.count > 1) {
+                    // 先到达的极值先画，保持峰谷的先后顺序
+                    const bool minFirst = column.first - column.min <= column.max - column.first;
+                    line.append(QPointF(x, minFirst ? column.min : column.max));
+                    line.append(QPointF(x, minFirst ? column.max : column.min));
+                    line.append(QPointF(x, column.last));
+                }
+                extend(column.min);
+                extend(column.max);
+            }
+        }
+    }
+
+    // 纵轴范围留 5% 余量
+    if (!hasData) {
+        yMin = 0;
+        yMax = 1;
+    } else if (yMax - yMin < 1e-9) {
+        yMin -= 1;
+        yMax += 1;
+    } else {
+        const double pad = (yMax - yMin) * 0.05;
+        yMin -= pad;
+        yMax += pad;
+    }
+    const double yScale = plot.height() / (yMax - yMin);
+
+    // 网格与刻度
+    const QColor gridColor = palette().mid().color();
+    painter.setPen(QPen(gridColor, 0, Qt::DotLine));
+    for (int k = 0; k <= 4; ++k) {
+        const int y = plot.bottom() - plot.height() * k / 4;
+        painter.drawLine(plot.left(), y, plot.right(), y);
+        const double v = yMin + (yMax - yMin) * k / 4;
+        painter.drawText(QRect(0, y - 8, plot.left() - 4, 16), Qt::AlignRight | Qt::AlignVCenter,
+                         QString::number(v, 'g', 5));
+    }
+    qint64 step = TimeSteps[sizeof(TimeSteps) / sizeof(TimeSteps[0]) - 1];
+    for (qint64 candidate : TimeSteps) {
+        if (candidate / msPerPx >= 80) {
+            step = candidate;
+            break;
+        }
+    }
+    const QString timeFormat = step < 1000 ? "HH:mm:ss.zzz" : "HH:mm:ss";
+    for (qint64 t = (viewStart / step + 1) * step; t <= viewEnd; t += step) {
+        const int x = plot.left() + int((t - viewStart) / msPerPx);
+        painter.drawLine(x, plot.top(), x, plot.bottom());
+        painter.drawText(QRect(x - 50, plot.bottom() + 2, 100, 18), Qt::AlignCenter,
+                         QDateTime::fromMSecsSinceEpoch(t).toString(timeFormat));
+    }
+    painter.setPen(gridColor);
+    painter.drawRect(plot);
+
+    // 曲线
+    painter.setClipRect(plot);
+    for (int p = 0; p < pens.size(); ++p) {
+        QPolygonF &line = penLines[p];
+        for (QPointF &point : line)
+            point = QPointF(plot.left() + point.x(), plot.bottom() - (point.y() - yMin) * yScale);
+        painter.setPen(QPen(pens[p].color, 1.2));
+        painter.drawPolyline(line);
+    }
+    painter.setClipping(false);
+
+    // 图例：名称与最新值
+    int legendY = plot.top() + 4;
+    for (const Pen &pen : qAsConst(pens)) {
+        painter.fillRect(plot.left() + 6, legendY + 4, 10, 10, pen.color);
+        painter.setPen(palette().text().color());
+        const QString last = (pen.head < pen.times.size()) ? QString::number(pen.values.last(), 'g', 6) : "--";
+        painter.drawText(plot.left() + 20, legendY + 13, QString("%1  %2").arg(pen.name, last));
+        legendY += 16;
+    }
+    painter.drawText(plot.adjusted(0, 2, -6, 0), Qt::AlignRight | Qt::AlignTop,
+                     tr("%1  跨度 %2s").arg(live ? tr("实时") : tr("暂停（双击恢复）"))
+                         .arg(spanMs / 1000.0, 0, 'f', spanMs < 1000 ? 1 : 0));
+
+    paintUs = int(timer.nsecsElapsed() / 1000);
+}
+
+//————————————————————————————
+// 交互
+void S7_TrendWidget::wheelEvent(QWheelEvent *event)
+{
+    const int delta = event->angleDelta().y();
+    if (delta > 0)
+        setSpan(spanMs / 2);
+    else if (delta < 0)
+        setSpan(spanMs * 2);
+    event->accept();
+}
+
+void S7_TrendWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        dragOrigin = event->pos();
+        dragViewEnd = viewEnd;
+    }
+}
+
+void S7_TrendWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton))
+        return;
+    const double msPerPx = double(spanMs) / qMax(1, plotRect().width());
+    live = false;
+    viewEnd = dragViewEnd - qint64((event->pos().x() - dragOrigin.x()) * msPerPx);
+    update();
+}
+
+void S7_TrendWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    setLive(true);
+}
@@ -0,0 +1,94 @@
+﻿#ifndef S7_TRENDWIDGET_H
+#define S7_TRENDWIDGET_H
+
+#include <QWidget>
+#include <QVector>
+#include <QHash>
+#include <QColor>
+#include <QPolygonF>
+#include "s7_decimate.h"
+#include "s7_trendbuffer.h"
+
+// 实时趋势图：数据来自采集线程的趋势通道，绘制前按像素抽稀，
+// 每帧只聚合新到达的采样，绘制开销与控件宽度成正比、与采样数无关。
+// 滚轮缩放时间跨度，拖动平移（暂停跟随），双击恢复实时
+class S7_TrendWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    enum Decimation {
+        DecimateMinMax,     // 每像素 min/max 列，保留全部峰值
+        DecimateLttb        // LTTB 选点，曲线更平滑
+    };
+
+    explicit S7_TrendWidget(QWidget *parent = nullptr);
+
+    void setSource(S7_TrendBuffer *buffer);
+
+    void addPen(int tagId, const QString &name, const QColor &color);
+    void removePen(int tagId);
+    void clearPens();
+    bool hasPen(int tagId) const;
+
+    void setSpan(qint64 ms);            // 可见时间跨度，默认60秒
+    qint64 span() const;
+    void setRetention(qint64 ms);       // 每支笔保留时长，默认10分钟
+    void setDecimation(Decimation mode);
+    void setLive(bool follow);
+    bool isLive() const;
+
+    quint64 droppedSamples() const;     // 趋势通道写满丢弃的采样数
+    int lastPaintUs() const;            // 最近一次绘制耗时（微秒）
+
+public slots:
+    // 取出趋势通道中的新采样并请求重绘，由界面帧定时器调用
+    void advance();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    struct Pen {
+        int tagId = 0;
+        QString name;
+        QColor color;
+        QVector<qint64> times;          // 时间升序，从 head 开始有效
+        QVector<double> values;
+        int head = 0;
+        qint64 dropped = 0;             // 已从数组前端移除的采样数（用于绝对下标）
+
+        // 像素列缓存：列号 = floor(时间 / 每像素毫秒数)，每像素毫秒数不变时只聚合新采样
+        double cacheMsPerPx = 0;
+        qint64 cacheFirstColumn = 0;
+        QVector<TrendColumn> columns;
+        qint64 folded = 0;              // 已聚合到的绝对下标
+    };
+
+    void appendSample(Pen &pen, qint64 timestamp, double value);
+    void trim(Pen &pen);
+    void updateColumns(Pen &pen, qint64 firstColumn, qint64 lastColumn, double msPerPx);
+    int lowerBound(const Pen &pen, qint64 timestamp) const;
+    QRect plotRect() const;
+
+    S7_TrendBuffer *source;
+    QVector<Pen> pens;
+    QHash<int, int> penIndex;           // 变量编号 -> pens 下标
+    qint64 spanMs;
+    qint64 retentionMs;
+    qint64 viewEnd;                     // 可见范围右端（毫秒，UTC）
+    bool live;
+    Decimation decimation;
+
+    QPoint dragOrigin;
+    qint64 dragViewEnd;
+
+    QVector<QPolygonF> penLines;        // 每支笔的折线（x 为像素，y 为数值，复用）
+    QVector<int> lttbIndex;
+    int paintUs;
+};
+
+#endif
@@ -0,0 +1,218 @@
+﻿/******************************************************************************
+ * @file    s7_watchmodel.cpp
+ * @brief   变量监视表模型，直接读取变量表的当前值
+ *
+ * @details
+ * 功能描述：
+ *    - 以表格形式显示变量名、当前值、时间戳、质量和更新次数
+ *    - 按帧对比快照，只对变化的单元格发出 dataChanged
+ *    - 显示字符串在绘制时生成，未变化或不可见的行不格式化
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现变量监视表
+ *   2026-10-16 质量列显示失败的错误码，提示中给出错误文字与PLC执行耗时
+ *   2026-10-16 值列改由帧快照格式化，同一行各列来自同一个采样
+ *****************************************************************************/
+
+#include "s7_watchmodel.h"
+#include "s7_base.h"
+#include <QDateTime>
+#include <QColor>
+
+S7_WatchModel::S7_WatchModel(const S7_TagTable *table, QObject *parent)
+    : QAbstractTableModel(parent),
+    tagTable(table)
+{
+
+}
+
+//————————————————————————————
+// 行管理
+void S7_WatchModel::addTag(int id)
+{
+    if (rowOf.contains(id))
+        return;
+
+    Row row;
+    row.id = id;
+    TagInfo tagInfo = tagTable->info(id);
+    row.name = tagInfo.name.isEmpty() ? QString::number(id) : tagInfo.name;
+    row.dataType = tagInfo.address.dataType;
+    row.shown = tagTable->sample(id);
+    if (row.dataType == DT_String)
+        row.shownText = tagTable->text(id);
+    row.baseUpdates = row.shown.updates;
+
+    beginInsertRows(QModelIndex(), rows.size(), rows.size());
+    rowOf.insert(id, rows.size());
+    rows.append(row);
+    endInsertRows();
+}
+
+void S7_WatchModel::removeTag(int id)
+{
+    const int index = rowOf.value(id, -1);
+    if (index < 0)
+        return;
+
+    beginRemoveRows(QModelIndex(), index, index);
+    rows.remove(index);
+    rowOf.remove(id);
+    for (int i = index; i < rows.size(); ++i)
+        rowOf[rows[i].id] = i;
+    endRemoveRows();
+}
+
+void S7_WatchModel::clear()
+{
+    beginResetModel();
+    rows.clear();
+    rowOf.clear();
+    endResetModel();
+}
+
+//————————————————————————————
+// 按帧刷新：逐列比较快照，连续变化的列合并为一个区间
+void S7_WatchModel::refresh(const QVector<int> &ids)
+{
+    for (int id : ids) {
+        const int index = rowOf.value(id, -1);
+        if (index < 0)
+            continue;
+
+        Row &row = rows[index];
+        const TagSample now = tagTable->sample(id);
+        if (now.updates == row.shown.updates)
+            continue;   // 只有读取次数变化（值在死区内）时不刷新
+
+        bool changed[ColumnCount] = {false};
+        // string 的数值列只保存长度，内容是否变化无法从快照判断，发布即刷新
+        changed[ColumnValue] = now.value != row.shown.value || now.quality != row.shown.quality
+                               || row.dataType == DT_String;
+        changed[ColumnTimestamp] = now.timestamp != row.shown.timestamp;
+        changed[ColumnQuality] = now.quality != row.shown.quality || now.error != row.shown.error;
+        changed[ColumnUpdates] = true;
+        row.shown = now;
+        if (row.dataType == DT_String)
+            row.shownText = tagTable->text(id);
+
+        int first = ColumnValue;
+        while (first < ColumnCount) {
+            if (!changed[first]) {
+                first++;
+                continue;
+            }
+            int last = first;
+            while (last + 1 < ColumnCount && changed[last + 1])
+                last++;
+            emit dataChanged(this->index(index, first), this->index(index, last), {Qt::DisplayRole});
+            first = last + 1;
+        }
+    }
+}
+
+//————————————————————————————
+// 模型接口
+int S7_WatchModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int S7_WatchModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant S7_WatchModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.size())
+        return QVariant();
+
+    const Row &row = rows[index.row()];
+    const TagSample &sample = row.shown;
+
+    if (role == Qt::ForegroundRole && index.column() == ColumnQuality) {
+        if (sample.quality == QualityBad)
+            return QColor("#FF0000");
+        if (sample.quality == QualityGood)
+            return QColor("#009900");
+        return QVariant();
+    }
+    if (role == Qt::ToolTipRole && index.column() == ColumnQuality) {
+        if (sample.quality == QualityBad)
+            return S7_BASE::ErrorText(sample.error);
+        if (sample.quality == QualityGood && sample.execTimeMs >= 0)
+            return tr("PLC执行耗时：%1 ms").arg(sample.execTimeMs);
+        return QVariant();
+    }
+    if (role == Qt::TextAlignmentRole && index.column() != ColumnTag)
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (index.column()) {
+    case ColumnTag:
+        return row.name;
+    case ColumnValue:
+        return formatValue(row);
+    case ColumnTimestamp:
+        if (sample.timestamp == 0)
+            return QString();
+        return QDateTime::fromMSecsSinceEpoch(sample.timestamp).toString("HH:mm:ss.zzz");
+    case ColumnQuality:
+        switch (sample.quality) {
+        case QualityGood:      return tr("正常");
+        case QualityBad:
+            if (sample.error == 0)
+                return tr("失败");
+            return tr("失败 0x%1").arg(quint32(sample.error), 8, 16, QChar('0'));
+        case QualityUncertain: return tr("未读取");
+        default:               return QString();
+        }
+    case ColumnUpdates:
+        return sample.updates - row.baseUpdates;
+    default:
+        return QVariant();
+    }
+}
+
+// 按类型格式化快照中的值，与 S7_TagTable::displayValue 相同，但不再读取变量表的最新值
+QString S7_WatchModel::formatValue(const Row &row)
+{
+    const TagSample &s = row.shown;
+    if (s.quality == QualityUndefined || s.quality == QualityUncertain)
+        return QString();
+
+    switch (row.dataType) {
+    case DT_Bool:
+        return s.value != 0 ? "TRUE" : "FALSE";
+    case DT_Float:
+        return QString::number(static_cast<float>(s.value));
+    case DT_String:
+        return row.shownText;
+    case DT_Char:
+        return QString(QChar::fromLatin1(static_cast<char>(s.value)));
+    case DT_Int:
+    default:
+        return QString::number(static_cast<qint64>(s.value));
+    }
+}
+
+QVariant S7_WatchModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+    case ColumnTag:       return tr("变量");
+    case ColumnValue:     return tr("值");
+    case ColumnTimestamp: return tr("时间");
+    case ColumnQuality:   return tr("质量");
+    case ColumnUpdates:   return tr("更新次数");
+    default:              return QVariant();
+    }
+}
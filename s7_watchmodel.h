@@ -0,0 +1,56 @@
+﻿#ifndef S7_WATCHMODEL_H
+#define S7_WATCHMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QHash>
+#include "s7_tagtable.h"
+
+// 变量监视表：行对应变量表中的变量，列为 变量/值/时间/质量/更新次数。
+// 显示内容在 data() 中按需格式化，只有可见行会生成字符串；
+// refresh() 对比上一帧的快照，只对发生变化的单元格发出 dataChanged
+class S7_WatchModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        ColumnTag,
+        ColumnValue,
+        ColumnTimestamp,
+        ColumnQuality,
+        ColumnUpdates,
+        ColumnCount
+    };
+
+    explicit S7_WatchModel(const S7_TagTable *table, QObject *parent = nullptr);
+
+    void addTag(int id);
+    void removeTag(int id);
+    void clear();
+
+    // 按帧调用，ids 为本帧被写入过的变量编号（S7_TagTable::takeDirty）
+    void refresh(const QVector<int> &ids);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Row {
+        int id;
+        QString name;           // 变量名在添加时取出，避免每次绘制加锁
+        DataType dataType;
+        quint32 baseUpdates;    // 添加时的发布次数，更新次数从0开始计
+        TagSample shown;        // 上一帧显示的快照，所有列都由它格式化
+        QString shownText;      // string 的内容，与快照同时取出
+    };
+
+    static QString formatValue(const Row &row);
+
+    const S7_TagTable *tagTable;
+    QVector<Row> rows;
+    QHash<int, int> rowOf;      // 变量编号 -> 行
+};
+
+#endif
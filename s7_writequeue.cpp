@@ -0,0 +1,236 @@
+﻿/******************************************************************************
+ * @file    s7_writequeue.cpp
+ * @brief   写队列，将多个待写入的操作合并为少量报文
+ *
+ * @details
+ * 功能描述：
+ *    - 暂存字节写与位写，提交时一次发送
+ *    - 同一区域/DB内相邻或重叠的字节写合并为一个数据项，重叠部分按入队顺序覆盖
+ *    - 位写以 S7WLBit 成项，落在已入队字节写范围内的位直接改写该字节
+ *    - 数据项经 WriteMultiVars 打包，超过PDU的数据项由snap7自动分包
+ *
+ * @author  Magic
+ * @date    2026-10-16 创建
+ *
+ * @note
+ * - 修改记录：
+ *   2026-10-16 实现写合并
+ *****************************************************************************/
+
+#include "s7_writequeue.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+
+S7_WriteQueue::S7_WriteQueue(S7_BASE *s7Ptr)
+    : s7(s7Ptr)
+{
+
+}
+
+//————————————————————————————
+// 入队
+void S7_WriteQueue::writeBytes(int area, int dbNumber, int startByte, const quint8 *data, int size)
+{
+    if (size <= 0)
+        return;
+
+    QMutexLocker locker(&mutex);
+    // 之前入队的、落在本次范围内的位写被覆盖
+    const int bitBegin = startByte * 8;
+    const int bitEnd = (startByte + size) * 8;
+    for (int i = bits.size() - 1; i >= 0; --i) {
+        const BitWrite &bit = bits[i];
+        if (bit.area == area && bit.dbNumber == dbNumber
+            && bit.bitAddress >= bitBegin && bit.bitAddress < bitEnd)
+            bits.remove(i);
+    }
+
+    ByteWrite write;
+    write.area = area;
+    write.dbNumber = dbNumber;
+    write.start = startByte;
+    write.size = size;
+    write.offset = bytes.size();
+    bytes.append(reinterpret_cast<const char*>(data), size);
+    writes.append(write);
+}
+
+void S7_WriteQueue::writeBool(int area, int dbNumber, int startByte, int bitPosition, bool value)
+{
+    QMutexLocker locker(&mutex);
+    // 该字节已有待写入的数据时直接改写其中的位，提交后仍是一个数据项
+    for (int i = writes.size() - 1; i >= 0; --i) {
+        const ByteWrite &write = writes[i];
+        if (write.area == area && write.dbNumber == dbNumber
+            && startByte >= write.start && startByte < write.start + write.size) {
+            char &target = bytes.data()[write.offset + startByte - write.start];
+            if (value)
+                target = char(quint8(target) | (1 << bitPosition));
+            else
+                target = char(quint8(target) & ~(1 << bitPosition));
+            return;
+        }
+    }
+
+    const int bitAddress = startByte * 8 + bitPosition;
+    for (BitWrite &bit : bits) {
+        if (bit.area == area && bit.dbNumber == dbNumber && bit.bitAddress == bitAddress) {
+            bit.value = value;
+            return;
+        }
+    }
+    BitWrite bit;
+    bit.area = area;
+    bit.dbNumber = dbNumber;
+    bit.bitAddress = bitAddress;
+    bit.value = value;
+    bits.append(bit);
+}
+
+void S7_WriteQueue::writeInt(int area, int dbNumber, int startByte, int value)
+{
+    quint8 buffer[2];
+    S7_BASE::SetInt(buffer, value);
+    writeBytes(area, dbNumber, startByte, buffer, 2);
+}
+
+void S7_WriteQueue::writeFloat(int area, int dbNumber, int startByte, float value)
+{
+    quint8 buffer[4];
+    S7_BASE::SetFloat(buffer, value);
+    writeBytes(area, dbNumber, startByte, buffer, 4);
+}
+
+void S7_WriteQueue::writeString(int area, int dbNumber, int startByte, const QString &value, quint16 maxLength)
+{
+    QByteArray buffer(maxLength + 2, 0);
+    S7_BASE::SetString(reinterpret_cast<quint8*>(buffer.data()), value, maxLength);
+    writeBytes(area, dbNumber, startByte, reinterpret_cast<const quint8*>(buffer.constData()), buffer.size());
+}
+
+void S7_WriteQueue::writeChar(int area, int dbNumber, int startByte, char value)
+{
+    quint8 buffer;
+    S7_BASE::SetChar(&buffer, value);
+    writeBytes(area, dbNumber, startByte, &buffer, 1);
+}
+
+int S7_WriteQueue::pendingCount() const
+{
+    QMutexLocker locker(&mutex);
+    return writes.size() + bits.size();
+}
+
+void S7_WriteQueue::clear()
+{
+    QMutexLocker locker(&mutex);
+    writes.clear();
+    bytes.clear();
+    bits.clear();
+}
+
+//————————————————————————————
+// 提交：按区域/DB/起始字节排序，首尾相接或重叠的写合并为一块，
+// 块内按入队顺序拷贝数据，后写入的覆盖先写入的
+WriteReport S7_WriteQueue::flush(S7_BASE::Priority priority)
+{
+    QVector<ByteWrite> byteWrites;
+    QByteArray data;
+    QVector<BitWrite> bitWrites;
+    {
+        QMutexLocker locker(&mutex);
+        byteWrites.swap(writes);
+        data.swap(bytes);
+        bitWrites.swap(bits);
+    }
+
+    WriteReport report;
+    report.writes = byteWrites.size() + bitWrites.size();
+    if (report.writes == 0)
+        return report;
+
+    QVector<int> order(byteWrites.size());
+    for (int i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&byteWrites](int a, int b) {
+        const ByteWrite &wa = byteWrites[a];
+        const ByteWrite &wb = byteWrites[b];
+        if (wa.area != wb.area)
+            return wa.area < wb.area;
+        if (wa.dbNumber != wb.dbNumber)
+            return wa.dbNumber < wb.dbNumber;
+        if (wa.start != wb.start)
+            return wa.start < wb.start;
+        return a < b;
+    });
+
+    // 划分块：blockFirst[k] 为第k块在 order 中的起始位置
+    QVector<S7_MultiItem> items;
+    QVector<int> blockFirst;
+    for (int k = 0; k < order.size(); ++k) {
+        const ByteWrite &write = byteWrites[order[k]];
+        if (!items.isEmpty()) {
+            S7_MultiItem &last = items.last();
+            const int lastEnd = last.start + last.size;
+            if (last.area == write.area && last.dbNumber == write.dbNumber && write.start <= lastEnd) {
+                last.size = qMax(lastEnd, write.start + write.size) - last.start;
+                continue;
+            }
+        }
+        S7_MultiItem item;
+        item.area = write.area;
+        item.dbNumber = write.dbNumber;
+        item.start = write.start;
+        item.size = write.size;
+        items.append(item);
+        blockFirst.append(k);
+    }
+    blockFirst.append(order.size());
+    const int byteItems = items.size();
+
+    // 块数据在合并缓冲区中首尾相接，位数据在其后各占一字节
+    int merged = 0;
+    for (const S7_MultiItem &item : qAsConst(items))
+        merged += item.size;
+    QByteArray buffer(merged + bitWrites.size(), 0);
+    quint8 *base = reinterpret_cast<quint8*>(buffer.data());
+    int offset = 0;
+    QVector<int> members;
+    for (int b = 0; b < byteItems; ++b) {
+        S7_MultiItem &item = items[b];
+        item.buffer = base + offset;
+        members.clear();
+        for (int k = blockFirst[b]; k < blockFirst[b + 1]; ++k)
+            members.append(order[k]);
+        std::sort(members.begin(), members.end());
+        for (int index : qAsConst(members)) {
+            const ByteWrite &write = byteWrites[index];
+            std::memcpy(item.buffer + write.start - item.start, data.constData() + write.offset, size_t(write.size));
+        }
+        offset += item.size;
+    }
+    for (const BitWrite &bit : qAsConst(bitWrites)) {
+        S7_MultiItem item;
+        item.area = bit.area;
+        item.dbNumber = bit.dbNumber;
+        item.start = bit.bitAddress;
+        item.size = 1;
+        item.wordLen = S7WLBit;
+        item.buffer = base + offset;
+        *item.buffer = bit.value ? 1 : 0;
+        offset++;
+        items.append(item);
+    }
+
+    report.items = items.size();
+    report.telegrams = s7->WriteMultiVars(items, priority);
+
+    for (int b = 0; b < items.size(); ++b) {
+        if (items[b].result == 0)
+            continue;
+        report.failedWrites += b < byteItems ? blockFirst[b + 1] - blockFirst[b] : 1;
+        report.lastError = items[b].result;
+    }
+    return report;
+}
@@ -0,0 +1,66 @@
+﻿#ifndef S7_WRITEQUEUE_H
+#define S7_WRITEQUEUE_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QMutex>
+#include "s7_base.h"
+
+// 一次提交的统计
+struct WriteReport {
+    int writes = 0;         // 提交的写操作数（合并前）
+    int items = 0;          // 合并后的数据项数
+    int telegrams = 0;      // 发送的报文数
+    int failedWrites = 0;   // 所在数据项失败的写操作数
+    int lastError = 0;      // 最后一个失败数据项的错误码
+};
+
+// 写队列：暂存多个写操作，提交时将同一区域/DB内相邻或重叠的字节写合并为一个数据项，
+// 位写入以 S7WLBit 单独成项（不读-改-写），再经 WriteMultiVars 打包为尽量少的报文。
+// 重叠的写按入队顺序生效；有间隙的地址不合并，间隙内PLC的数据未知，不能覆盖
+class S7_WriteQueue
+{
+public:
+    explicit S7_WriteQueue(S7_BASE *s7Ptr);
+
+    S7_WriteQueue(const S7_WriteQueue &) = delete;
+    S7_WriteQueue &operator=(const S7_WriteQueue &) = delete;
+
+    // 入队（线程安全），flush 之前不发送
+    void writeBytes(int area, int dbNumber, int startByte, const quint8 *data, int size);
+    void writeBool(int area, int dbNumber, int startByte, int bitPosition, bool value);
+    void writeInt(int area, int dbNumber, int startByte, int value);
+    void writeFloat(int area, int dbNumber, int startByte, float value);
+    void writeString(int area, int dbNumber, int startByte, const QString &value, quint16 maxLength);
+    void writeChar(int area, int dbNumber, int startByte, char value);
+
+    int pendingCount() const;
+    void clear();
+
+    // 合并并发送当前所有待写入的操作，发送期间新入队的操作留待下次提交
+    WriteReport flush(S7_BASE::Priority priority = S7_BASE::PriorityManual);
+
+private:
+    struct ByteWrite {
+        int area;
+        int dbNumber;
+        int start;
+        int size;
+        int offset;         // 数据在 bytes 中的偏移
+    };
+    struct BitWrite {
+        int area;
+        int dbNumber;
+        int bitAddress;     // 字节*8+位
+        bool value;
+    };
+
+    S7_BASE *s7;
+    mutable QMutex mutex;       // 保护以下待写入数据
+    QVector<ByteWrite> writes;  // 按入队顺序
+    QByteArray bytes;
+    QVector<BitWrite> bits;     // 每个位只保留最后一次写入
+};
+
+#endif
@@ -12,13 +12,58 @@ LIBS += $$PWD/Lib/snap7.lib
 SOURCES += \
     Lib/snap7.cpp \
     main.cpp \
+    s7_async.cpp \
     s7_base.cpp \
-    s7_tester.cpp
+    s7_decimate.cpp \
+    s7_engine.cpp \
+    s7_histcodec.cpp \
+    s7_historian.cpp \
+    s7_histquery.cpp \
+    s7_logmodel.cpp \
+    s7_metrics.cpp \
+    s7_planner.cpp \
+    s7_pool.cpp \
+    s7_recipe.cpp \
+    s7_scheduler.cpp \
+    s7_simulator.cpp \
+    s7_supervisor.cpp \
+    s7_tagtable.cpp \
+    s7_taskregistry.cpp \
+    s7_tester.cpp \
+    s7_trendwidget.cpp \
+    s7_watchmodel.cpp \
+    s7_writequeue.cpp
 
 HEADERS += \
     Lib/snap7.h \
+    s7_async.h \
+    s7_backoff.h \
     s7_base.h \
-    s7_tester.h
+    s7_bitstream.h \
+    s7_decimate.h \
+    s7_engine.h \
+    s7_histcodec.h \
+    s7_historian.h \
+    s7_histquery.h \
+    s7_layout.h \
+    s7_logmodel.h \
+    s7_metrics.h \
+    s7_planner.h \
+    s7_pool.h \
+    s7_queue.h \
+    s7_recipe.h \
+    s7_result.h \
+    s7_scheduler.h \
+    s7_simulator.h \
+    s7_supervisor.h \
+    s7_tag.h \
+    s7_tagtable.h \
+    s7_taskregistry.h \
+    s7_tester.h \
+    s7_trendbuffer.h \
+    s7_trendwidget.h \
+    s7_watchmodel.h \
+    s7_writequeue.h
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin